@@ -0,0 +1,19 @@
+#version 330
+
+uniform sampler2D uAtlas;
+uniform vec2 uAtlasTiles;
+
+in vec2 vTexCoord;
+flat in vec2 vTileOrigin;
+in float vShade;
+
+out vec4 fColor;
+
+void main() {
+    // wrap within the tile; gradients of the unwrapped coordinates keep
+    // mipmapping from breaking at the wrap
+    vec2 texCoord = vTileOrigin + fract(vTexCoord) / uAtlasTiles;
+    vec4 color = textureGrad(uAtlas, texCoord, dFdx(vTexCoord) / uAtlasTiles, dFdy(vTexCoord) / uAtlasTiles);
+
+    fColor = vec4(color.rgb * vShade, color.a);
+}
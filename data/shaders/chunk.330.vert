@@ -0,0 +1,36 @@
+#version 330
+
+// chunk meshes of PackedVertex; see src/engine/model.hpp
+
+layout(location = 0) in uvec4 aVertex;  // x, y, z, flags
+layout(location = 1) in uint aTile;
+layout(location = 2) in uint aLight;
+
+uniform mat4 uProjMatrix;
+uniform mat4 uViewMatrix;
+uniform vec3 uChunkOrigin;
+uniform vec2 uAtlasTiles;
+
+out vec2 vTexCoord;
+flat out vec2 vTileOrigin;
+out float vShade;
+
+// per face, in BlockFace order: how much light falls on it
+const float FaceShade[6] = float[6](0.8, 0.8, 0.5, 1.0, 0.7, 0.7);
+
+void main() {
+    vec3 position = vec3(aVertex.xyz);
+    uint face = aVertex.w & 7u;
+    uint occlusion = (aVertex.w >> 3) & 3u;
+
+    // the texture runs across the face in blocks, repeating per block
+    vec2 across = face < 2u ? position.zy : face < 4u ? position.xz : position.xy;
+    vTexCoord = vec2(across.x, -across.y);
+
+    uint columns = uint(uAtlasTiles.x);
+    vTileOrigin = vec2(aTile % columns, aTile / columns) / uAtlasTiles;
+
+    vShade = FaceShade[face] * (0.4 + 0.2 * float(occlusion)) * (float(aLight) / 255.0);
+
+    gl_Position = uProjMatrix * uViewMatrix * vec4(uChunkOrigin + position, 1.0);
+}
@@ -0,0 +1,391 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "ChunkArena.hpp"
+#include "ClientModel.hpp"
+#include "StreamBuffer.hpp"
+
+#include <GL/glew.h>
+#include "GLCheck.hpp"
+
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////////////
+
+const int ChunkArena::RegionSize;
+const size_t ChunkArena::MaxSliceVertices;
+
+namespace {
+
+const uint32_t Unmapped = 0xffffffff;
+
+}
+
+ChunkArena::ChunkArena(
+    StreamBuffer *stream,
+    size_t initialVertices
+): mRegions(), mStream(stream), mInitialVertices(initialVertices),
+   mVertices(), mIndices(), mRemap(), mSources(), mCompactions(0), mGrowths(0), mDrawCalls(0),
+   mDrawnChunks(0) {
+}
+
+ChunkArena::~ChunkArena() {
+    for (auto &entry : mRegions) {
+        Region &region = *entry.second;
+        glDeleteVertexArrays(1, &region.vao);
+        glDeleteBuffers(1, &region.vbo);
+        glDeleteBuffers(1, &region.ibo);
+    }
+}
+
+bool ChunkArena::insert(const Position &chunk, const PackedModel &model) {
+    const std::vector<PackedVertex> &vertices = model.getVertices();
+    const std::vector<uint32_t> &indices = model.getIndices();
+
+    if (vertices.empty()) {
+        remove(chunk);
+        return true;
+    }
+
+    if (model.getPrimitive() != GLTriangles || indices.empty()) {
+        return false;
+    }
+
+    Region &region = acquireRegion(chunk);
+    if (!region.vao) {
+        return false;
+    }
+
+    remove(chunk);
+
+    std::vector<Slice> &slices = region.slices[toPositionKey(chunk)];
+
+    // into region coordinates, which reach RegionSize chunks and one block
+    Position local = (chunk - region.origin) * Coord(ChunkData::Count);
+
+    mRemap.assign(vertices.size(), Unmapped);
+    mSources.clear();
+    mVertices.clear();
+    mIndices.clear();
+
+    GLClearErrors();
+
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        if (mVertices.size() + 3 > MaxSliceVertices) {
+            addSlice(region, slices);
+        }
+
+        for (size_t j = i; j < i + 3; j++) {
+            uint32_t &mapped = mRemap[indices[j]];
+            if (mapped == Unmapped) {
+                mapped = uint32_t(mVertices.size());
+                mSources.push_back(indices[j]);
+
+                PackedVertex vertex = vertices[indices[j]];
+                vertex.x += uint8_t(local.x);
+                vertex.y += uint8_t(local.y);
+                vertex.z += uint8_t(local.z);
+                mVertices.push_back(vertex);
+            }
+            mIndices.push_back(uint16_t(mapped));
+        }
+    }
+
+    addSlice(region, slices);
+    return true;
+}
+
+void ChunkArena::remove(const Position &chunk) {
+    Region *region = findRegion(chunk);
+    if (!region) {
+        return;
+    }
+
+    auto found = region->slices.find(toPositionKey(chunk));
+    if (found != region->slices.end()) {
+        freeSlices(*region, found->second);
+        region->slices.erase(found);
+    }
+}
+
+bool ChunkArena::contains(const Position &chunk) const {
+    Region *region = findRegion(chunk);
+    return region && region->slices.count(toPositionKey(chunk)) > 0;
+}
+
+void ChunkArena::begin() {
+    for (auto &entry : mRegions) {
+        Region &region = *entry.second;
+        region.counts.clear();
+        region.offsets.clear();
+        region.baseVertices.clear();
+    }
+
+    mDrawnChunks = 0;
+}
+
+bool ChunkArena::add(const Position &chunk) {
+    Region *region = findRegion(chunk);
+    if (!region) {
+        return false;
+    }
+
+    auto found = region->slices.find(toPositionKey(chunk));
+    if (found == region->slices.end()) {
+        return false;
+    }
+
+    for (const Slice &slice : found->second) {
+        region->counts.push_back(GLsizei(slice.indexCount));
+        region->offsets.push_back(reinterpret_cast<const GLvoid*>(slice.indexOffset * sizeof(uint16_t)));
+        region->baseVertices.push_back(GLint(slice.vertexOffset));
+    }
+
+    mDrawnChunks += 1;
+    return true;
+}
+
+void ChunkArena::draw(GLuint program) {
+    mDrawCalls = 0;
+
+    GLint origin = glGetUniformLocation(program, "uChunkOrigin");
+
+    GLClearErrors();
+
+    for (auto &entry : mRegions) {
+        Region &region = *entry.second;
+        if (region.counts.empty()) {
+            continue;
+        }
+
+        GLChecked(glUniform3f(origin,
+            float(region.origin.x * ChunkData::Count),
+            float(region.origin.y * ChunkData::Count),
+            float(region.origin.z * ChunkData::Count)
+        ));
+
+        GLChecked(glBindVertexArray(region.vao));
+        GLChecked(glMultiDrawElementsBaseVertex(GL_TRIANGLES,
+            region.counts.data(), GL_UNSIGNED_SHORT, region.offsets.data(),
+            GLsizei(region.counts.size()), region.baseVertices.data()
+        ));
+
+        mDrawCalls += 1;
+    }
+
+    GLChecked(glBindVertexArray(0));
+}
+
+size_t ChunkArena::getRegionCount() const {
+    return mRegions.size();
+}
+
+size_t ChunkArena::getCompactionCount() const {
+    return mCompactions;
+}
+
+size_t ChunkArena::getGrowthCount() const {
+    return mGrowths;
+}
+
+size_t ChunkArena::getDrawCallCount() const {
+    return mDrawCalls;
+}
+
+size_t ChunkArena::getDrawnChunkCount() const {
+    return mDrawnChunks;
+}
+
+size_t ChunkArena::getCapacityBytes() const {
+    size_t bytes = 0;
+    for (const auto &entry : mRegions) {
+        bytes += entry.second->vertices.getCapacity() * sizeof(PackedVertex);
+        bytes += entry.second->indices.getCapacity() * sizeof(uint16_t);
+    }
+    return bytes;
+}
+
+size_t ChunkArena::getUsedBytes() const {
+    size_t bytes = 0;
+    for (const auto &entry : mRegions) {
+        bytes += entry.second->vertices.getUsed() * sizeof(PackedVertex);
+        bytes += entry.second->indices.getUsed() * sizeof(uint16_t);
+    }
+    return bytes;
+}
+
+Position ChunkArena::getRegion(const Position &chunk) {
+    // rounds down, for negative chunks too
+    auto floor = [](Coord c) {
+        return (c >= 0 ? c : c - (RegionSize - 1)) / RegionSize * RegionSize;
+    };
+    return Position(floor(chunk.x), floor(chunk.y), floor(chunk.z));
+}
+
+ChunkArena::Region *ChunkArena::findRegion(const Position &chunk) const {
+    auto found = mRegions.find(toPositionKey(getRegion(chunk)));
+    return found == mRegions.end() ? nullptr : found->second.get();
+}
+
+ChunkArena::Region &ChunkArena::acquireRegion(const Position &chunk) {
+    Position origin = getRegion(chunk);
+    std::unique_ptr<Region> &region = mRegions[toPositionKey(origin)];
+
+    if (!region) {
+        region.reset(new Region());
+        region->origin = origin;
+        region->vao = region->vbo = region->ibo = 0;
+
+        GLClearErrors();
+
+        GLChecked(glGenVertexArrays(1, &region->vao));
+        GLChecked(glGenBuffers(1, &region->vbo));
+        GLChecked(glGenBuffers(1, &region->ibo));
+
+        if (!region->vao || !region->vbo || !region->ibo) {
+            region->vao = 0;
+            return *region;
+        }
+
+        region->vertices.grow(mInitialVertices);
+        region->indices.grow(mInitialVertices * 2);
+
+        GLChecked(glBindVertexArray(region->vao));
+        GLChecked(glBindBuffer(GL_ARRAY_BUFFER, region->vbo));
+        GLChecked(glBufferData(GL_ARRAY_BUFFER, mInitialVertices * sizeof(PackedVertex), nullptr, GL_DYNAMIC_DRAW));
+        ClientModel::setPackedAttributes();
+        GLChecked(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, region->ibo));
+        GLChecked(glBufferData(GL_ELEMENT_ARRAY_BUFFER, mInitialVertices * 2 * sizeof(uint16_t), nullptr, GL_DYNAMIC_DRAW));
+        GLChecked(glBindVertexArray(0));
+        GLChecked(glBindBuffer(GL_ARRAY_BUFFER, 0));
+    }
+
+    return *region;
+}
+
+void ChunkArena::freeSlices(Region &region, const std::vector<Slice> &slices) {
+    for (const Slice &slice : slices) {
+        region.vertices.free(slice.vertexOffset);
+        region.indices.free(slice.indexOffset);
+    }
+}
+
+void ChunkArena::addSlice(Region &region, std::vector<Slice> &slices) {
+    if (mIndices.empty()) {
+        return;
+    }
+
+    Slice slice;
+    slice.vertexCount = mVertices.size();
+    slice.indexCount = mIndices.size();
+    slice.vertexOffset = reserve(region, region.vertices, region.vbo, GL_ARRAY_BUFFER, sizeof(PackedVertex), slice.vertexCount);
+    slice.indexOffset = reserve(region, region.indices, region.ibo, GL_ELEMENT_ARRAY_BUFFER, sizeof(uint16_t), slice.indexCount);
+
+    write(region.vbo, slice.vertexOffset * sizeof(PackedVertex), mVertices.data(), mVertices.size() * sizeof(PackedVertex));
+    write(region.ibo, slice.indexOffset * sizeof(uint16_t), mIndices.data(), mIndices.size() * sizeof(uint16_t));
+    slices.push_back(slice);
+
+    // the next slice starts with no vertices
+    for (uint32_t source : mSources) {
+        mRemap[source] = Unmapped;
+    }
+    mSources.clear();
+    mVertices.clear();
+    mIndices.clear();
+}
+
+size_t ChunkArena::reserve(Region &region, RangeAllocator &ranges, GLuint &buffer, GLenum target, size_t unit, size_t count) {
+    size_t offset = ranges.allocate(count);
+    if (offset != RangeAllocator::None) {
+        return offset;
+    }
+
+    size_t capacity = ranges.getCapacity();
+
+    // compact when a good part is free, only in pieces; grow otherwise
+    if (ranges.getFree() >= count && ranges.getFree() >= capacity / 4) {
+        relocate(region, ranges, buffer, target, unit, capacity);
+        mCompactions += 1;
+    } else {
+        relocate(region, ranges, buffer, target, unit, std::max(capacity * 2, ranges.getUsed() + count));
+        mGrowths += 1;
+    }
+
+    return ranges.allocate(count);
+}
+
+void ChunkArena::relocate(Region &region, RangeAllocator &ranges, GLuint &buffer, GLenum target, size_t unit, size_t capacity) {
+    ranges.grow(capacity);
+    std::vector<RangeAllocator::Move> moves = ranges.compact();
+
+    // ranges before the first move stayed where they were
+    size_t kept = moves.empty() ? ranges.getUsed() : moves.front().to;
+
+    GLuint fresh = 0;
+    GLChecked(glGenBuffers(1, &fresh));
+    GLChecked(glBindBuffer(GL_COPY_WRITE_BUFFER, fresh));
+    GLChecked(glBufferData(GL_COPY_WRITE_BUFFER, ranges.getCapacity() * unit, nullptr, GL_DYNAMIC_DRAW));
+    GLChecked(glBindBuffer(GL_COPY_READ_BUFFER, buffer));
+
+    if (kept > 0) {
+        GLChecked(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, kept * unit));
+    }
+
+    for (const RangeAllocator::Move &move : moves) {
+        GLChecked(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, move.from * unit, move.to * unit, move.size * unit));
+    }
+
+    GLChecked(glBindBuffer(GL_COPY_READ_BUFFER, 0));
+    GLChecked(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+    GLChecked(glDeleteBuffers(1, &buffer));
+    buffer = fresh;
+
+    if (!moves.empty()) {
+        std::unordered_map<size_t, size_t> moved;
+        for (const RangeAllocator::Move &move : moves) {
+            moved[move.from] = move.to;
+        }
+
+        bool vertices = &ranges == &region.vertices;
+        for (auto &entry : region.slices) {
+            for (Slice &slice : entry.second) {
+                size_t &offset = vertices ? slice.vertexOffset : slice.indexOffset;
+                auto found = moved.find(offset);
+                if (found != moved.end()) {
+                    offset = found->second;
+                }
+            }
+        }
+    }
+
+    GLChecked(glBindVertexArray(region.vao));
+    if (target == GL_ARRAY_BUFFER) {
+        GLChecked(glBindBuffer(GL_ARRAY_BUFFER, buffer));
+        ClientModel::setPackedAttributes();
+        GLChecked(glBindBuffer(GL_ARRAY_BUFFER, 0));
+    } else {
+        GLChecked(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer));
+    }
+    GLChecked(glBindVertexArray(0));
+}
+
+void ChunkArena::write(GLuint buffer, size_t offset, const void *data, size_t size) {
+    size_t staged = mStream ? mStream->write(data, size) : RangeAllocator::None;
+
+    GLChecked(glBindBuffer(GL_COPY_WRITE_BUFFER, buffer));
+
+    if (staged != RangeAllocator::None) {
+        GLChecked(glBindBuffer(GL_COPY_READ_BUFFER, mStream->getBuffer()));
+        GLChecked(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, staged, offset, size));
+        GLChecked(glBindBuffer(GL_COPY_READ_BUFFER, 0));
+    } else {
+        GLChecked(glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data));
+    }
+
+    GLChecked(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,151 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __CHUNKARENA_HPP__
+#define __CHUNKARENA_HPP__ 1
+
+////////////////////////////////////////////////////////////////////////////////
+
+#include "engine/engine.hpp"
+#include <GL/glew.h>
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+
+class StreamBuffer;
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ *  Keeps the meshes of many chunks in a few large GL buffers, and draws
+ *  them with one glMultiDrawElementsBaseVertex per buffer.
+ *
+ *  Chunks are grouped in cubic regions of RegionSize chunks a side, and
+ *  each region has one vertex array, vertex buffer and index buffer, that
+ *  its chunks take ranges of with RangeAllocator.  Vertices are moved into
+ *  region coordinates as they go in (they still fit PackedVertex), so the
+ *  whole region draws with one uChunkOrigin.  Indices are 16 bits wide,
+ *  relative to a slice of the chunk's vertices, and the base vertex of each
+ *  draw points them at it; a mesh of more than MaxSliceVertices vertices
+ *  (a checkerboard of transparent blocks can have 98304) is split into
+ *  several slices.  A region's buffers are compacted when free space is
+ *  only in pieces, and grown, doubling, when there is not enough.
+ *
+ *  Draw with begin(), add() for each chunk and draw() for the lot, with
+ *  data/shaders/chunk.330 bound.
+ */
+class ChunkArena {
+public:
+    static const int RegionSize = 8;
+    static const size_t MaxSliceVertices = 1 << 16;
+
+private:
+    struct Slice {
+        size_t vertexOffset;
+        size_t vertexCount;
+        size_t indexOffset;
+        size_t indexCount;
+    };
+
+    struct Region {
+        Position origin;
+        GLuint vao;
+        GLuint vbo;
+        GLuint ibo;
+        RangeAllocator vertices;
+        RangeAllocator indices;
+        std::unordered_map<uint64_t, std::vector<Slice>> slices;
+
+        std::vector<GLsizei> counts;
+        std::vector<const GLvoid*> offsets;
+        std::vector<GLint> baseVertices;
+    };
+
+    std::unordered_map<uint64_t, std::unique_ptr<Region>> mRegions;
+    StreamBuffer *mStream;
+    size_t mInitialVertices;
+
+    std::vector<PackedVertex> mVertices;
+    std::vector<uint16_t> mIndices;
+    std::vector<uint32_t> mRemap;       //!< Mesh vertex to slice vertex
+    std::vector<uint32_t> mSources;     //!< Slice vertex to mesh vertex
+
+    size_t mCompactions;
+    size_t mGrowths;
+    size_t mDrawCalls;
+    size_t mDrawnChunks;
+
+public:
+    /**
+     *  Creates an arena whose regions start with room for initialVertices
+     *  vertices, and twice as many indices; meshes are written through
+     *  stream, if given.  GL objects are created as regions are needed.
+     */
+    explicit ChunkArena(StreamBuffer *stream = nullptr, size_t initialVertices = 1 << 15);
+    ~ChunkArena();
+
+    ChunkArena(const ChunkArena&) = delete;
+    ChunkArena &operator=(const ChunkArena&) = delete;
+
+    /**
+     *  Puts a chunk's mesh in the arena, in place of any it had.  Fails,
+     *  keeping the old mesh, for meshes that are not indexed triangles, or
+     *  if the region's GL objects cannot be created.
+     */
+    bool insert(const Position &chunk, const PackedModel &model);
+    void remove(const Position &chunk);
+    bool contains(const Position &chunk) const;
+
+    /**
+     *  Starts a list of chunks to draw.
+     */
+    void begin();
+
+    /**
+     *  Adds a chunk to the list, if it is in the arena; returns whether it
+     *  was.
+     */
+    bool add(const Position &chunk);
+
+    /**
+     *  Draws the chunks added since begin(), setting the origin uniform of
+     *  program for each region.
+     */
+    void draw(GLuint program);
+
+    size_t getRegionCount() const;
+    size_t getCompactionCount() const;
+    size_t getGrowthCount() const;
+    size_t getDrawCallCount() const;
+    size_t getDrawnChunkCount() const;
+
+    /**
+     *  Gets the bytes the regions' buffers take, and how many are used.
+     */
+    size_t getCapacityBytes() const;
+    size_t getUsedBytes() const;
+
+    static Position getRegion(const Position &chunk);
+
+private:
+    Region *findRegion(const Position &chunk) const;
+    Region &acquireRegion(const Position &chunk);
+    void freeSlices(Region &region, const std::vector<Slice> &slices);
+    void addSlice(Region &region, std::vector<Slice> &slices);
+
+    size_t reserve(Region &region, RangeAllocator &ranges, GLuint &buffer, GLenum target, size_t unit, size_t count);
+    void relocate(Region &region, RangeAllocator &ranges, GLuint &buffer, GLenum target, size_t unit, size_t capacity);
+    void write(GLuint buffer, size_t offset, const void *data, size_t size);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // __CHUNKARENA_HPP__
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -3,20 +3,77 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #include "ClientModel.hpp"
+#include "StreamBuffer.hpp"
 
 #include <GL/glew.h>
 #include "GLCheck.hpp"
 
+#include <cstddef>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct VertexAttribute {
+    GLuint index;
+    GLint size;
+    GLenum type;
+    GLboolean normalized;
+    bool integer;           //!< Read as integers, with glVertexAttribIPointer
+    size_t offset;
+};
+
+const VertexAttribute FullLayout[] = {
+    { 0, 3, GL_FLOAT, GL_FALSE, false, offsetof(Vertex, position) },
+    { 1, 3, GL_FLOAT, GL_TRUE,  false, offsetof(Vertex, normal) },
+    { 2, 2, GL_FLOAT, GL_FALSE, false, offsetof(Vertex, texCoord) },
+};
+
+const VertexAttribute PackedLayout[] = {
+    { 0, 4, GL_UNSIGNED_BYTE,  GL_FALSE, true, offsetof(PackedVertex, x) },
+    { 1, 1, GL_UNSIGNED_SHORT, GL_FALSE, true, offsetof(PackedVertex, tile) },
+    { 2, 1, GL_UNSIGNED_BYTE,  GL_FALSE, true, offsetof(PackedVertex, light) },
+};
+
+/**
+ *  Points the bound vertex array's attributes into the buffer bound to
+ *  GL_ARRAY_BUFFER.
+ */
+void setAttributes(const VertexAttribute *layout, size_t count, size_t stride) {
+    for (size_t i = 0; i < count; i++) {
+        const VertexAttribute &attribute = layout[i];
+        const void *offset = reinterpret_cast<const void*>(attribute.offset);
+
+        GLChecked(glEnableVertexAttribArray(attribute.index));
+
+        if (attribute.integer) {
+            GLChecked(glVertexAttribIPointer(attribute.index, attribute.size, attribute.type, stride, offset));
+        } else {
+            GLChecked(glVertexAttribPointer(attribute.index, attribute.size, attribute.type, attribute.normalized, stride, offset));
+        }
+    }
+}
+
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 ClientModel::ClientModel(
     const Model *model
-): mModel(model), mVAO(), mVBO(), mIBO(), mPrimitive(), mCount() {
+): mModel(model), mPackedModel(), mVAO(), mVBO(), mIBO(), mPrimitive(), mIndexType(), mCount(),
+   mBounds(), mHasBounds(false), mStream(), mDirty(false), mVertexCapacity(0), mIndexCapacity(0) {
 }
 
 ClientModel::ClientModel(
     const Model &model
-): mModel(&model), mVAO(), mVBO(), mIBO(), mPrimitive(), mCount() {
+): mModel(&model), mPackedModel(), mVAO(), mVBO(), mIBO(), mPrimitive(), mIndexType(), mCount(),
+   mBounds(), mHasBounds(false), mStream(), mDirty(false), mVertexCapacity(0), mIndexCapacity(0) {
+}
+
+ClientModel::ClientModel(
+    const PackedModel &model
+): mModel(), mPackedModel(&model), mVAO(), mVBO(), mIBO(), mPrimitive(), mIndexType(), mCount(),
+   mBounds(), mHasBounds(false), mStream(), mDirty(false), mVertexCapacity(0), mIndexCapacity(0) {
 }
 
 ClientModel::~ClientModel() {
@@ -24,21 +81,78 @@ ClientModel::~ClientModel() {
 }
 
 void ClientModel::setModel(const Model *model) {
-    destroyVertexArrays();
+    invalidate();
     mModel = model;
+    mPackedModel = nullptr;
 }
 
 void ClientModel::setModel(const Model &model) {
     setModel(&model);
 }
 
+void ClientModel::setModel(const PackedModel &model) {
+    invalidate();
+    mModel = nullptr;
+    mPackedModel = &model;
+}
+
 const Model *ClientModel::getModel() const {
     return mModel;
 }
 
+const PackedModel *ClientModel::getPackedModel() const {
+    return mPackedModel;
+}
+
+void ClientModel::setStream(StreamBuffer *stream) {
+    mStream = stream;
+}
+
+StreamBuffer *ClientModel::getStream() const {
+    return mStream;
+}
+
+size_t ClientModel::getUploadSize(const Model &model) {
+    return sizeof(Vertex) * model.getVertices().size() + model.getIndexBytes();
+}
+
+size_t ClientModel::getUploadSize(const PackedModel &model) {
+    return sizeof(PackedVertex) * model.getVertices().size() + model.getIndexBytes();
+}
+
+void ClientModel::setPackedAttributes() {
+    setAttributes(PackedLayout, sizeof(PackedLayout) / sizeof(PackedLayout[0]), sizeof(PackedVertex));
+}
+
+bool ClientModel::isUploaded() const {
+    return mVAO != 0 && !mDirty;
+}
+
+bool ClientModel::getBounds(BoundingSphere &bounds) const {
+    if (mHasBounds) {
+        bounds = mBounds;
+    }
+    return mHasBounds;
+}
+
+bool ClientModel::upload(UploadBudget &budget) const {
+    if (isUploaded() || (!mModel && !mPackedModel)) {
+        return isUploaded();
+    }
+
+    size_t size = mModel ? getUploadSize(*mModel) : getUploadSize(*mPackedModel);
+    if (!budget.allows(size)) {
+        return false;
+    }
+
+    createVertexArrays();
+    budget.spend(size);
+    return isUploaded();
+}
+
 void ClientModel::render() const {
-    if (mModel) {
-        if (mVAO == 0) {
+    if (mModel || mPackedModel) {
+        if (mVAO == 0 || mDirty) {
             createVertexArrays();
             if (mVAO == 0) {
                 return;
@@ -50,7 +164,7 @@ void ClientModel::render() const {
         GLChecked(glBindVertexArray(mVAO));
 
         if (mIBO) {
-            GLChecked(glDrawElements(mPrimitive, mCount, GL_UNSIGNED_SHORT, nullptr));
+            GLChecked(glDrawElements(mPrimitive, mCount, mIndexType, nullptr));
         } else {
             GLChecked(glDrawArrays(mPrimitive, 0, mCount));
         }
@@ -60,102 +174,110 @@ void ClientModel::render() const {
 }
 
 void ClientModel::createVertexArrays() const {
-    if (mModel) {
-        size_t numVerts = mModel->getVertices().size();
-        size_t numIndex = mModel->getIndices().size();
+    mDirty = false;
+    mHasBounds = false;
 
-        mPrimitive = mModel->getPrimitive();
-        mCount = numVerts;
+    if (!mModel && !mPackedModel) {
+        return;
+    }
 
-        if (mCount == 0) {
-            return;
-        }
+    const void *vertexData;
+    size_t vertexSize;
+    size_t numVerts;
+    size_t numIndex;
+    std::vector<uint8_t> indexData;
+    const VertexAttribute *layout;
+    size_t layoutSize;
+
+    if (mPackedModel) {
+        vertexData = mPackedModel->getVertices().data();
+        vertexSize = sizeof(PackedVertex);
+        numVerts = mPackedModel->getVertices().size();
+        numIndex = mPackedModel->getIndices().size();
+        indexData.resize(mPackedModel->getIndexBytes());
+        mPackedModel->writeIndices(indexData.data());
+        mIndexType = mPackedModel->getIndexType();
+        layout = PackedLayout;
+        layoutSize = sizeof(PackedLayout) / sizeof(PackedLayout[0]);
+        mPrimitive = mPackedModel->getPrimitive();
+    } else {
+        vertexData = mModel->getVertices().data();
+        vertexSize = sizeof(Vertex);
+        numVerts = mModel->getVertices().size();
+        numIndex = mModel->getIndices().size();
+        indexData.resize(mModel->getIndexBytes());
+        mModel->writeIndices(indexData.data());
+        mIndexType = mModel->getIndexType();
+        layout = FullLayout;
+        layoutSize = sizeof(FullLayout) / sizeof(FullLayout[0]);
+        mPrimitive = mModel->getPrimitive();
+        mBounds = mModel->getBoundingSphere();
+        mHasBounds = true;
+    }
 
-        sf::err() << "numVerts = " << numVerts;
-        sf::err() << ", numIndex = " << numIndex;
+    mCount = numVerts;
 
-        GLClearErrors();
+    if (mCount == 0) {
+        return;
+    }
 
-        if (!mVAO) {
-            if (!glGenVertexArrays) {
-                sf::err() << "\n\nglGenVertexArrays == NULL!\n";
-            }
+    GLClearErrors();
 
-            GLChecked(glGenVertexArrays(1, &mVAO));
+    if (!mVAO) {
+        if (!glGenVertexArrays) {
+            sf::err() << "ClientModel: glGenVertexArrays is not available\n";
+            return;
+        }
 
-            sf::err() << ", VAO = " << mVAO;
+        GLChecked(glGenVertexArrays(1, &mVAO));
 
-            if (!mVAO) {
-                return;
-            }
+        if (!mVAO) {
+            return;
         }
+    }
 
-        GLChecked(glBindVertexArray(mVAO));
+    GLChecked(glBindVertexArray(mVAO));
 
-        if (!mVBO) {
-            GLChecked(glGenBuffers(1, &mVBO));
+    if (!mVBO) {
+        GLChecked(glGenBuffers(1, &mVBO));
 
-            sf::err() << ", VBO = " << mVBO;
-
-            if (!mVBO) {
-                return;
-            }
+        if (!mVBO) {
+            return;
         }
+    }
 
-        sf::err() << "glGenBuffers(VBO) -> " << mVBO;
-        sf::err() << std::flush;
+    if (numIndex > 0) {
+        mCount = numIndex;
 
-        if (numIndex > 0) {
-            mCount = numIndex;
+        if (!mIBO) {
+            GLChecked(glGenBuffers(1, &mIBO));
 
             if (!mIBO) {
-                GLChecked(glGenBuffers(1, &mIBO));
-
-                sf::err() << ", IBO = " << mIBO;
-
-                if (!mIBO) {
-                    return;
-                }
+                return;
             }
-
-            sf::err() << ", glGenBuffers(IBO) -> " << mIBO;
-            sf::err() << std::flush;
-
-            size_t size = sizeof(uint16_t) * numIndex;
-            const void *data = mModel->getIndices().data();
-            GLChecked(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIBO));
-            GLChecked(glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, data, GL_STATIC_DRAW));
         }
 
-        sf::err() << ", mPrimitive = " << mPrimitive;
-        sf::err() << ", mCount = " << mCount;
-        sf::err() << std::flush;
-
-        size_t size = sizeof(Vertex) * numVerts;
-        const void *data = mModel->getVertices().data();
-        sf::err() << ", size == " << size;
-        sf::err() << std::flush;
-        GLChecked(glBindBuffer(GL_ARRAY_BUFFER, mVBO));
-        GLChecked(glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW));
-
-        if (mIBO) {
-            GLChecked(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIBO));
-        }
-
-#define SizeAndOffset(T, F) sizeof(T), reinterpret_cast<const void*>(offsetof(T, F))
+        GLChecked(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIBO));
+        fillBuffer(GL_ELEMENT_ARRAY_BUFFER, mIndexCapacity, indexData.data(), indexData.size());
+    } else if (mIBO) {
+        // a kept buffer from an indexed model
+        GLChecked(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+        GLChecked(glDeleteBuffers(1, &mIBO));
+        mIBO = 0;
+        mIndexCapacity = 0;
+    }
 
-        GLChecked(glEnableVertexAttribArray(0));
-        GLChecked(glEnableVertexAttribArray(1));
-        GLChecked(glEnableVertexAttribArray(2));
+    size_t size = vertexSize * numVerts;
+    GLChecked(glBindBuffer(GL_ARRAY_BUFFER, mVBO));
+    fillBuffer(GL_ARRAY_BUFFER, mVertexCapacity, vertexData, size);
 
-        GLChecked(glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, SizeAndOffset(Vertex, position)));
-        GLChecked(glVertexAttribPointer(1, 3, GL_FLOAT, GL_TRUE,  SizeAndOffset(Vertex, normal)));
-        GLChecked(glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, SizeAndOffset(Vertex, texCoord)));
+    if (mIBO) {
+        GLChecked(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIBO));
+    }
 
-        GLChecked(glBindVertexArray(0));
+    setAttributes(layout, layoutSize, vertexSize);
 
-        sf::err() << std::endl;
-    }
+    GLChecked(glBindVertexArray(0));
 }
 
 void ClientModel::destroyVertexArrays() {
@@ -175,7 +297,43 @@ void ClientModel::destroyVertexArrays() {
     }
 
     mPrimitive = 0;
+    mIndexType = 0;
     mCount = 0;
+    mHasBounds = false;
+    mDirty = false;
+    mVertexCapacity = 0;
+    mIndexCapacity = 0;
+}
+
+void ClientModel::invalidate() {
+    if (mStream && mVAO) {
+        mDirty = true;
+    } else {
+        destroyVertexArrays();
+    }
+}
+
+void ClientModel::fillBuffer(GLenum target, size_t &capacity, const void *data, size_t size) const {
+    if (!mStream) {
+        GLChecked(glBufferData(target, size, data, GL_STATIC_DRAW));
+        capacity = size;
+        return;
+    }
+
+    if (size > capacity) {
+        GLChecked(glBufferData(target, size, nullptr, GL_DYNAMIC_DRAW));
+        capacity = size;
+    }
+
+    size_t offset = mStream->write(data, size);
+    if (offset == RingAllocator::None) {
+        GLChecked(glBufferSubData(target, 0, size, data));
+        return;
+    }
+
+    GLChecked(glBindBuffer(GL_COPY_READ_BUFFER, mStream->getBuffer()));
+    GLChecked(glCopyBufferSubData(GL_COPY_READ_BUFFER, target, offset, 0, size));
+    GLChecked(glBindBuffer(GL_COPY_READ_BUFFER, 0));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -13,28 +13,90 @@
 
 ////////////////////////////////////////////////////////////////////////////////
 
+class StreamBuffer;
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ *  Draws a Model or a PackedModel from GL buffers, created when first drawn
+ *  or uploaded.  Full models bind position, normal and texture coordinates
+ *  to attributes 0 to 2; packed models bind x, y, z and flags (as an
+ *  unsigned vector) to 0, the tile to 1 and the light to 2, for a shader
+ *  such as data/shaders/chunk.330.
+ *
+ *  A model given a StreamBuffer is meant to change often: setting a new
+ *  model keeps its GL buffers, and the new arrays are written through the
+ *  stream and copied into them, growing them only when they are too small.
+ */
 class ClientModel {
     const Model *mModel;
+    const PackedModel *mPackedModel;
     mutable GLuint mVAO;
     mutable GLuint mVBO;
     mutable GLuint mIBO;
     mutable GLenum mPrimitive;
+    mutable GLenum mIndexType;
     mutable GLuint mCount;
+    mutable BoundingSphere mBounds;
+    mutable bool mHasBounds;
+
+    StreamBuffer *mStream;
+    mutable bool mDirty;
+    mutable size_t mVertexCapacity;
+    mutable size_t mIndexCapacity;
 
 public:
     ClientModel(const Model *model = nullptr);
     ClientModel(const Model &model);
+    ClientModel(const PackedModel &model);
     ~ClientModel();
 
     void setModel(const Model &model);
     void setModel(const Model *model);
+    void setModel(const PackedModel &model);
     const Model *getModel() const;
+    const PackedModel *getPackedModel() const;
+
+    /**
+     *  Sets the stream that new arrays are written through; null (the
+     *  default) creates new buffers for each model instead.
+     */
+    void setStream(StreamBuffer *stream);
+    StreamBuffer *getStream() const;
+
+    /**
+     *  Gets the number of bytes a model's arrays take on the GPU.
+     */
+    static size_t getUploadSize(const Model &model);
+    static size_t getUploadSize(const PackedModel &model);
+
+    /**
+     *  Points attributes 0 to 2 of the bound vertex array at PackedVertex
+     *  data in the buffer bound to GL_ARRAY_BUFFER, as packed models are.
+     */
+    static void setPackedAttributes();
+
+    bool isUploaded() const;
+
+    /**
+     *  Gets a sphere around the model as it was last uploaded, in model
+     *  space; false if it is not uploaded, or is packed.
+     */
+    bool getBounds(BoundingSphere &bounds) const;
+
+    /**
+     *  Creates the vertex arrays now, unless the budget is spent; render()
+     *  otherwise creates them when first drawn.  Returns whether they exist.
+     */
+    bool upload(UploadBudget &budget) const;
 
     void render() const;
 
 private:
     void createVertexArrays() const;
     void destroyVertexArrays();
+    void invalidate();
+    void fillBuffer(GLenum target, size_t &capacity, const void *data, size_t size) const;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
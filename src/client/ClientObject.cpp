@@ -70,6 +70,15 @@ const MaterialInfo *ClientObject::getMaterial() const {
     return mMaterial;
 }
 
+bool ClientObject::isVisible(const Frustum &frustum) const {
+    BoundingSphere bounds;
+    if (!mModel || !mModel->getBounds(bounds)) {
+        return true;
+    }
+
+    return frustum.intersects(bounds.center, bounds.radius);
+}
+
 void ClientObject::render() const {
     if (mModel) {
         if (mShader) {
@@ -54,6 +54,12 @@ public:
     void setMaterial(const MaterialInfo *material);
     const MaterialInfo *getMaterial() const;
 
+    /**
+     *  Whether the model may be in view; true when its bounds are not
+     *  known yet, as before it is first drawn.
+     */
+    bool isVisible(const Frustum &frustum) const;
+
     void render() const;
 };
 
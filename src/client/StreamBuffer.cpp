@@ -0,0 +1,150 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "StreamBuffer.hpp"
+
+#include <GL/glew.h>
+#include "GLCheck.hpp"
+
+#include <cstring>
+
+////////////////////////////////////////////////////////////////////////////////
+
+StreamBuffer::StreamBuffer(
+    size_t capacity
+): mRing(capacity), mFences(), mBuffer(), mMapping(), mWaits(0) {
+}
+
+StreamBuffer::~StreamBuffer() {
+    for (GLsync fence : mFences) {
+        glDeleteSync(fence);
+    }
+
+    if (mBuffer) {
+        if (mMapping) {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, mBuffer);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        }
+
+        glDeleteBuffers(1, &mBuffer);
+    }
+}
+
+size_t StreamBuffer::write(const void *data, size_t size, size_t alignment) {
+    if (size == 0 || size > mRing.getCapacity()) {
+        // would never fit; waiting on the frames in flight cannot help
+        return RingAllocator::None;
+    }
+
+    if (!mBuffer && !create()) {
+        return RingAllocator::None;
+    }
+
+    size_t offset;
+    while ((offset = mRing.allocate(size, alignment)) == RingAllocator::None) {
+        if (!reclaim()) {
+            return RingAllocator::None;
+        }
+    }
+
+    if (mMapping) {
+        std::memcpy(mMapping + offset, data, size);
+        return offset;
+    }
+
+    GLClearErrors();
+
+    GLChecked(glBindBuffer(GL_COPY_WRITE_BUFFER, mBuffer));
+    void *mapped = glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, size,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT
+    );
+    GLCheckErrors();
+
+    if (mapped) {
+        std::memcpy(mapped, data, size);
+        GLChecked(glUnmapBuffer(GL_COPY_WRITE_BUFFER));
+    }
+
+    GLChecked(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+    return mapped ? offset : RingAllocator::None;
+}
+
+void StreamBuffer::endFrame() {
+    if (mRing.getOpenBytes() == 0) {
+        return;
+    }
+
+    mRing.close();
+    mFences.push_back(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+}
+
+GLuint StreamBuffer::getBuffer() const {
+    return mBuffer;
+}
+
+bool StreamBuffer::isPersistent() const {
+    return mMapping != nullptr;
+}
+
+const RingAllocator &StreamBuffer::getRing() const {
+    return mRing;
+}
+
+size_t StreamBuffer::getWaitCount() const {
+    return mWaits;
+}
+
+bool StreamBuffer::create() {
+    GLClearErrors();
+
+    GLChecked(glGenBuffers(1, &mBuffer));
+    if (!mBuffer) {
+        return false;
+    }
+
+    size_t capacity = mRing.getCapacity();
+    GLChecked(glBindBuffer(GL_COPY_WRITE_BUFFER, mBuffer));
+
+    if (GLEW_ARB_buffer_storage) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        GLChecked(glBufferStorage(GL_COPY_WRITE_BUFFER, capacity, nullptr, flags));
+        mMapping = static_cast<uint8_t*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, capacity, flags));
+        GLCheckErrors();
+    } else {
+        GLChecked(glBufferData(GL_COPY_WRITE_BUFFER, capacity, nullptr, GL_STREAM_DRAW));
+    }
+
+    GLChecked(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+    return true;
+}
+
+bool StreamBuffer::reclaim() {
+    if (mFences.empty()) {
+        // everything in the ring was written this frame; fence it and wait
+        if (mRing.getOpenBytes() == 0) {
+            return false;
+        }
+        endFrame();
+    }
+
+    GLsync fence = mFences.front();
+    GLenum status = glClientWaitSync(fence, 0, 0);
+
+    if (status == GL_TIMEOUT_EXPIRED) {
+        mWaits += 1;
+        do {
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        } while (status == GL_TIMEOUT_EXPIRED);
+    }
+
+    glDeleteSync(fence);
+    mFences.pop_front();
+    mRing.reclaim();
+    return status != GL_WAIT_FAILED;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,81 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __STREAMBUFFER_HPP__
+#define __STREAMBUFFER_HPP__ 1
+
+////////////////////////////////////////////////////////////////////////////////
+
+#include "engine/engine.hpp"
+#include <GL/glew.h>
+
+#include <deque>
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ *  A large GL buffer that dynamic geometry is written through, as a ring.
+ *
+ *  Each write takes the next range of the ring and copies into it; the
+ *  ranges written in a frame are fenced by endFrame(), and only written
+ *  over again once the GPU is past the fence.  With ARB_buffer_storage the
+ *  buffer is mapped once, persistently, and a write is a memcpy; on plain
+ *  GL 3.3 each write maps its own range unsynchronized, which the fences
+ *  make safe, so the driver never reallocates or stalls on the buffer.
+ *
+ *  Data written is only good until the GPU has used it: draw from it in
+ *  the same frame, or copy it into a buffer of its own with
+ *  glCopyBufferSubData.  The buffer is created on the first write, in the
+ *  current GL context.
+ */
+class StreamBuffer {
+    RingAllocator mRing;
+    std::deque<GLsync> mFences;
+
+    GLuint mBuffer;
+    uint8_t *mMapping;      //!< Persistent mapping, if there is one
+    size_t mWaits;
+
+public:
+    explicit StreamBuffer(size_t capacity);
+    ~StreamBuffer();
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer &operator=(const StreamBuffer&) = delete;
+
+    /**
+     *  Copies size bytes into the ring at a multiple of alignment, and
+     *  returns their offset in getBuffer(), or RingAllocator::None if the
+     *  ring is too small or the buffer cannot be created.  Waits on the
+     *  oldest frames if the ring is full.
+     */
+    size_t write(const void *data, size_t size, size_t alignment = 4);
+
+    /**
+     *  Fences the writes since the last call; call once a frame, after
+     *  the draws and copies that read them.
+     */
+    void endFrame();
+
+    GLuint getBuffer() const;
+    bool isPersistent() const;
+    const RingAllocator &getRing() const;
+
+    /**
+     *  Gets the number of times a write had to wait for the GPU.
+     */
+    size_t getWaitCount() const;
+
+private:
+    bool create();
+    bool reclaim();
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // __STREAMBUFFER_HPP__
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -19,8 +19,12 @@ extern "C" {
 #include <lualib.h>
 }; // extern "C"
 
+#include <algorithm>
 #include <cstdio>
 #include <cmath>
+#include <deque>
+#include <memory>
+#include <unordered_map>
 
 #include "GLCheck.hpp"
 
@@ -31,10 +35,12 @@ extern "C" {
 
 #include "Transformable3D.hpp"
 #include "Camera.hpp"
+#include "ChunkArena.hpp"
 #include "ClientModel.hpp"
 #include "ClientObject.hpp"
 #include "ResourceCache.hpp"
 #include "ShaderCache.hpp"
+#include "StreamBuffer.hpp"
 #include "TextureCache.hpp"
 #include "MusicCache.hpp"
 #include "LightInfo.hpp"
@@ -174,14 +180,214 @@ void Player::render() const {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+extern ShaderCache gShaderCache;
+
+/**
+ *  Draws chunks from meshes built in the background.
+ *
+ *  request() queues a chunk for the mesh builder's workers, which load it
+ *  from the source themselves, off the render thread.  upload(), once per
+ *  frame, takes the finished meshes and uploads as many as the frame's
+ *  budget allows, leaving the rest for later frames.  A chunk keeps drawing
+ *  its old mesh until the new one is uploaded; release() drops it.
+ *
+ *  Meshes are of packed vertices, kept in a ChunkArena.  Between begin()
+ *  and end(), renderVisible() lists the chunks that can be seen from the
+ *  camera's chunk through the caves and open air between, by the
+ *  connectivity found as each chunk was meshed, skipping those whose box
+ *  is outside the view frustum; end() draws the list with the chunk
+ *  shader, a few multi-draws in all.
+ */
 class ChunkRenderer {
+    MeshBuilder mBuilder;
+    UploadBudget mBudget;
+    StreamBuffer mStream;
+    ChunkArena mArena;
+
+    std::unordered_map<uint64_t, uint64_t> mVersions;
+    std::deque<ChunkMesh> mReady;
+
+    Frustum mFrustum;
+    CullStats mCulling;
+    ChunkVisibility mVisibility;
+    std::vector<Position> mVisible;
+
+    sf::Shader *mShader;
+    const sf::Texture *mAtlas;
+    glm::vec2 mAtlasTiles;
+    sf::Texture mBlank;
+
 public:
-    void render(sf::RenderTarget &target, const Chunk &chunk);
+    ChunkRenderer();
+
+    /**
+     *  Sets the texture atlas, of the given number of tiles across and
+     *  down; tiles are numbered across, then down.  Without an atlas,
+     *  chunks are drawn plain white, in their shading only.
+     */
+    void setAtlas(const sf::Texture *atlas, const glm::vec2 &tiles);
+
+    /**
+     *  Sets where the mesh builder's workers load chunks from.
+     */
+    void setSource(ChunkSource &source);
+
+    /**
+     *  Queues a chunk for meshing.  version must grow with each request,
+     *  and only the mesh of a chunk's latest request is uploaded, so that
+     *  meshes of data changed since are dropped.
+     */
+    void request(const Position &chunk, uint64_t version);
+
+    /**
+     *  Stops drawing a chunk, and drops any mesh of it still being built.
+     */
+    void release(const Position &chunk);
+
+    void upload();
+
+    bool begin(const glm::mat4 &projection, const glm::mat4 &view);
+    void renderVisible(const Position &camera, int distance);
+    void end();
+
+    const UploadBudget &getBudget() const;
+    const ChunkArena &getArena() const;
+    const CullStats &getCulling() const;
+    size_t getBacklog() const;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
 
-void ChunkRenderer::render(sf::RenderTarget &target, const Chunk &chunk) {
+ChunkRenderer::ChunkRenderer(
+): mBuilder(0, ChunkMesher(), ChunkMesher::Culled, MeshBuilder::Packed),
+   mBudget(4 << 20, sf::milliseconds(2)), mStream(8 << 20), mArena(&mStream),
+   mVersions(), mReady(), mFrustum(), mCulling(),
+   mVisibility(), mVisible(),
+   mShader(), mAtlas(), mAtlasTiles(1, 1), mBlank() {
+}
+
+void ChunkRenderer::setAtlas(const sf::Texture *atlas, const glm::vec2 &tiles) {
+    mAtlas = atlas;
+    mAtlasTiles = tiles;
+}
+
+void ChunkRenderer::setSource(ChunkSource &source) {
+    mBuilder.setSource(source);
+}
+
+void ChunkRenderer::request(const Position &chunk, uint64_t version) {
+    mVersions[toPositionKey(chunk)] = version;
+    mBuilder.submit(chunk, version);
+}
+
+void ChunkRenderer::release(const Position &chunk) {
+    mVersions.erase(toPositionKey(chunk));
+    mArena.remove(chunk);
+    mVisibility.remove(chunk);
+}
+
+void ChunkRenderer::upload() {
+    mBudget.reset();
+
+    ChunkMesh mesh;
+    while (mBuilder.poll(mesh)) {
+        mReady.push_back(std::move(mesh));
+    }
+
+    while (!mReady.empty()) {
+        ChunkMesh &ready = mReady.front();
+        auto known = mVersions.find(toPositionKey(ready.position));
+
+        if (known == mVersions.end() || known->second != ready.version) {
+            mReady.pop_front();
+            continue;
+        }
+
+        size_t size = ClientModel::getUploadSize(ready.packed);
+        if (!mBudget.allows(size)) {
+            break;
+        }
+
+        if (mArena.insert(ready.position, ready.packed)) {
+            mVisibility.set(ready.position, ready.connectivity);
+        } else {
+            // the chunk keeps drawing its old mesh, if it has one
+            sf::err() << "ChunkRenderer: could not upload the mesh of chunk " << ready.position.x << ","
+                      << ready.position.y << "," << ready.position.z << std::endl;
+        }
+        mBudget.spend(size);
+
+        mReady.pop_front();
+    }
+
+    mStream.endFrame();
+}
+
+bool ChunkRenderer::begin(const glm::mat4 &projection, const glm::mat4 &view) {
+    if (!mShader) {
+        mShader = gShaderCache.acquire("data/shaders/chunk.330");
+        if (!mShader) {
+            return false;
+        }
+    }
+
+    if (mAtlas) {
+        mShader->setParameter("uAtlas", *mAtlas);
+        mShader->setParameter("uAtlasTiles", mAtlasTiles.x, mAtlasTiles.y);
+    } else {
+        if (mBlank.getSize().x == 0) {
+            sf::Image white;
+            white.create(1, 1, sf::Color::White);
+            mBlank.loadFromImage(white);
+        }
+        mShader->setParameter("uAtlas", mBlank);
+        mShader->setParameter("uAtlasTiles", 1.0f, 1.0f);
+    }
+
+    // textures set above are bound along with the shader
+    sf::Shader::bind(mShader);
+    unsigned int shaderProgram = mShader->getNativeHandle();
+    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "uProjMatrix"), 1, 0, &projection[0][0]);
+    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "uViewMatrix"), 1, 0, &view[0][0]);
+
+    mFrustum.set(projection * view);
+    mCulling.reset();
+    mArena.begin();
+    return true;
+}
+
+void ChunkRenderer::renderVisible(const Position &camera, int distance) {
+    mVisibility.findVisible(camera, distance, mFrustum, mVisible, &mCulling);
+
+    for (const Position &chunk : mVisible) {
+        if (mArena.add(chunk)) {
+            mCulling.drawn += 1;
+        }
+    }
+}
+
+void ChunkRenderer::end() {
+    if (mShader) {
+        mArena.draw(mShader->getNativeHandle());
+    }
+
+    sf::Shader::bind(nullptr);
+}
+
+const UploadBudget &ChunkRenderer::getBudget() const {
+    return mBudget;
+}
+
+const ChunkArena &ChunkRenderer::getArena() const {
+    return mArena;
+}
+
+const CullStats &ChunkRenderer::getCulling() const {
+    return mCulling;
+}
+
+size_t ChunkRenderer::getBacklog() const {
+    return mReady.size() + mBuilder.getPendingCount();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -241,7 +447,17 @@ class GameWindow : protected sf::RenderWindow {
     ChunkData mTestChunkData;
     Chunk mTestChunk;
 
+    // declared first, as the renderer's workers load from it until destroyed
+    ChunkGenerator mChunkGenerator;
     ChunkRenderer mChunkRenderer;
+    CullStats mObjectCulling;
+    int mViewDistance;
+
+    std::vector<Position> mStreamOrder;
+    std::unordered_map<uint64_t, Position> mStreamedChunks;
+    Position mStreamCenter;
+    size_t mStreamCursor;
+    uint64_t mChunkVersion;
 
 public:
     GameWindow();
@@ -260,6 +476,7 @@ protected:
     void handleInput(const sf::Time &delta);
     void handleEvent(const sf::Event &event);
     void update(const sf::Time &delta);
+    void streamChunks(const Position &center);
     void render();
 
     void start3D();
@@ -312,7 +529,14 @@ GameWindow::GameWindow(
 ), mTestChunk(
     Position(),
     &mTestChunkData
+), mViewDistance(
+    8
+), mStreamCursor(
+    0
+), mChunkVersion(
+    0
 ) {
+    mChunkRenderer.setSource(mChunkGenerator);
 }
 
 void GameWindow::run() {
@@ -851,6 +1075,62 @@ void GameWindow::update(const sf::Time &delta) {
     }
 }
 
+/**
+ *  Requests meshes for the chunks within the view distance of center,
+ *  nearest first, a few per frame so that meshing never stalls a frame,
+ *  and releases those left well behind.  Each request takes a new version,
+ *  so a chunk requested again after it changes replaces its older mesh.
+ */
+void GameWindow::streamChunks(const Position &center) {
+    static const size_t MaxRequests = 8;
+    static const size_t MaxBacklog = 64;
+
+    if (mStreamOrder.empty()) {
+        Coord d = mViewDistance;
+        for (Coord z = -d; z <= d; z++) {
+            for (Coord y = -d; y <= d; y++) {
+                for (Coord x = -d; x <= d; x++) {
+                    if (x * x + y * y + z * z <= d * d) {
+                        mStreamOrder.push_back(Position(x, y, z));
+                    }
+                }
+            }
+        }
+
+        std::stable_sort(mStreamOrder.begin(), mStreamOrder.end(), [](const Position &a, const Position &b) {
+            return a.x * a.x + a.y * a.y + a.z * a.z < b.x * b.x + b.y * b.y + b.z * b.z;
+        });
+
+        mStreamCenter = center;
+        mStreamCursor = 0;
+    } else if (center != mStreamCenter) {
+        mStreamCenter = center;
+        mStreamCursor = 0;
+
+        // a margin, so that crossing a chunk boundary back and forth does not churn
+        Coord limit = Coord(mViewDistance) + 2;
+        for (auto i = mStreamedChunks.begin(); i != mStreamedChunks.end(); ) {
+            Position d = i->second - center;
+            if (d.x * d.x + d.y * d.y + d.z * d.z > limit * limit) {
+                mChunkRenderer.release(i->second);
+                i = mStreamedChunks.erase(i);
+            } else {
+                ++i;
+            }
+        }
+    }
+
+    size_t requests = 0;
+    while (mStreamCursor < mStreamOrder.size() && requests < MaxRequests &&
+           mChunkRenderer.getBacklog() < MaxBacklog) {
+        Position chunk = center + mStreamOrder[mStreamCursor++];
+        if (mStreamedChunks.insert(std::make_pair(toPositionKey(chunk), chunk)).second) {
+            mChunkRenderer.request(chunk, ++mChunkVersion);
+            requests += 1;
+        }
+    }
+}
+
 void GameWindow::start3D() {
     GLChecked(glEnable(GL_DEPTH_TEST));
 
@@ -891,18 +1171,6 @@ void GameWindow::end2D() {
 }
 
 void GameWindow::render() {
-    char temp[256];
-    glm::vec3 p = mPlayer.getPosition();
-    glm::vec3 e = mPlayer.getEyePosition();
-    glm::vec2 o = mPlayer.getLook();
-    snprintf(temp, sizeof(temp),
-             "%.2ffps (%lldus/f, %lldus delay) / %.2ftps\n"
-             "%8.4f,%8.4f,%8.4f (%8.4f,%8.4f,%8.4f)\n"
-             "%8.4f,%8.4f",
-             mFramesPerSecond, mFrameLength.asMicroseconds(), mFrameDelay.asMicroseconds(), mTicksPerSecond,
-             p.x, p.y, p.z, e.x, e.y, e.z, o.x, o.y);
-    mDebugText.setString(temp);
-
     GLChecked(glClearColor(1,0,1,0));
     GLChecked(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
 
@@ -914,13 +1182,11 @@ void GameWindow::render() {
 
     // draw 3D scene
 
-    /**
-     * @todo
-     * for each visible chunk:
-     *      create vbo
-     *      convert blocks to polys
-     *      render vbo
-     */
+    glm::vec3 eye = glm::floor(mPlayer.getEyePosition() / float(ChunkData::Count));
+    Position eyeChunk(Coord(eye.x), Coord(eye.y), Coord(eye.z));
+
+    streamChunks(eyeChunk);
+    mChunkRenderer.upload();
 
     //! camera.render();
 
@@ -929,6 +1195,12 @@ void GameWindow::render() {
     glm::mat4 projectionTransform(mPlayer.getCamera().getTransform());
     glm::mat4 modelViewTransform(mPlayer.getTransform());
     glm::mat4 normalTransform(glm::transpose(glm::inverse(modelViewTransform)));
+    Frustum frustum(projectionTransform * modelViewTransform);
+
+    if (mChunkRenderer.begin(projectionTransform, modelViewTransform)) {
+        mChunkRenderer.renderVisible(eyeChunk, mViewDistance);
+        mChunkRenderer.end();
+    }
 
     static LightInfo defaultLight;
 
@@ -939,7 +1211,16 @@ void GameWindow::render() {
 
     char paramName[32];
 
+    mObjectCulling.reset();
+
     for (ClientObject *object : gObjects) {
+        mObjectCulling.tested += 1;
+
+        if (!object->isVisible(frustum)) {
+            mObjectCulling.culled += 1;
+            continue;
+        }
+
         sf::Shader *shader = object->getShader();
         if (shader) {
             sf::Shader::bind(shader);
@@ -976,6 +1257,7 @@ void GameWindow::render() {
             }
         }
         object->render();
+        mObjectCulling.drawn += 1;
     }
 
     end3D();
@@ -993,6 +1275,23 @@ void GameWindow::render() {
 
     // draw 2D overlay
 
+    char temp[512];
+    glm::vec3 p = mPlayer.getPosition();
+    glm::vec3 e = mPlayer.getEyePosition();
+    glm::vec2 o = mPlayer.getLook();
+    const CullStats &chunks = mChunkRenderer.getCulling();
+    snprintf(temp, sizeof(temp),
+             "%.2ffps (%lldus/f, %lldus delay) / %.2ftps\n"
+             "%8.4f,%8.4f,%8.4f (%8.4f,%8.4f,%8.4f)\n"
+             "%8.4f,%8.4f\n"
+             "chunks %zu tested, %zu culled, %zu drawn\n"
+             "objects %zu tested, %zu culled, %zu drawn",
+             mFramesPerSecond, mFrameLength.asMicroseconds(), mFrameDelay.asMicroseconds(), mTicksPerSecond,
+             p.x, p.y, p.z, e.x, e.y, e.z, o.x, o.y,
+             chunks.tested, chunks.culled, chunks.drawn,
+             mObjectCulling.tested, mObjectCulling.culled, mObjectCulling.drawn);
+    mDebugText.setString(temp);
+
     float frameLength = mFrameLength.asSeconds();
     float inputFrac = mInputLength.asSeconds() / frameLength;
     float updateFrac = mUpdateLength.asSeconds() / frameLength;
@@ -0,0 +1,255 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "broadphase.hpp"
+
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////////////
+
+static uint64_t cellKey(Coord x, Coord y, Coord z) {
+    return toPositionKey(Position(x, y, z));
+}
+
+static bool overlaps(const Position &minA, const Position &maxA, const Position &minB, const Position &maxB) {
+    return minA.x <= maxB.x && minB.x <= maxA.x &&
+           minA.y <= maxB.y && minB.y <= maxA.y &&
+           minA.z <= maxB.z && minB.z <= maxA.z;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+Broadphase::Broadphase(
+    unsigned int cellBits
+): mCellBits(cellBits), mProxies(), mFreeProxies(), mCells(), mPairsTested() {
+}
+
+Broadphase::Proxy Broadphase::insert(
+    const Position &position,
+    const Dimension &extents,
+    void *userData
+) {
+    Proxy proxy;
+
+    if (mFreeProxies.empty()) {
+        proxy = mProxies.size();
+        mProxies.resize(mProxies.size() + 1);
+    } else {
+        proxy = mFreeProxies.back();
+        mFreeProxies.pop_back();
+    }
+
+    ProxyData &data = mProxies[proxy];
+    setBounds(data, position, extents);
+    data.userData = userData;
+    data.used = true;
+    data.active = true;
+
+    addToCells(proxy);
+    return proxy;
+}
+
+Broadphase::Proxy Broadphase::insert(const Physics::Body &body, void *userData) {
+    return insert(body.getPosition(), body.getBounds().getExtents(), userData);
+}
+
+void Broadphase::update(
+    Proxy proxy,
+    const Position &position,
+    const Dimension &extents
+) {
+    ProxyData &data = mProxies[proxy];
+    Position cellMin = data.cellMin;
+    Position cellMax = data.cellMax;
+
+    setBounds(data, position, extents);
+
+    if (data.cellMin != cellMin || data.cellMax != cellMax) {
+        // moved into a different set of cells
+        Position newCellMin = data.cellMin;
+        Position newCellMax = data.cellMax;
+
+        data.cellMin = cellMin;
+        data.cellMax = cellMax;
+        removeFromCells(proxy);
+
+        data.cellMin = newCellMin;
+        data.cellMax = newCellMax;
+        addToCells(proxy);
+    }
+}
+
+void Broadphase::update(Proxy proxy, const Physics::Body &body) {
+    update(proxy, body.getPosition(), body.getBounds().getExtents());
+}
+
+void Broadphase::remove(Proxy proxy) {
+    removeFromCells(proxy);
+    mProxies[proxy].used = false;
+    mProxies[proxy].userData = nullptr;
+    mFreeProxies.push_back(proxy);
+}
+
+void *Broadphase::getUserData(Proxy proxy) const {
+    return mProxies[proxy].userData;
+}
+
+void Broadphase::setActive(Proxy proxy, bool active) {
+    mProxies[proxy].active = active;
+}
+
+size_t Broadphase::getProxyCount() const {
+    return mProxies.size() - mFreeProxies.size();
+}
+
+void Broadphase::findPairs(std::vector<Pair> &pairs) {
+    pairs.clear();
+    mPairsTested = 0;
+
+    for (auto &cell : mCells) {
+        const std::vector<Proxy> &proxies = cell.second;
+        size_t count = proxies.size();
+
+        bool active = false;
+        for (size_t i = 0; i < count && !active; i++) {
+            active = mProxies[proxies[i]].active;
+        }
+
+        if (!active) {
+            continue;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            const ProxyData &a = mProxies[proxies[i]];
+
+            for (size_t j = i + 1; j < count; j++) {
+                const ProxyData &b = mProxies[proxies[j]];
+
+                if (!a.active && !b.active) {
+                    continue;
+                }
+
+                mPairsTested += 1;
+
+                if (!overlaps(a.min, a.max, b.min, b.max)) {
+                    continue;
+                }
+
+                // a pair sharing several cells is only reported from the
+                // first cell they share
+                uint64_t first = cellKey(
+                    std::max(a.cellMin.x, b.cellMin.x),
+                    std::max(a.cellMin.y, b.cellMin.y),
+                    std::max(a.cellMin.z, b.cellMin.z)
+                );
+
+                if (first == cell.first) {
+                    Proxy p = proxies[i], q = proxies[j];
+                    pairs.push_back(p < q ? Pair(p, q) : Pair(q, p));
+                }
+            }
+        }
+    }
+
+    std::sort(pairs.begin(), pairs.end());
+}
+
+void Broadphase::query(
+    const Position &min,
+    const Position &max,
+    std::vector<Proxy> &proxies
+) const {
+    proxies.clear();
+
+    Position cellMin(min.x >> mCellBits, min.y >> mCellBits, min.z >> mCellBits);
+    Position cellMax(max.x >> mCellBits, max.y >> mCellBits, max.z >> mCellBits);
+
+    for (Coord z = cellMin.z; z <= cellMax.z; z++) {
+        for (Coord y = cellMin.y; y <= cellMax.y; y++) {
+            for (Coord x = cellMin.x; x <= cellMax.x; x++) {
+                auto found = mCells.find(cellKey(x, y, z));
+                if (found == mCells.end()) {
+                    continue;
+                }
+
+                for (Proxy proxy : found->second) {
+                    const ProxyData &data = mProxies[proxy];
+                    if (overlaps(min, max, data.min, data.max)) {
+                        proxies.push_back(proxy);
+                    }
+                }
+            }
+        }
+    }
+
+    // proxies spanning several cells are found once per cell
+    std::sort(proxies.begin(), proxies.end());
+    proxies.erase(std::unique(proxies.begin(), proxies.end()), proxies.end());
+}
+
+size_t Broadphase::getPairsTested() const {
+    return mPairsTested;
+}
+
+void Broadphase::addToCells(Proxy proxy) {
+    const ProxyData &data = mProxies[proxy];
+
+    for (Coord z = data.cellMin.z; z <= data.cellMax.z; z++) {
+        for (Coord y = data.cellMin.y; y <= data.cellMax.y; y++) {
+            for (Coord x = data.cellMin.x; x <= data.cellMax.x; x++) {
+                mCells[cellKey(x, y, z)].push_back(proxy);
+            }
+        }
+    }
+}
+
+void Broadphase::removeFromCells(Proxy proxy) {
+    const ProxyData &data = mProxies[proxy];
+
+    for (Coord z = data.cellMin.z; z <= data.cellMax.z; z++) {
+        for (Coord y = data.cellMin.y; y <= data.cellMax.y; y++) {
+            for (Coord x = data.cellMin.x; x <= data.cellMax.x; x++) {
+                auto found = mCells.find(cellKey(x, y, z));
+                if (found == mCells.end()) {
+                    continue;
+                }
+
+                std::vector<Proxy> &proxies = found->second;
+                auto i = std::find(proxies.begin(), proxies.end(), proxy);
+                if (i != proxies.end()) {
+                    *i = proxies.back();
+                    proxies.pop_back();
+                }
+
+                if (proxies.empty()) {
+                    mCells.erase(found);
+                }
+            }
+        }
+    }
+}
+
+void Broadphase::setBounds(
+    ProxyData &data,
+    const Position &position,
+    const Dimension &extents
+) const {
+    // grow by epsilon so touching boxes are reported too
+    Position size(
+        Coord(extents.x) + Physics::Epsilon,
+        Coord(extents.y) + Physics::Epsilon,
+        Coord(extents.z) + Physics::Epsilon
+    );
+
+    data.min = position - size;
+    data.max = position + size;
+
+    // arithmetic shift rounds toward negative infinity, as needed for cells
+    data.cellMin = Position(data.min.x >> mCellBits, data.min.y >> mCellBits, data.min.z >> mCellBits);
+    data.cellMax = Position(data.max.x >> mCellBits, data.max.y >> mCellBits, data.max.z >> mCellBits);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
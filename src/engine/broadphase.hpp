@@ -0,0 +1,104 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __BROADPHASE_HPP__
+#define __BROADPHASE_HPP__ 1
+
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstddef>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "physics.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ *  Uniform grid of bounding boxes, used to find pairs of bodies that may be
+ *  colliding without testing every pair.
+ *
+ *  Each proxy is listed in every grid cell its box overlaps.  Moving a proxy
+ *  only touches the grid when it crosses a cell boundary, so updating bodies
+ *  that move a little each tick is cheap.  Cells are 2^cellBits fixed-point
+ *  units wide (the default of 10 bits is 4 meters); cell coordinates must fit
+ *  in 21 bits, which covers a world of roughly +/-4000 km with the default.
+ */
+class Broadphase {
+public:
+    typedef uint32_t Proxy;
+    typedef std::pair<Proxy, Proxy> Pair;
+
+    static const Proxy Null = ~0u;
+
+private:
+    struct ProxyData {
+        Position min;
+        Position max;
+        Position cellMin;
+        Position cellMax;
+        void *userData;
+        bool used;
+        bool active;
+    };
+
+    unsigned int mCellBits;
+    std::vector<ProxyData> mProxies;
+    std::vector<Proxy> mFreeProxies;
+    std::unordered_map<uint64_t, std::vector<Proxy>> mCells;
+    size_t mPairsTested;
+
+public:
+    explicit Broadphase(unsigned int cellBits = 10);
+
+    Proxy insert(const Position &position, const Dimension &extents, void *userData = nullptr);
+    Proxy insert(const Physics::Body &body, void *userData = nullptr);
+
+    void update(Proxy proxy, const Position &position, const Dimension &extents);
+    void update(Proxy proxy, const Physics::Body &body);
+
+    void remove(Proxy proxy);
+
+    void *getUserData(Proxy proxy) const;
+
+    /**
+     *  Marks a proxy as active or not; pairs of two inactive proxies (such
+     *  as sleeping bodies) are skipped by findPairs.  Proxies start active.
+     */
+    void setActive(Proxy proxy, bool active);
+
+    size_t getProxyCount() const;
+
+    /**
+     *  Finds all pairs of proxies whose boxes intersect or touch (to within
+     *  Physics::Epsilon).  Pairs are given once each, as (lower, higher)
+     *  proxy, sorted so the result does not depend on insertion history.
+     */
+    void findPairs(std::vector<Pair> &pairs);
+
+    /**
+     *  Finds all proxies whose boxes intersect or touch the box [min, max],
+     *  sorted by proxy.
+     */
+    void query(const Position &min, const Position &max, std::vector<Proxy> &proxies) const;
+
+    /**
+     *  Gets the number of box tests done by the last call to findPairs.
+     */
+    size_t getPairsTested() const;
+
+private:
+    void addToCells(Proxy proxy);
+    void removeFromCells(Proxy proxy);
+    void setBounds(ProxyData &data, const Position &position, const Dimension &extents) const;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // __BROADPHASE_HPP__
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -7,12 +7,26 @@
 
 ////////////////////////////////////////////////////////////////////////////////
 
+#include "broadphase.hpp"
 #include "entity.hpp"
+#include "frustum.hpp"
+#include "jobs.hpp"
 #include "math.hpp"
+#include "meshbuilder.hpp"
+#include "mesher.hpp"
 #include "model.hpp"
 #include "network.hpp"
 #include "physics.hpp"
+#include "physicsworld.hpp"
+#include "profiler.hpp"
+#include "queue.hpp"
+#include "range.hpp"
+#include "raycast.hpp"
+#include "resource.hpp"
+#include "ring.hpp"
+#include "tick.hpp"
 #include "types.hpp"
+#include "visibility.hpp"
 #include "world.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -4,8 +4,18 @@
 
 #include "entity.hpp"
 
+#include <algorithm>
+
 ////////////////////////////////////////////////////////////////////////////////
 
+Entity::Entity(
+    EntityID id,
+    const Position &position,
+    const Velocity &velocity,
+    const Orientation &orientation
+): mID(id), mPosition(position), mVelocity(velocity), mOrientation(orientation) {
+}
+
 EntityID Entity::getID() const {
     return mID;
 }
@@ -28,7 +38,352 @@ void Entity::update() {
     mPosition.z += mVelocity.z;
 }
 
+void Entity::update(EntityIndex &index) {
+    Position from = mPosition;
+    update();
+    index.move(mID, from, mPosition);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
-//  EOF
+
+EntityIDAllocator::EntityIDAllocator(
+): mGenerations(), mAlive(), mFree() {
+}
+
+EntityID EntityIDAllocator::allocate() {
+    uint32_t index;
+
+    // reuse the oldest index, so generations of one index advance slowly
+    if (mFree.empty()) {
+        index = mGenerations.size();
+        mGenerations.push_back(1);
+        mAlive.push_back(true);
+    } else {
+        index = mFree.front();
+        mFree.pop_front();
+        mAlive[index] = true;
+    }
+
+    return makeID(index, mGenerations[index]);
+}
+
+bool EntityIDAllocator::release(EntityID id) {
+    if (!isAlive(id)) {
+        return false;
+    }
+
+    uint32_t index = getIndex(id);
+    uint32_t &generation = mGenerations[index];
+
+    generation += 1;
+    if (generation == 0) {
+        generation = 1;
+    }
+
+    mAlive[index] = false;
+    mFree.push_back(index);
+    return true;
+}
+
+bool EntityIDAllocator::isAlive(EntityID id) const {
+    uint32_t index = getIndex(id);
+    return index < mGenerations.size() && mAlive[index] && mGenerations[index] == getGeneration(id);
+}
+
+void EntityIDAllocator::clear() {
+    mGenerations.clear();
+    mAlive.clear();
+    mFree.clear();
+}
+
+size_t EntityIDAllocator::size() const {
+    return mGenerations.size() - mFree.size();
+}
+
+size_t EntityIDAllocator::getCapacity() const {
+    return mGenerations.size();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static const uint32_t NoSlot = ~uint32_t(0);
+
+const size_t EntityRegistry::Null;
+
+EntityRegistry::EntityRegistry(
+): mPages(), mIDs(), mPositions(), mVelocities(), mOrientations(), mBounds(), mAI() {
+}
+
+size_t EntityRegistry::insert(const Entity &entity, const BoundingVolume &bounds) {
+    EntityID id = entity.getID();
+    uint32_t index = EntityIDAllocator::getIndex(id);
+    size_t page = index >> PageBits;
+
+    if (page >= mPages.size()) {
+        mPages.resize(page + 1);
+    }
+    if (mPages[page].empty()) {
+        mPages[page].assign(size_t(1) << PageBits, NoSlot);
+    }
+
+    uint32_t *slot = &mPages[page][index & ((1 << PageBits) - 1)];
+    if (*slot != NoSlot) {
+        uint32_t generation = EntityIDAllocator::getGeneration(mIDs[*slot]);
+        if (!EntityIDAllocator::isNewer(EntityIDAllocator::getGeneration(id), generation)) {
+            return Null;
+        }
+
+        // the old entity was despawned without us hearing of it
+        erase(mIDs[*slot]);
+        slot = getSlot(index);
+    }
+
+    *slot = mIDs.size();
+    mIDs.push_back(id);
+    mPositions.push_back(entity.getPosition());
+    mVelocities.push_back(entity.getVelocity());
+    mOrientations.push_back(entity.getOrientation());
+    mBounds.push_back(bounds);
+    mAI.push_back(EntityAI());
+
+    return *slot;
+}
+
+bool EntityRegistry::erase(EntityID id) {
+    uint32_t *slot = getSlot(EntityIDAllocator::getIndex(id));
+    if (!slot || *slot == NoSlot || mIDs[*slot] != id) {
+        return false;
+    }
+
+    size_t index = *slot;
+    size_t last = mIDs.size() - 1;
+
+    if (index != last) {
+        mIDs[index] = mIDs[last];
+        mPositions[index] = mPositions[last];
+        mVelocities[index] = mVelocities[last];
+        mOrientations[index] = mOrientations[last];
+        mBounds[index] = mBounds[last];
+        mAI[index] = mAI[last];
+        *getSlot(EntityIDAllocator::getIndex(mIDs[index])) = index;
+    }
+
+    *slot = NoSlot;
+
+    mIDs.pop_back();
+    mPositions.pop_back();
+    mVelocities.pop_back();
+    mOrientations.pop_back();
+    mBounds.pop_back();
+    mAI.pop_back();
+
+    return true;
+}
+
+void EntityRegistry::clear() {
+    mPages.clear();
+    mIDs.clear();
+    mPositions.clear();
+    mVelocities.clear();
+    mOrientations.clear();
+    mBounds.clear();
+    mAI.clear();
+}
+
+bool EntityRegistry::contains(EntityID id) const {
+    return find(id) != Null;
+}
+
+size_t EntityRegistry::find(EntityID id) const {
+    const uint32_t *slot = getSlot(EntityIDAllocator::getIndex(id));
+    return slot && *slot != NoSlot && mIDs[*slot] == id ? *slot : Null;
+}
+
+size_t EntityRegistry::size() const {
+    return mIDs.size();
+}
+
+Entity EntityRegistry::getEntity(size_t index) const {
+    return Entity(mIDs[index], mPositions[index], mVelocities[index], mOrientations[index]);
+}
+
+void EntityRegistry::update() {
+    size_t count = mIDs.size();
+    Position *position = mPositions.data();
+    const Velocity *velocity = mVelocities.data();
+
+    for (size_t i = 0; i < count; i++) {
+        position[i].x += velocity[i].x;
+        position[i].y += velocity[i].y;
+        position[i].z += velocity[i].z;
+    }
+}
+
+void EntityRegistry::update(EntityIndex &index) {
+    size_t count = mIDs.size();
+    Position *position = mPositions.data();
+    const Velocity *velocity = mVelocities.data();
+
+    for (size_t i = 0; i < count; i++) {
+        Position from = position[i];
+        position[i].x += velocity[i].x;
+        position[i].y += velocity[i].y;
+        position[i].z += velocity[i].z;
+        index.move(mIDs[i], from, position[i]);
+    }
+}
+
+uint32_t *EntityRegistry::getSlot(uint32_t index) {
+    return const_cast<uint32_t *>(static_cast<const EntityRegistry *>(this)->getSlot(index));
+}
+
+const uint32_t *EntityRegistry::getSlot(uint32_t index) const {
+    size_t page = index >> PageBits;
+    if (page >= mPages.size() || mPages[page].empty()) {
+        return nullptr;
+    }
+    return &mPages[page][index & ((1 << PageBits) - 1)];
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
+EntityIndex::EntityIndex(
+): mChunks(), mSize() {
+}
+
+void EntityIndex::insert(EntityID id, const Position &position) {
+    mChunks[toPositionKey(getChunk(position))].push_back(id);
+    mSize += 1;
+}
+
+bool EntityIndex::remove(EntityID id, const Position &position) {
+    auto found = mChunks.find(toPositionKey(getChunk(position)));
+    if (found == mChunks.end()) {
+        return false;
+    }
+
+    std::vector<EntityID> &ids = found->second;
+    auto i = std::find(ids.begin(), ids.end(), id);
+    if (i == ids.end()) {
+        return false;
+    }
+
+    *i = ids.back();
+    ids.pop_back();
+    mSize -= 1;
+
+    if (ids.empty()) {
+        mChunks.erase(found);
+    }
+
+    return true;
+}
+
+void EntityIndex::move(EntityID id, const Position &from, const Position &to) {
+    Position a = getChunk(from);
+    Position b = getChunk(to);
+
+    if (a != b && remove(id, from)) {
+        insert(id, to);
+    }
+}
+
+void EntityIndex::insert(const EntityRegistry &registry) {
+    const std::vector<EntityID> &ids = registry.getIDs();
+    const std::vector<Position> &positions = registry.getPositions();
+
+    for (size_t i = 0; i < ids.size(); i++) {
+        insert(ids[i], positions[i]);
+    }
+}
+
+void EntityIndex::clear() {
+    mChunks.clear();
+    mSize = 0;
+}
+
+size_t EntityIndex::size() const {
+    return mSize;
+}
+
+const std::vector<EntityID> *EntityIndex::getEntities(const Position &chunk) const {
+    auto found = mChunks.find(toPositionKey(chunk));
+    return found == mChunks.end() ? nullptr : &found->second;
+}
+
+void EntityIndex::findCandidates(
+    const Position &min,
+    const Position &max,
+    std::vector<EntityID> &ids
+) const {
+    ids.clear();
+
+    Position chunkMin = getChunk(min);
+    Position chunkMax = getChunk(max);
+
+    for (Coord z = chunkMin.z; z <= chunkMax.z; z++) {
+        for (Coord y = chunkMin.y; y <= chunkMax.y; y++) {
+            for (Coord x = chunkMin.x; x <= chunkMax.x; x++) {
+                auto found = mChunks.find(toPositionKey(Position(x, y, z)));
+                if (found != mChunks.end()) {
+                    ids.insert(ids.end(), found->second.begin(), found->second.end());
+                }
+            }
+        }
+    }
+
+    // each entity is in one chunk, so there are no duplicates
+    std::sort(ids.begin(), ids.end());
+}
+
+void EntityIndex::queryBox(
+    const Position &min,
+    const Position &max,
+    const EntityRegistry &registry,
+    std::vector<EntityID> &ids
+) const {
+    findCandidates(min, max, ids);
+
+    const std::vector<Position> &positions = registry.getPositions();
+
+    auto outside = [&](EntityID id) {
+        size_t index = registry.find(id);
+        if (index == EntityRegistry::Null) {
+            return true;
+        }
+
+        const Position &p = positions[index];
+        return p.x < min.x || p.x > max.x || p.y < min.y || p.y > max.y || p.z < min.z || p.z > max.z;
+    };
+
+    ids.erase(std::remove_if(ids.begin(), ids.end(), outside), ids.end());
+}
+
+void EntityIndex::queryRadius(
+    const Position &center,
+    Coord radius,
+    const EntityRegistry &registry,
+    std::vector<EntityID> &ids
+) const {
+    Position extents(radius, radius, radius);
+    findCandidates(center - extents, center + extents, ids);
+
+    const std::vector<Position> &positions = registry.getPositions();
+    uint64_t radiusSq = uint64_t(radius) * uint64_t(radius);
+
+    auto outside = [&](EntityID id) {
+        size_t index = registry.find(id);
+        if (index == EntityRegistry::Null) {
+            return true;
+        }
+
+        Position d = positions[index] - center;
+        return uint64_t(d.x * d.x) + uint64_t(d.y * d.y) + uint64_t(d.z * d.z) > radiusSq;
+    };
+
+    ids.erase(std::remove_if(ids.begin(), ids.end(), outside), ids.end());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -7,10 +7,19 @@
 
 ////////////////////////////////////////////////////////////////////////////////
 
+#include <cstddef>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include "physics.hpp"
 #include "types.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////
 
+class EntityIndex;
+class EntityRegistry;
+
 class Entity {
     EntityID mID;
     Position mPosition;
@@ -18,12 +27,270 @@ class Entity {
     Orientation mOrientation;
 
 public:
+    Entity(
+        EntityID id,
+        const Position &position,
+        const Velocity &velocity,
+        const Orientation &orientation
+    );
+
     EntityID getID() const;
     const Position &getPosition() const;
     const Velocity &getVelocity() const;
     const Orientation &getOrientation() const;
 
     void update();
+
+    /**
+     *  Updates, moving the entity between chunks of the index if it crosses
+     *  a chunk boundary.
+     */
+    void update(EntityIndex &index);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ *  Hands out entity ids made of an index (low 32 bits) and a generation
+ *  (high 32 bits).  Released indices are reused oldest first, with the
+ *  generation bumped, so an id kept after its entity is gone (by a stale
+ *  packet, or an AI target) never resolves to the entity that replaced it.
+ *
+ *  Generations start at 1, so 0 is never a valid id and can mean "none".
+ *  Indices are dense, so they can key flat tables (see EntityRegistry)
+ *  without hashing.
+ */
+class EntityIDAllocator {
+    std::vector<uint32_t> mGenerations;     //!< Current generation per index
+    std::vector<bool> mAlive;
+    std::deque<uint32_t> mFree;
+
+public:
+    EntityIDAllocator();
+
+    static EntityID makeID(uint32_t index, uint32_t generation) {
+        return (EntityID(generation) << 32) | index;
+    }
+
+    static uint32_t getIndex(EntityID id) {
+        return uint32_t(id);
+    }
+
+    static uint32_t getGeneration(EntityID id) {
+        return uint32_t(id >> 32);
+    }
+
+    /**
+     *  Compares generations allowing for wraparound, as sequence numbers.
+     */
+    static bool isNewer(uint32_t generation, uint32_t than) {
+        return int32_t(generation - than) > 0;
+    }
+
+    EntityID allocate();
+
+    /**
+     *  Frees an id for reuse, returning false if it is not alive.
+     */
+    bool release(EntityID id);
+
+    bool isAlive(EntityID id) const;
+
+    void clear();
+
+    /**
+     *  Gets the number of ids alive.
+     */
+    size_t size() const;
+
+    /**
+     *  Gets the number of indices ever used; every live index is below it.
+     */
+    size_t getCapacity() const;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ *  Behaviour state of a mob.
+ */
+struct EntityAI {
+    enum Mode : uint8_t {
+        Idle,
+        Wander,
+        Chase,
+        Flee
+    };
+
+    Mode mode;
+    uint16_t timer;     //!< Ticks until the mode is reconsidered
+    EntityID target;    //!< Entity chased or fled from
+
+    EntityAI(): mode(Idle), timer(0), target(0) {}
+};
+
+/**
+ *  Entities stored as dense arrays per component, so that systems (such as
+ *  update) run over contiguous memory rather than through one object per
+ *  entity.
+ *
+ *  Entity ids map to array indices through a sparse set: a paged table
+ *  keyed by the index part of the id (see EntityIDAllocator), plus the
+ *  full id of each array index, which rejects stale generations.  Lookups,
+ *  insertions and removals are O(1); removal moves the last entity into
+ *  the freed index, so indices are only stable until the next removal.
+ *  Pages of the table are allocated as ids use them, so ids should come
+ *  from an EntityIDAllocator or otherwise be dense.
+ */
+class EntityRegistry {
+public:
+    static const size_t Null = ~size_t(0);
+
+private:
+    static const unsigned int PageBits = 12;
+
+    std::vector<std::vector<uint32_t>> mPages;
+
+    std::vector<EntityID> mIDs;
+    std::vector<Position> mPositions;
+    std::vector<Velocity> mVelocities;
+    std::vector<Orientation> mOrientations;
+    std::vector<BoundingVolume> mBounds;
+    std::vector<EntityAI> mAI;
+
+public:
+    EntityRegistry();
+
+    /**
+     *  Adds an entity, returning its index, or Null if the id is in use or
+     *  older than the entity holding its id index.  An entity of an older
+     *  generation is replaced, as when a despawn was missed.
+     */
+    size_t insert(const Entity &entity, const BoundingVolume &bounds = BoundingVolume());
+
+    bool erase(EntityID id);
+    void clear();
+
+    bool contains(EntityID id) const;
+
+    /**
+     *  Gets the index of an entity, or Null if there is none.
+     */
+    size_t find(EntityID id) const;
+
+    size_t size() const;
+
+    Entity getEntity(size_t index) const;
+
+    // component arrays, indexed alike
+    const std::vector<EntityID> &getIDs() const { return mIDs; }
+    std::vector<Position> &getPositions() { return mPositions; }
+    const std::vector<Position> &getPositions() const { return mPositions; }
+    std::vector<Velocity> &getVelocities() { return mVelocities; }
+    const std::vector<Velocity> &getVelocities() const { return mVelocities; }
+    std::vector<Orientation> &getOrientations() { return mOrientations; }
+    const std::vector<Orientation> &getOrientations() const { return mOrientations; }
+    std::vector<BoundingVolume> &getBounds() { return mBounds; }
+    const std::vector<BoundingVolume> &getBounds() const { return mBounds; }
+    std::vector<EntityAI> &getAI() { return mAI; }
+    const std::vector<EntityAI> &getAI() const { return mAI; }
+
+    /**
+     *  Moves every entity by its velocity, as Entity::update does.
+     */
+    void update();
+
+    /**
+     *  Updates, moving entities between chunks of the index as they cross
+     *  chunk boundaries.
+     */
+    void update(EntityIndex &index);
+
+private:
+    uint32_t *getSlot(uint32_t index);
+    const uint32_t *getSlot(uint32_t index) const;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ *  The entities in each chunk, for finding entities near a position.
+ *
+ *  Buckets are keyed by chunk position rather than kept in Chunk, so they
+ *  outlive the chunk cache evicting their chunk.  Only ids are stored:
+ *  the index is told when an entity crosses a chunk boundary (see
+ *  Entity::update) and costs nothing while it stays in its chunk, and
+ *  queries check the exact positions in the registry.  Chunk coordinates
+ *  must fit in 21 bits, as in Broadphase.
+ */
+class EntityIndex {
+    std::unordered_map<uint64_t, std::vector<EntityID>> mChunks;
+    size_t mSize;
+
+public:
+    EntityIndex();
+
+    /**
+     *  Gets the chunk containing an entity position.
+     */
+    static Position getChunk(const Position &position) {
+        return toChunkPosition(toBlockPosition(position));
+    }
+
+    void insert(EntityID id, const Position &position);
+
+    /**
+     *  Removes an entity, given its position as last inserted or moved.
+     */
+    bool remove(EntityID id, const Position &position);
+
+    /**
+     *  Moves an entity between chunks; does nothing if both positions are
+     *  in the same chunk.
+     */
+    void move(EntityID id, const Position &from, const Position &to);
+
+    /**
+     *  Adds every entity of a registry.
+     */
+    void insert(const EntityRegistry &registry);
+
+    void clear();
+
+    size_t size() const;
+
+    /**
+     *  Gets the entities in a chunk, or nullptr if there are none.
+     */
+    const std::vector<EntityID> *getEntities(const Position &chunk) const;
+
+    /**
+     *  Finds the entities in every chunk the box [min, max] overlaps; some
+     *  may be outside the box.  Ids are sorted.
+     */
+    void findCandidates(const Position &min, const Position &max, std::vector<EntityID> &ids) const;
+
+    /**
+     *  Finds the entities of a registry inside the box [min, max].  Ids
+     *  are sorted.
+     */
+    void queryBox(
+        const Position &min,
+        const Position &max,
+        const EntityRegistry &registry,
+        std::vector<EntityID> &ids
+    ) const;
+
+    /**
+     *  Finds the entities of a registry within radius of center.  Ids are
+     *  sorted.
+     */
+    void queryRadius(
+        const Position &center,
+        Coord radius,
+        const EntityRegistry &registry,
+        std::vector<EntityID> &ids
+    ) const;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -33,4 +300,3 @@ public:
 ////////////////////////////////////////////////////////////////////////////////
 //  EOF
 ////////////////////////////////////////////////////////////////////////////////
-
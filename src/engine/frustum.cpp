@@ -0,0 +1,110 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "frustum.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+Frustum::Frustum(
+): mPlanes() {
+}
+
+Frustum::Frustum(
+    const glm::mat4 &viewProjection
+): mPlanes() {
+    set(viewProjection);
+}
+
+void Frustum::set(const glm::mat4 &m) {
+    // rows of the matrix; glm is column major
+    glm::vec4 x(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 y(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 z(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 w(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    // clip space is inside where -w <= x, y, z <= w
+    mPlanes[Left] = w + x;
+    mPlanes[Right] = w - x;
+    mPlanes[Bottom] = w + y;
+    mPlanes[Top] = w - y;
+    mPlanes[Near] = w + z;
+    mPlanes[Far] = w - z;
+
+    for (glm::vec4 &plane : mPlanes) {
+        float length = glm::length(glm::vec3(plane));
+        if (length > 0) {
+            plane /= length;
+        }
+    }
+}
+
+const glm::vec4 &Frustum::getPlane(Plane plane) const {
+    return mPlanes[plane];
+}
+
+bool Frustum::contains(const glm::vec3 &point) const {
+    for (const glm::vec4 &plane : mPlanes) {
+        if (glm::dot(glm::vec3(plane), point) + plane.w < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Frustum::intersects(const glm::vec3 &center, float radius) const {
+    for (const glm::vec4 &plane : mPlanes) {
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Frustum::intersects(const glm::vec3 &low, const glm::vec3 &high) const {
+    for (const glm::vec4 &plane : mPlanes) {
+        // the corner furthest along the plane's normal
+        glm::vec3 far(
+            plane.x >= 0 ? high.x : low.x,
+            plane.y >= 0 ? high.y : low.y,
+            plane.z >= 0 ? high.z : low.z
+        );
+
+        if (glm::dot(glm::vec3(plane), far) + plane.w < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+Frustum::Result Frustum::classify(const glm::vec3 &low, const glm::vec3 &high) const {
+    Result result = Inside;
+
+    for (const glm::vec4 &plane : mPlanes) {
+        glm::vec3 normal(plane);
+        glm::vec3 far(
+            plane.x >= 0 ? high.x : low.x,
+            plane.y >= 0 ? high.y : low.y,
+            plane.z >= 0 ? high.z : low.z
+        );
+        glm::vec3 near(
+            plane.x >= 0 ? low.x : high.x,
+            plane.y >= 0 ? low.y : high.y,
+            plane.z >= 0 ? low.z : high.z
+        );
+
+        if (glm::dot(normal, far) + plane.w < 0) {
+            return Outside;
+        }
+
+        if (glm::dot(normal, near) + plane.w < 0) {
+            result = Intersects;
+        }
+    }
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
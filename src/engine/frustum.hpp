@@ -0,0 +1,93 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __FRUSTUM_HPP__
+#define __FRUSTUM_HPP__ 1
+
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstddef>
+#include <glm/glm.hpp>
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ *  The six planes of a view volume, taken from a projection times view
+ *  matrix, for testing what can be seen before drawing it.
+ *
+ *  Each plane is (normal, distance), normalized, with the inside where
+ *  dot(normal, point) + distance >= 0.  A default frustum has all-zero
+ *  planes, and so contains everything.
+ */
+class Frustum {
+public:
+    enum Plane {
+        Left,
+        Right,
+        Bottom,
+        Top,
+        Near,
+        Far,
+        PlaneCount
+    };
+
+    enum Result {
+        Outside,
+        Intersects,
+        Inside
+    };
+
+private:
+    glm::vec4 mPlanes[PlaneCount];
+
+public:
+    Frustum();
+    explicit Frustum(const glm::mat4 &viewProjection);
+
+    void set(const glm::mat4 &viewProjection);
+    const glm::vec4 &getPlane(Plane plane) const;
+
+    bool contains(const glm::vec3 &point) const;
+
+    /**
+     *  Whether a sphere is at least partly inside.  Conservative: a sphere
+     *  just outside a corner, near two planes, may pass.
+     */
+    bool intersects(const glm::vec3 &center, float radius) const;
+
+    /**
+     *  Whether an axis-aligned box is at least partly inside, with the same
+     *  leeway at the corners.
+     */
+    bool intersects(const glm::vec3 &low, const glm::vec3 &high) const;
+
+    /**
+     *  Whether an axis-aligned box is outside, inside, or crossing planes.
+     */
+    Result classify(const glm::vec3 &low, const glm::vec3 &high) const;
+};
+
+/**
+ *  Counts of things tested against a frustum in a frame: how many were
+ *  culled, and how many of the rest were drawn.
+ */
+struct CullStats {
+    size_t tested;
+    size_t culled;
+    size_t drawn;
+
+    CullStats(): tested(0), culled(0), drawn(0) {}
+
+    void reset() {
+        tested = culled = drawn = 0;
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // __FRUSTUM_HPP__
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
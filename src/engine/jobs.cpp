@@ -0,0 +1,105 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "jobs.hpp"
+
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////////////
+
+JobPool::JobPool(
+    unsigned int threads
+): mThreads(), mMutex(), mStart(), mFinish(), mJob(nullptr), mCount(0),
+   mNext(0), mBusy(0), mGeneration(0), mQuit(false) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (unsigned int i = 1; i < threads; i++) {
+        mThreads.push_back(std::thread(&JobPool::work, this));
+    }
+}
+
+JobPool::~JobPool() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQuit = true;
+    }
+
+    mStart.notify_all();
+
+    for (std::thread &thread : mThreads) {
+        thread.join();
+    }
+}
+
+unsigned int JobPool::getThreadCount() const {
+    return mThreads.size() + 1;
+}
+
+void JobPool::run(size_t count, const Job &job) {
+    if (mThreads.empty() || count <= 1) {
+        for (size_t i = 0; i < count; i++) {
+            job(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mJob = &job;
+        mCount = count;
+        mNext = 0;
+        mBusy = mThreads.size();
+        mGeneration += 1;
+    }
+
+    mStart.notify_all();
+    runJobs(job, count);
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    mFinish.wait(lock, [this] { return mBusy == 0; });
+    mJob = nullptr;
+}
+
+void JobPool::work() {
+    unsigned int generation = 0;
+
+    for (;;) {
+        const Job *job;
+        size_t count;
+
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mStart.wait(lock, [this, generation] { return mQuit || mGeneration != generation; });
+
+            if (mQuit) {
+                return;
+            }
+
+            generation = mGeneration;
+            job = mJob;
+            count = mCount;
+        }
+
+        runJobs(*job, count);
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mBusy -= 1;
+        }
+
+        mFinish.notify_one();
+    }
+}
+
+void JobPool::runJobs(const Job &job, size_t count) {
+    for (size_t i = mNext++; i < count; i = mNext++) {
+        job(i);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
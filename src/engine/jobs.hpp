@@ -0,0 +1,74 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __JOBS_HPP__
+#define __JOBS_HPP__ 1
+
+////////////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ *  Fixed set of worker threads running parallel loops.
+ *
+ *  run() hands out job indices to the workers and the calling thread, and
+ *  returns once every index is done.  Which thread runs which index is not
+ *  fixed, so jobs must not share mutable state if results are to be
+ *  independent of the thread count.
+ */
+class JobPool {
+public:
+    typedef std::function<void(size_t)> Job;
+
+private:
+    std::vector<std::thread> mThreads;
+    std::mutex mMutex;
+    std::condition_variable mStart;
+    std::condition_variable mFinish;
+
+    const Job *mJob;
+    size_t mCount;
+    std::atomic<size_t> mNext;
+    unsigned int mBusy;
+    unsigned int mGeneration;
+    bool mQuit;
+
+public:
+    /**
+     *  Creates a pool of the given number of threads, counting the thread
+     *  calling run(); zero uses one thread per hardware core.
+     */
+    explicit JobPool(unsigned int threads = 0);
+    ~JobPool();
+
+    JobPool(const JobPool &) = delete;
+    JobPool &operator=(const JobPool &) = delete;
+
+    unsigned int getThreadCount() const;
+
+    /**
+     *  Calls job(i) for every i in [0, count), in parallel.
+     */
+    void run(size_t count, const Job &job);
+
+private:
+    void work();
+    void runJobs(const Job &job, size_t count);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // __JOBS_HPP__
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
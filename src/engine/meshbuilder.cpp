@@ -0,0 +1,237 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "meshbuilder.hpp"
+
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////////////
+
+ChunkSnapshot ChunkSnapshot::take(ChunkCache &cache, const Position &position) {
+    ChunkSnapshot snapshot;
+    snapshot.position = position;
+
+    // getChunk may evict any chunk, so each is copied before the next lookup
+    snapshot.chunk = std::make_shared<ChunkData>(*cache.getChunk(position)->getData());
+
+    for (int face = 0; face < 6; face++) {
+        BlockFace blockFace = BlockFace(face + 1);
+        Position neighbour = ChunkMesher::getNeighbour(position, blockFace);
+        snapshot.borders[face] = std::make_shared<ChunkBorder>(*cache.getChunk(neighbour)->getData(), blockFace);
+    }
+
+    return snapshot;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+MeshBuilder::MeshBuilder(
+    unsigned int threads,
+    const ChunkMesher &mesher,
+    ChunkMesher::Mode mode,
+    Format format
+): mPrototype(mesher), mMode(mode), mFormat(format), mThreads(), mMutex(), mWake(), mIdle(),
+   mCacheMutex(), mCache(), mRequests(), mBusy(0), mQuit(false), mFinished(), mFinishedCount(0),
+   mPending(0) {
+    if (threads == 0) {
+        threads = std::max(2u, std::thread::hardware_concurrency()) - 1;
+    }
+
+    for (unsigned int i = 0; i < threads; i++) {
+        mThreads.push_back(std::thread(&MeshBuilder::work, this));
+    }
+}
+
+MeshBuilder::~MeshBuilder() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQuit = true;
+        mRequests.clear();
+    }
+
+    mWake.notify_all();
+
+    for (std::thread &thread : mThreads) {
+        thread.join();
+    }
+}
+
+unsigned int MeshBuilder::getThreadCount() const {
+    return mThreads.size();
+}
+
+void MeshBuilder::setSource(ChunkSource &source, size_t capacity) {
+    std::lock_guard<std::mutex> lock(mCacheMutex);
+    mCache.reset(new ChunkCache(source, capacity));
+}
+
+void MeshBuilder::submit(const ChunkSnapshot &snapshot, uint64_t version) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mRequests.push_back(Request { snapshot, version, false });
+    }
+
+    mPending += 1;
+    mWake.notify_one();
+}
+
+void MeshBuilder::submit(const Position &chunk, uint64_t version) {
+    ChunkSnapshot snapshot;
+    snapshot.position = chunk;
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mRequests.push_back(Request { snapshot, version, true });
+    }
+
+    mPending += 1;
+    mWake.notify_one();
+}
+
+bool MeshBuilder::poll(ChunkMesh &mesh) {
+    if (!mFinished.pop(mesh)) {
+        return false;
+    }
+
+    mFinishedCount -= 1;
+    mPending -= 1;
+    return true;
+}
+
+size_t MeshBuilder::getPendingCount() const {
+    return mPending;
+}
+
+size_t MeshBuilder::getFinishedCount() const {
+    return mFinishedCount;
+}
+
+void MeshBuilder::cancel() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mPending -= mRequests.size();
+    mRequests.clear();
+}
+
+void MeshBuilder::wait() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mIdle.wait(lock, [this] { return mRequests.empty() && mBusy == 0; });
+}
+
+void MeshBuilder::work() {
+    // each worker has its own mesher, as its block grid is scratch space
+    std::unique_ptr<ChunkMesher> mesher(new ChunkMesher(mPrototype));
+
+    for (;;) {
+        Request request;
+
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWake.wait(lock, [this] { return mQuit || !mRequests.empty(); });
+
+            if (mQuit) {
+                return;
+            }
+
+            request = std::move(mRequests.front());
+            mRequests.pop_front();
+            mBusy += 1;
+        }
+
+        const ChunkSnapshot &snapshot = request.snapshot;
+        bool loaded = false;
+
+        if (request.load) {
+            // the cache loads and evicts on lookup, so one worker at a time
+            std::lock_guard<std::mutex> lock(mCacheMutex);
+            if (mCache) {
+                mesher->load(*mCache, snapshot.position);
+                loaded = true;
+            }
+        } else if (snapshot.chunk) {
+            const ChunkBorder *borders[6];
+            for (int face = 0; face < 6; face++) {
+                borders[face] = snapshot.borders[face].get();
+            }
+
+            mesher->load(*snapshot.chunk, borders);
+            loaded = true;
+        }
+
+        ChunkMesh mesh;
+        mesh.position = snapshot.position;
+        mesh.version = request.version;
+
+        if (loaded) {
+            if (mFormat == Packed) {
+                mesher->build(mesh.packed, mMode);
+            } else {
+                mesher->build(mesh.model, mMode);
+            }
+            mesh.faces = mesher->getFaceCount();
+            mesh.connectivity = mesher->getConnectivity();
+        }
+
+        // counted before the push, so the count never runs below zero
+        mFinishedCount += 1;
+        mFinished.push(std::move(mesh));
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mBusy -= 1;
+        }
+
+        mIdle.notify_all();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+UploadBudget::UploadBudget(
+    size_t maxBytes,
+    sf::Time maxTime
+): mMaxBytes(maxBytes), mMaxTime(maxTime), mClock(), mBytes(0), mUploads(0) {
+}
+
+void UploadBudget::reset() {
+    mClock.restart();
+    mBytes = 0;
+    mUploads = 0;
+}
+
+bool UploadBudget::allows(size_t bytes) const {
+    if (mUploads == 0) {
+        return true;
+    }
+
+    return mBytes + bytes <= mMaxBytes && mClock.getElapsedTime() < mMaxTime;
+}
+
+void UploadBudget::spend(size_t bytes) {
+    mBytes += bytes;
+    mUploads += 1;
+}
+
+size_t UploadBudget::getMaxBytes() const {
+    return mMaxBytes;
+}
+
+sf::Time UploadBudget::getMaxTime() const {
+    return mMaxTime;
+}
+
+size_t UploadBudget::getBytes() const {
+    return mBytes;
+}
+
+size_t UploadBudget::getUploads() const {
+    return mUploads;
+}
+
+sf::Time UploadBudget::getElapsedTime() const {
+    return mClock.getElapsedTime();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
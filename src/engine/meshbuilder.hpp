@@ -0,0 +1,217 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __MESHBUILDER_HPP__
+#define __MESHBUILDER_HPP__ 1
+
+////////////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <SFML/System/Clock.hpp>
+#include <SFML/System/Time.hpp>
+
+#include "mesher.hpp"
+#include "model.hpp"
+#include "queue.hpp"
+#include "types.hpp"
+#include "world.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ *  Immutable copy of a chunk and the borders of its neighbours (in
+ *  BlockFace order) for meshing away from the thread that owns the chunks.
+ *  A missing border is null, and counts as opaque.
+ */
+struct ChunkSnapshot {
+    Position position;
+    std::shared_ptr<const ChunkData> chunk;
+    std::shared_ptr<const ChunkBorder> borders[6];
+
+    /**
+     *  Copies a chunk and its neighbours' borders out of a cache.
+     */
+    static ChunkSnapshot take(ChunkCache &cache, const Position &position);
+};
+
+/**
+ *  A finished chunk mesh, in model or packed as the builder was asked.
+ *  version is whatever was given with the request, so that results for
+ *  chunks changed since can be told apart.  connectivity is for
+ *  ChunkVisibility.
+ */
+struct ChunkMesh {
+    Position position;
+    uint64_t version;
+    Model model;
+    PackedModel packed;
+    size_t faces;
+    ChunkConnectivity connectivity;
+
+    ChunkMesh(): position(), version(), model(), packed(), faces(), connectivity() {}
+};
+
+/**
+ *  Builds chunk meshes on background threads.
+ *
+ *  submit() queues a snapshot for the workers, each of which meshes with
+ *  its own copy of the given ChunkMesher (so texture rectangles must be set
+ *  before the builder is created).  Finished meshes are pushed to a
+ *  lock-free queue, so workers never wait on the thread taking them, and
+ *  poll() hands them out in the order they were finished.
+ *
+ *  Chunks may instead be submitted by position alone, once the builder has
+ *  a source: the workers then load them through a cache of their own,
+ *  generating any that are missing, so that the submitting thread never
+ *  waits on chunk data.  The workers take turns with that cache.
+ *
+ *  submit() and poll() are meant for one owning thread, usually the render
+ *  thread.
+ */
+class MeshBuilder {
+public:
+    enum Format {
+        Full,       //!< Vertex, in ChunkMesh::model
+        Packed      //!< PackedVertex, in ChunkMesh::packed
+    };
+
+private:
+    struct Request {
+        ChunkSnapshot snapshot;
+        uint64_t version;
+        bool load;
+    };
+
+    ChunkMesher mPrototype;
+    ChunkMesher::Mode mMode;
+    Format mFormat;
+
+    std::vector<std::thread> mThreads;
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    std::condition_variable mIdle;
+
+    std::mutex mCacheMutex;
+    std::unique_ptr<ChunkCache> mCache;
+
+    std::deque<Request> mRequests;
+    unsigned int mBusy;
+    bool mQuit;
+
+    MPSCQueue<ChunkMesh> mFinished;
+    std::atomic<size_t> mFinishedCount;
+    size_t mPending;
+
+public:
+    /**
+     *  Starts the given number of worker threads; zero leaves one hardware
+     *  core to the calling thread and uses the rest (at least one).
+     */
+    explicit MeshBuilder(
+        unsigned int threads = 0,
+        const ChunkMesher &mesher = ChunkMesher(),
+        ChunkMesher::Mode mode = ChunkMesher::Culled,
+        Format format = Full
+    );
+    ~MeshBuilder();
+
+    MeshBuilder(const MeshBuilder &) = delete;
+    MeshBuilder &operator=(const MeshBuilder &) = delete;
+
+    unsigned int getThreadCount() const;
+
+    /**
+     *  Gives the workers a cache of the given capacity over source, for
+     *  chunks submitted by position.  source must outlive the builder.
+     */
+    void setSource(ChunkSource &source, size_t capacity = 4096);
+
+    /**
+     *  Queues a chunk for meshing.
+     */
+    void submit(const ChunkSnapshot &snapshot, uint64_t version = 0);
+
+    /**
+     *  Queues a chunk for meshing, to be loaded by a worker from the
+     *  builder's source.
+     */
+    void submit(const Position &chunk, uint64_t version = 0);
+
+    /**
+     *  Takes a finished mesh, if there is one.
+     */
+    bool poll(ChunkMesh &mesh);
+
+    /**
+     *  Gets the number of meshes submitted but not yet polled.
+     */
+    size_t getPendingCount() const;
+
+    /**
+     *  Gets the number of meshes finished but not yet polled.
+     */
+    size_t getFinishedCount() const;
+
+    /**
+     *  Drops the requests not yet started.
+     */
+    void cancel();
+
+    /**
+     *  Waits until every request has been meshed.
+     */
+    void wait();
+
+private:
+    void work();
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ *  Limits the GPU uploads done in one frame, by size and by time.
+ *
+ *  Call reset() at the start of each frame, and ask allows() before each
+ *  upload.  The first upload of a frame is always allowed, so that a single
+ *  large mesh cannot stall uploads forever.
+ */
+class UploadBudget {
+    size_t mMaxBytes;
+    sf::Time mMaxTime;
+
+    sf::Clock mClock;
+    size_t mBytes;
+    size_t mUploads;
+
+public:
+    UploadBudget(size_t maxBytes, sf::Time maxTime);
+
+    void reset();
+
+    bool allows(size_t bytes) const;
+    void spend(size_t bytes);
+
+    size_t getMaxBytes() const;
+    sf::Time getMaxTime() const;
+
+    size_t getBytes() const;
+    size_t getUploads() const;
+    sf::Time getElapsedTime() const;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // __MESHBUILDER_HPP__
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,501 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "mesher.hpp"
+
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+/**
+ *  Corners of each face (in BlockFace order, less None), counter-clockwise
+ *  seen from outside the block.
+ */
+struct FaceInfo {
+    glm::vec3 normal;
+    glm::vec3 corners[4];
+};
+
+const FaceInfo Faces[6] = {
+    { glm::vec3(-1, 0, 0), { glm::vec3(0, 0, 0), glm::vec3(0, 0, 1), glm::vec3(0, 1, 1), glm::vec3(0, 1, 0) } },
+    { glm::vec3( 1, 0, 0), { glm::vec3(1, 0, 1), glm::vec3(1, 0, 0), glm::vec3(1, 1, 0), glm::vec3(1, 1, 1) } },
+    { glm::vec3( 0,-1, 0), { glm::vec3(0, 0, 0), glm::vec3(1, 0, 0), glm::vec3(1, 0, 1), glm::vec3(0, 0, 1) } },
+    { glm::vec3( 0, 1, 0), { glm::vec3(0, 1, 1), glm::vec3(1, 1, 1), glm::vec3(1, 1, 0), glm::vec3(0, 1, 0) } },
+    { glm::vec3( 0, 0,-1), { glm::vec3(1, 0, 0), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0), glm::vec3(1, 1, 0) } },
+    { glm::vec3( 0, 0, 1), { glm::vec3(0, 0, 1), glm::vec3(1, 0, 1), glm::vec3(1, 1, 1), glm::vec3(0, 1, 1) } },
+};
+
+const glm::vec2 FaceTexCoords[4] = {
+    glm::vec2(0, 1), glm::vec2(1, 1), glm::vec2(1, 0), glm::vec2(0, 0)
+};
+
+/**
+ *  Offsets in the padded block grid toward each face.
+ */
+const ptrdiff_t Row = ChunkData::Count + 2;
+const ptrdiff_t FaceOffsets[6] = {
+    -1, 1, -Row, Row, -Row * Row, Row * Row
+};
+
+const size_t Strides[3] = { 1, Row, Row * Row };
+
+const glm::vec4 DefaultTexRect(0, 0, 1, 1);
+
+/**
+ *  Looks up whether block types are transparent, remembering the last
+ *  type since chunks are mostly runs of one type.
+ */
+class TransparencyCache {
+    BlockType mType;
+    bool mTransparent;
+
+public:
+    TransparencyCache(): mType(0), mTransparent(true) {}
+
+    bool operator()(BlockType type) {
+        if (type != mType) {
+            mType = type;
+            mTransparent = Block::hasAttribute(type, Block::Attributes::Transparent);
+        }
+        return mTransparent;
+    }
+};
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+const unsigned int ChunkBorder::Count;
+
+ChunkBorder::ChunkBorder(): types(), light() {
+}
+
+ChunkBorder::ChunkBorder(const ChunkData &neighbour, BlockFace face) {
+    size_t i = 0;
+
+    for (unsigned int v = 0; v < Count; v++) {
+        for (unsigned int u = 0; u < Count; u++, i++) {
+            Position source;
+
+            // the layer of the neighbour touching the chunk
+            switch (face) {
+                case BlockFace::West:   source = Position(Count - 1, u, v); break;
+                case BlockFace::East:   source = Position(0, u, v); break;
+                case BlockFace::Bottom: source = Position(u, Count - 1, v); break;
+                case BlockFace::Top:    source = Position(u, 0, v); break;
+                case BlockFace::North:  source = Position(u, v, Count - 1); break;
+                case BlockFace::South:  source = Position(u, v, 0); break;
+                default:                source = Position(u, v, 0); break;
+            }
+
+            types[i] = neighbour.getType(source);
+            light[i] = neighbour.getLight(source);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+const unsigned int ChunkMesher::Count;
+const unsigned int ChunkMesher::Padded;
+
+ChunkMesher::ChunkMesher(
+): mTypes(), mTransparent(), mLight(), mTexRects(), mTiles(), mFaceCount(), mQuadCount() {
+    // the edges and corners of the padded grid belong to the diagonal
+    // neighbours, which are never loaded; leave them open
+    std::fill_n(mTransparent, Padded * Padded * Padded, true);
+}
+
+void ChunkMesher::setTexRect(BlockType type, const glm::vec4 &texRect) {
+    if (type >= mTexRects.size()) {
+        mTexRects.resize(type + 1, glm::vec4(0, 0, 1, 1));
+    }
+    mTexRects[type] = texRect;
+}
+
+void ChunkMesher::setTile(BlockType type, uint16_t tile) {
+    while (mTiles.size() <= type) {
+        mTiles.push_back(mTiles.size());
+    }
+    mTiles[type] = tile;
+}
+
+void ChunkMesher::load(const ChunkData &chunk, const ChunkData *const neighbours[6]) {
+    loadCenter(chunk);
+
+    for (int face = 0; face < 6; face++) {
+        loadBorder(neighbours ? neighbours[face] : nullptr, BlockFace(face + 1));
+    }
+}
+
+void ChunkMesher::load(const ChunkData &chunk, const ChunkBorder *const (&borders)[6]) {
+    loadCenter(chunk);
+
+    for (int face = 0; face < 6; face++) {
+        loadBorder(borders[face], BlockFace(face + 1));
+    }
+}
+
+void ChunkMesher::load(ChunkCache &cache, const Position &chunk) {
+    // getChunk may evict any chunk, so each is copied before the next lookup
+    loadCenter(*cache.getChunk(chunk)->getData());
+
+    for (int face = 0; face < 6; face++) {
+        BlockFace blockFace = BlockFace(face + 1);
+        loadBorder(cache.getChunk(getNeighbour(chunk, blockFace))->getData(), blockFace);
+    }
+}
+
+void ChunkMesher::build(Model &model, Mode mode) {
+    buildModel(model, mode);
+}
+
+void ChunkMesher::build(PackedModel &model, Mode mode) {
+    buildModel(model, mode);
+}
+
+ChunkConnectivity ChunkMesher::getConnectivity() const {
+    static const size_t Size = Padded * Padded * Padded;
+
+    ChunkConnectivity connectivity;
+    bool seen[Size] = {};
+    uint16_t stack[Size];
+
+    for (unsigned int z = 0; z < Count; z++) {
+        for (unsigned int y = 0; y < Count; y++) {
+            size_t first = getIndex(1, y + 1, z + 1);
+
+            for (unsigned int x = 0; x < Count; x++, first++) {
+                if (seen[first] || !mTransparent[first]) {
+                    continue;
+                }
+
+                // the faces of the chunk this pocket of transparent blocks reaches
+                uint8_t faces = 0;
+                size_t top = 0;
+                stack[top++] = uint16_t(first);
+                seen[first] = true;
+
+                while (top > 0) {
+                    size_t i = stack[--top];
+                    size_t position[3] = { i % Padded, i / Padded % Padded, i / (Padded * Padded) };
+
+                    for (int face = 0; face < 6; face++) {
+                        size_t next = position[face / 2] + (face % 2 ? 1 : -1);
+                        if (next == 0 || next == Padded - 1) {
+                            faces |= 1 << face;
+                            continue;
+                        }
+
+                        size_t n = i + FaceOffsets[face];
+                        if (!seen[n] && mTransparent[n]) {
+                            seen[n] = true;
+                            stack[top++] = uint16_t(n);
+                        }
+                    }
+                }
+
+                connectivity.connectAll(faces);
+                if (connectivity.isOpen()) {
+                    return connectivity;
+                }
+            }
+        }
+    }
+
+    return connectivity;
+}
+
+size_t ChunkMesher::getFaceCount() const {
+    return mFaceCount;
+}
+
+size_t ChunkMesher::getQuadCount() const {
+    return mQuadCount;
+}
+
+Position ChunkMesher::getNeighbour(const Position &chunk, BlockFace face) {
+    switch (face) {
+        case BlockFace::West:   return Position(chunk.x - 1, chunk.y, chunk.z);
+        case BlockFace::East:   return Position(chunk.x + 1, chunk.y, chunk.z);
+        case BlockFace::Bottom: return Position(chunk.x, chunk.y - 1, chunk.z);
+        case BlockFace::Top:    return Position(chunk.x, chunk.y + 1, chunk.z);
+        case BlockFace::North:  return Position(chunk.x, chunk.y, chunk.z - 1);
+        case BlockFace::South:  return Position(chunk.x, chunk.y, chunk.z + 1);
+        default:                return chunk;
+    }
+}
+
+void ChunkMesher::loadCenter(const ChunkData &chunk) {
+    TransparencyCache transparent;
+
+    for (unsigned int z = 0; z < Count; z++) {
+        for (unsigned int y = 0; y < Count; y++) {
+            size_t i = getIndex(1, y + 1, z + 1);
+
+            for (unsigned int x = 0; x < Count; x++, i++) {
+                Position position(x, y, z);
+                BlockType type = chunk.getType(position);
+                mTypes[i] = type;
+                mTransparent[i] = transparent(type);
+                mLight[i] = chunk.getLight(position);
+            }
+        }
+    }
+}
+
+void ChunkMesher::loadBorder(const ChunkData *neighbour, BlockFace face) {
+    if (neighbour) {
+        ChunkBorder border(*neighbour, face);
+        loadBorder(&border, face);
+    } else {
+        loadBorder(static_cast<const ChunkBorder *>(nullptr), face);
+    }
+}
+
+void ChunkMesher::loadBorder(const ChunkBorder *border, BlockFace face) {
+    TransparencyCache transparent;
+    size_t source = 0;
+
+    for (unsigned int v = 0; v < Count; v++) {
+        for (unsigned int u = 0; u < Count; u++, source++) {
+            size_t i;
+
+            switch (face) {
+                case BlockFace::West:   i = getIndex(0, u + 1, v + 1); break;
+                case BlockFace::East:   i = getIndex(Count + 1, u + 1, v + 1); break;
+                case BlockFace::Bottom: i = getIndex(u + 1, 0, v + 1); break;
+                case BlockFace::Top:    i = getIndex(u + 1, Count + 1, v + 1); break;
+                case BlockFace::North:  i = getIndex(u + 1, v + 1, 0); break;
+                case BlockFace::South:  i = getIndex(u + 1, v + 1, Count + 1); break;
+                default: return;
+            }
+
+            if (border) {
+                BlockType type = border->types[source];
+                mTypes[i] = type;
+                mTransparent[i] = transparent(type);
+                mLight[i] = border->light[source];
+            } else {
+                mTypes[i] = 0;
+                mTransparent[i] = false;
+                mLight[i] = 0;
+            }
+        }
+    }
+}
+
+template <typename M>
+void ChunkMesher::buildModel(M &model, Mode mode) {
+    model.clearVertices();
+    model.clearIndices();
+    model.setPrimitive(GLTriangles);
+
+    mFaceCount = 0;
+    mQuadCount = 0;
+
+    if (mode == Greedy) {
+        buildGreedy(model);
+    } else {
+        buildCulled(model);
+    }
+}
+
+template <typename M>
+void ChunkMesher::buildCulled(M &model) {
+    for (unsigned int z = 0; z < Count; z++) {
+        for (unsigned int y = 0; y < Count; y++) {
+            size_t i = getIndex(1, y + 1, z + 1);
+
+            for (unsigned int x = 0; x < Count; x++, i++) {
+                BlockType type = mTypes[i];
+                if (type == 0) {
+                    continue;
+                }
+
+                for (int face = 0; face < 6; face++) {
+                    size_t n = i + FaceOffsets[face];
+                    if (mTransparent[n] && mTypes[n] != type) {
+                        addQuad(model, face, glm::vec3(x, y, z), 1, 1, type, getShade(model, i, face));
+                    }
+                }
+            }
+        }
+    }
+
+    mFaceCount = mQuadCount;
+}
+
+template <typename M>
+void ChunkMesher::buildGreedy(M &model) {
+    // block type in the low 16 bits, shade above; zero where no face shows
+    uint64_t mask[Count * Count];
+
+    for (int face = 0; face < 6; face++) {
+        // sweep slices across the face's axis d; u and v lie in the slice
+        int d = face / 2, u = (d + 1) % 3, v = (d + 2) % 3;
+        ptrdiff_t offset = FaceOffsets[face];
+
+        for (unsigned int slice = 0; slice < Count; slice++) {
+            size_t start = getIndex(1, 1, 1) + slice * Strides[d];
+            size_t visible = 0;
+
+            // the visible faces in this slice
+            for (unsigned int b = 0; b < Count; b++) {
+                size_t i = start + b * Strides[v];
+
+                for (unsigned int a = 0; a < Count; a++, i += Strides[u]) {
+                    BlockType type = mTypes[i];
+                    bool shown = type != 0 && mTransparent[i + offset] && mTypes[i + offset] != type;
+
+                    mask[b * Count + a] = shown ? type | uint64_t(getShade(model, i, face)) << 16 : 0;
+                    visible += shown;
+                }
+            }
+
+            if (visible == 0) {
+                continue;
+            }
+
+            mFaceCount += visible;
+
+            for (unsigned int b = 0; b < Count; b++) {
+                for (unsigned int a = 0; a < Count; ) {
+                    uint64_t key = mask[b * Count + a];
+                    if (key == 0) {
+                        a++;
+                        continue;
+                    }
+
+                    // widen along u, then grow along v while whole rows match
+                    unsigned int w = 1;
+                    while (a + w < Count && mask[b * Count + a + w] == key) {
+                        w++;
+                    }
+
+                    unsigned int h = 1;
+                    for (; b + h < Count; h++) {
+                        const uint64_t *row = &mask[(b + h) * Count + a];
+                        if (std::find_if(row, row + w, [key](uint64_t k) { return k != key; }) != row + w) {
+                            break;
+                        }
+                    }
+
+                    for (unsigned int j = 0; j < h; j++) {
+                        std::fill_n(&mask[(b + j) * Count + a], w, 0);
+                    }
+
+                    glm::vec3 origin;
+                    origin[d] = slice;
+                    origin[u] = a;
+                    origin[v] = b;
+
+                    // addQuad takes w along u and h along v
+                    addQuad(model, face, origin, w, h, BlockType(key), uint32_t(key >> 16));
+                    a += w;
+                }
+            }
+        }
+    }
+}
+
+uint32_t ChunkMesher::getShade(const Model &, size_t, int) const {
+    return 0;
+}
+
+uint32_t ChunkMesher::getShade(const PackedModel &, size_t i, int face) const {
+    const FaceInfo &info = Faces[face];
+    size_t front = i + FaceOffsets[face];
+
+    int d = face / 2, u = (d + 1) % 3, v = (d + 2) % 3;
+    uint32_t shade = uint32_t(mLight[front]) << 8;
+
+    // each corner is darkened by the solid blocks around it in front of the face
+    for (int corner = 0; corner < 4; corner++) {
+        ptrdiff_t du = info.corners[corner][u] > 0 ? ptrdiff_t(Strides[u]) : -ptrdiff_t(Strides[u]);
+        ptrdiff_t dv = info.corners[corner][v] > 0 ? ptrdiff_t(Strides[v]) : -ptrdiff_t(Strides[v]);
+
+        bool side1 = !mTransparent[front + du];
+        bool side2 = !mTransparent[front + dv];
+        bool edge = !mTransparent[front + du + dv];
+
+        uint32_t occlusion = side1 && side2 ? 0 : 3 - (side1 + side2 + edge);
+        shade |= occlusion << (corner * 2);
+    }
+
+    return shade;
+}
+
+void ChunkMesher::addQuad(Model &model, int face, const glm::vec3 &origin, int w, int h, BlockType type, uint32_t) {
+    const FaceInfo &info = Faces[face];
+    const glm::vec4 &texRect = type < mTexRects.size() ? mTexRects[type] : DefaultTexRect;
+    std::vector<Vertex> &vertices = model.getVertices();
+    size_t base = vertices.size();
+
+    int d = face / 2, u = (d + 1) % 3, v = (d + 2) % 3;
+
+    glm::vec3 size;
+    size[d] = 1;
+    size[u] = w;
+    size[v] = h;
+
+    // texture s runs along the axis on which the first two corners differ
+    const glm::vec3 &c0 = info.corners[0];
+    const glm::vec3 &c1 = info.corners[1];
+    int s = c0[u] != c1[u] ? u : v;
+    glm::vec2 repeat(size[s], size[s == u ? v : u]);
+
+    for (int corner = 0; corner < 4; corner++) {
+        glm::vec2 texCoord(
+            texRect.x + FaceTexCoords[corner].x * repeat.x * texRect.z,
+            texRect.y + FaceTexCoords[corner].y * repeat.y * texRect.w
+        );
+        glm::vec3 position = origin + info.corners[corner] * size;
+        vertices.push_back(Vertex(texCoord, info.normal, position));
+    }
+
+    model.addQuad(base, base + 1, base + 2, base + 3);
+
+    mQuadCount += 1;
+}
+
+void ChunkMesher::addQuad(PackedModel &model, int face, const glm::vec3 &origin, int w, int h, BlockType type, uint32_t shade) {
+    const FaceInfo &info = Faces[face];
+    uint16_t tile = type < mTiles.size() ? mTiles[type] : type;
+    uint8_t light = uint8_t(shade >> 8);
+    std::vector<PackedVertex> &vertices = model.getVertices();
+    size_t base = vertices.size();
+
+    int d = face / 2, u = (d + 1) % 3, v = (d + 2) % 3;
+
+    glm::vec3 size;
+    size[d] = 1;
+    size[u] = w;
+    size[v] = h;
+
+    int occlusion[4];
+    for (int corner = 0; corner < 4; corner++) {
+        glm::vec3 position = origin + info.corners[corner] * size;
+        occlusion[corner] = (shade >> (corner * 2)) & 3;
+        vertices.push_back(PackedVertex(
+            uint8_t(position.x), uint8_t(position.y), uint8_t(position.z),
+            face, occlusion[corner], tile, light
+        ));
+    }
+
+    // split along the brighter diagonal, so occlusion shades evenly
+    if (occlusion[0] + occlusion[2] < occlusion[1] + occlusion[3]) {
+        model.addQuad(base + 1, base + 2, base + 3, base);
+    } else {
+        model.addQuad(base, base + 1, base + 2, base + 3);
+    }
+
+    mQuadCount += 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,199 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __MESHER_HPP__
+#define __MESHER_HPP__ 1
+
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "model.hpp"
+#include "raycast.hpp"
+#include "types.hpp"
+#include "visibility.hpp"
+#include "world.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ *  The layer of a chunk's blocks that borders the chunk across a face from
+ *  it, which is all that meshing reads of a neighbour: for face East, the
+ *  neighbour's x = 0 layer.  Blocks are indexed u + v * Count, u and v
+ *  being the two axes across the face in x, y, z order.
+ */
+struct ChunkBorder {
+    static const unsigned int Count = ChunkData::Count;
+
+    BlockType types[Count * Count];
+    LightData light[Count * Count];
+
+    ChunkBorder();
+
+    /**
+     *  Copies the layer of neighbour that borders a chunk across face.
+     */
+    ChunkBorder(const ChunkData &neighbour, BlockFace face);
+};
+
+/**
+ *  Turns the blocks of a chunk into a model of their visible faces.
+ *
+ *  A face is emitted where a block (other than air) borders a transparent
+ *  block of another type, so faces between solid blocks, and between
+ *  blocks of one transparent type (such as water), are culled.  Faces at
+ *  the chunk border are culled against the neighbouring chunks; a missing
+ *  neighbour counts as opaque, so the chunk should be meshed again once its
+ *  neighbours are loaded.
+ *
+ *  Vertices are in block units relative to the chunk's lowest corner, with
+ *  counter-clockwise triangles seen from outside.
+ *
+ *  In Culled mode each visible face is a quad textured with the whole
+ *  texture rectangle of its block type.  In Greedy mode coplanar visible
+ *  faces of one type are merged into as few rectangles as a greedy sweep
+ *  finds; a rectangle of w by h faces has texture coordinates running over
+ *  w by h texture rectangles, so the texture repeats once per block (with
+ *  GL_REPEAT for a rectangle of (0, 0, 1, 1), or by wrapping in the shader
+ *  within an atlas).  Greedy meshes have far fewer vertices for flat
+ *  terrain, but cost more to build and give up per-face lighting.
+ *
+ *  Meshes may also be built of PackedVertex, with an atlas tile per block
+ *  type, per-corner ambient occlusion and the light in front of each face.
+ *  Greedy packed meshes merge only faces that are shaded alike.  Only the
+ *  six face neighbours are loaded, so blocks diagonally across a chunk edge
+ *  or corner (in the other 20 neighbours) count as transparent: occlusion
+ *  along a chunk's edges ignores them, and can show a seam there.
+ */
+class ChunkMesher {
+public:
+    static const unsigned int Count = ChunkData::Count;
+
+    enum Mode {
+        Culled,
+        Greedy
+    };
+
+private:
+    // the chunk's blocks with a one block border from its neighbours
+    static const unsigned int Padded = Count + 2;
+
+    BlockType mTypes[Padded * Padded * Padded];
+    bool mTransparent[Padded * Padded * Padded];
+    LightData mLight[Padded * Padded * Padded];
+
+    std::vector<glm::vec4> mTexRects;
+    std::vector<uint16_t> mTiles;
+    size_t mFaceCount;
+    size_t mQuadCount;
+
+public:
+    ChunkMesher();
+
+    /**
+     *  Sets the texture rectangle (x, y, width, height) for faces of a
+     *  block type; the default is (0, 0, 1, 1).
+     */
+    void setTexRect(BlockType type, const glm::vec4 &texRect);
+
+    /**
+     *  Sets the atlas tile for packed faces of a block type; the default is
+     *  the block type itself.
+     */
+    void setTile(BlockType type, uint16_t tile);
+
+    /**
+     *  Loads the blocks of a chunk, with the neighbouring chunks given in
+     *  BlockFace order (West, East, Bottom, Top, North, South); any of them
+     *  may be null.
+     */
+    void load(const ChunkData &chunk, const ChunkData *const neighbours[6]);
+
+    /**
+     *  Loads the blocks of a chunk, with only the borders of its neighbours
+     *  in BlockFace order; any of them may be null.
+     */
+    void load(const ChunkData &chunk, const ChunkBorder *const (&borders)[6]);
+
+    /**
+     *  Loads a chunk and its neighbours from a cache.
+     */
+    void load(ChunkCache &cache, const Position &chunk);
+
+    /**
+     *  Replaces the contents of model with the faces of the loaded chunk.
+     */
+    void build(Model &model, Mode mode = Culled);
+
+    /**
+     *  Replaces the contents of model with the faces of the loaded chunk, in
+     *  packed vertices.
+     */
+    void build(PackedModel &model, Mode mode = Culled);
+
+    /**
+     *  Finds which faces of the loaded chunk can see each other, by flood
+     *  filling its transparent blocks.
+     */
+    ChunkConnectivity getConnectivity() const;
+
+    /**
+     *  Gets the number of visible block faces found by the last build.
+     */
+    size_t getFaceCount() const;
+
+    /**
+     *  Gets the number of quads emitted by the last build; the same as the
+     *  face count unless faces were merged.
+     */
+    size_t getQuadCount() const;
+
+    /**
+     *  Gets the neighbour of a chunk across a face.
+     */
+    static Position getNeighbour(const Position &chunk, BlockFace face);
+
+private:
+    static size_t getIndex(int x, int y, int z) {
+        return (size_t(z) * Padded + size_t(y)) * Padded + size_t(x);
+    }
+
+    void loadCenter(const ChunkData &chunk);
+    void loadBorder(const ChunkData *neighbour, BlockFace face);
+    void loadBorder(const ChunkBorder *border, BlockFace face);
+
+    template <typename M>
+    void buildModel(M &model, Mode mode);
+
+    template <typename M>
+    void buildCulled(M &model);
+
+    template <typename M>
+    void buildGreedy(M &model);
+
+    /**
+     *  Gets the shading of a face of the block at padded index i, for faces
+     *  to be merged only when alike: the ambient occlusion of each corner in
+     *  two bits, then the light in front in the next eight.  Full vertices
+     *  are not shaded, so this is zero for them.
+     */
+    uint32_t getShade(const Model &model, size_t i, int face) const;
+    uint32_t getShade(const PackedModel &model, size_t i, int face) const;
+
+    /**
+     *  Adds a quad of size (w, h) faces, its lowest corner at block origin.
+     */
+    void addQuad(Model &model, int face, const glm::vec3 &origin, int w, int h, BlockType type, uint32_t shade);
+    void addQuad(PackedModel &model, int face, const glm::vec3 &origin, int w, int h, BlockType type, uint32_t shade);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // __MESHER_HPP__
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -6,28 +6,112 @@
 
 #include <SFML/System/VecOps.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
 ////////////////////////////////////////////////////////////////////////////////
 
-enum GLPrimitive {
-    GLPoints,
-    GLLines,
-    GLLineLoop,
-    GLLineStrip,
-    GLTriangles,
-    GLTriangleStrip,
-    GLTriangleFan,
-    GLQuads,
-    GLQuadStrip,
-    GLPolygon,
+namespace {
+
+const size_t MaxShortVertices = size_t(1) << 16;
+
+uint32_t getDrawnIndexType(uint32_t type, size_t vertices) {
+    return type == GLUnsignedInt || vertices > MaxShortVertices ? GLUnsignedInt : GLUnsignedShort;
+}
+
+size_t getIndexSize(uint32_t type) {
+    return type == GLUnsignedInt ? sizeof(uint32_t) : sizeof(uint16_t);
+}
+
+void writeIndices(const std::vector<uint32_t> &indices, uint32_t type, void *data) {
+    if (type == GLUnsignedInt) {
+        std::memcpy(data, indices.data(), indices.size() * sizeof(uint32_t));
+    } else {
+        std::copy(indices.begin(), indices.end(), static_cast<uint16_t *>(data));
+    }
+}
+
+/**
+ *  A vertex's components as integers: their bits (with -0 as 0), or their
+ *  multiple of the weld distance.
+ */
+struct WeldKey {
+    int32_t values[8];
+
+    WeldKey(const Vertex &vertex, float epsilon) {
+        const float components[8] = {
+            vertex.texCoord.x, vertex.texCoord.y,
+            vertex.normal.x, vertex.normal.y, vertex.normal.z,
+            vertex.position.x, vertex.position.y, vertex.position.z
+        };
+
+        for (int i = 0; i < 8; i++) {
+            if (epsilon > 0) {
+                values[i] = int32_t(std::floor(components[i] / epsilon + 0.5f));
+            } else {
+                float value = components[i] + 0.0f;
+                std::memcpy(&values[i], &value, sizeof(value));
+            }
+        }
+    }
+
+    bool operator==(const WeldKey &other) const {
+        return std::equal(values, values + 8, other.values);
+    }
 };
 
+struct WeldHash {
+    size_t operator()(const WeldKey &key) const {
+        uint64_t hash = 14695981039346656037ull;
+        for (int32_t value : key.values) {
+            hash = (hash ^ uint32_t(value)) * 1099511628211ull;
+        }
+        return size_t(hash);
+    }
+};
+
+/**
+ *  Forsyth's vertex score: high for vertices just used (but not by the
+ *  last triangle, whose vertices are all hits anyway), and for vertices
+ *  with few triangles left, so that they are finished off.
+ */
+float getVertexScore(int position, uint32_t remaining, size_t cacheSize) {
+    static const float CacheDecayPower = 1.5f;
+    static const float LastTriangleScore = 0.75f;
+    static const float ValenceBoostScale = 2.0f;
+    static const float ValenceBoostPower = 0.5f;
+
+    if (remaining == 0) {
+        return -1;
+    }
+
+    float score = 0;
+    if (position >= 0) {
+        if (position < 3) {
+            score = LastTriangleScore;
+        } else {
+            float scale = 1.0f / (cacheSize - 3);
+            score = std::pow(1.0f - (position - 3) * scale, CacheDecayPower);
+        }
+    }
+
+    return score + ValenceBoostScale * std::pow(float(remaining), -ValenceBoostPower);
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 Model::Model(
-): mPrimitive(GLPoints) {
+): mPrimitive(GLPoints), mIndexType(GLUnsignedShort) {
 }
 
 Model::Model(
     uint32_t primitive
-): mPrimitive(primitive) {
+): mPrimitive(primitive), mIndexType(GLUnsignedShort) {
 }
 
 uint32_t Model::getPrimitive() const {
@@ -73,11 +157,11 @@ void Model::addVertices(const Vertex *verts, size_t count) {
     mVertices.insert(mVertices.end(), verts, verts + count);
 }
 
-const std::vector<uint16_t> &Model::getIndices() const {
+const std::vector<uint32_t> &Model::getIndices() const {
     return mIndices;
 }
 
-std::vector<uint16_t> &Model::getIndices() {
+std::vector<uint32_t> &Model::getIndices() {
     return mIndices;
 }
 
@@ -89,25 +173,41 @@ void Model::reserveIndices(size_t count) {
     mIndices.reserve(mIndices.size() + count);
 }
 
-void Model::addIndex(uint16_t vertex) {
+void Model::addIndex(uint32_t vertex) {
     mIndices.push_back(vertex);
 }
 
-void Model::addTriangle(uint16_t a, uint16_t b, uint16_t c) {
+void Model::addTriangle(uint32_t a, uint32_t b, uint32_t c) {
     addIndex(a);
     addIndex(b);
     addIndex(c);
 }
 
-void Model::addQuad(uint16_t a, uint16_t b, uint16_t c, uint16_t d) {
+void Model::addQuad(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
     addTriangle(a, b, c);
     addTriangle(c, d, a);
 }
 
-void Model::addIndices(const uint16_t *verts, size_t count) {
+void Model::addIndices(const uint32_t *verts, size_t count) {
     mIndices.insert(mIndices.end(), verts, verts + count);
 }
 
+void Model::setIndexType(uint32_t type) {
+    mIndexType = type;
+}
+
+uint32_t Model::getIndexType() const {
+    return getDrawnIndexType(mIndexType, mVertices.size());
+}
+
+size_t Model::getIndexBytes() const {
+    return mIndices.size() * getIndexSize(getIndexType());
+}
+
+void Model::writeIndices(void *data) const {
+    ::writeIndices(mIndices, getIndexType(), data);
+}
+
 void Model::calcNormals(bool smooth) {
     calcNormals(0, mVertices.size(), smooth);
 }
@@ -350,6 +450,330 @@ void Model::makeBall(float radius, size_t step) {
     makeBall(radius, step, glm::vec3());
 }
 
+size_t Model::weldVertices(float epsilon) {
+    if (mIndices.empty()) {
+        mIndices.resize(mVertices.size());
+        for (size_t i = 0; i < mIndices.size(); i++) {
+            mIndices[i] = i;
+        }
+    }
+
+    std::unordered_map<WeldKey, uint32_t, WeldHash> welded;
+    std::vector<uint32_t> remap(mVertices.size());
+    std::vector<Vertex> vertices;
+    vertices.reserve(mVertices.size());
+
+    for (size_t i = 0; i < mVertices.size(); i++) {
+        auto inserted = welded.insert(std::make_pair(WeldKey(mVertices[i], epsilon), uint32_t(vertices.size())));
+        if (inserted.second) {
+            vertices.push_back(mVertices[i]);
+        }
+        remap[i] = inserted.first->second;
+    }
+
+    for (uint32_t &index : mIndices) {
+        index = remap[index];
+    }
+
+    if (mPrimitive == GLTriangles) {
+        size_t kept = 0;
+        for (size_t i = 0; i + 2 < mIndices.size(); i += 3) {
+            uint32_t a = mIndices[i], b = mIndices[i + 1], c = mIndices[i + 2];
+            if (a != b && b != c && c != a) {
+                mIndices[kept++] = a;
+                mIndices[kept++] = b;
+                mIndices[kept++] = c;
+            }
+        }
+        mIndices.resize(kept);
+    }
+
+    size_t removed = mVertices.size() - vertices.size();
+    mVertices.swap(vertices);
+    return removed;
+}
+
+void Model::optimizeVertexCache(size_t cacheSize) {
+    if (mPrimitive != GLTriangles || mIndices.size() < 6 || cacheSize < 4) {
+        return;
+    }
+
+    static const size_t None = std::numeric_limits<size_t>::max();
+
+    size_t triangleCount = mIndices.size() / 3;
+    size_t vertexCount = mVertices.size();
+
+    // the triangles of each vertex; the first remaining[v] are not yet drawn
+    std::vector<uint32_t> remaining(vertexCount);
+    for (size_t i = 0; i < triangleCount * 3; i++) {
+        remaining[mIndices[i]] += 1;
+    }
+
+    std::vector<uint32_t> offsets(vertexCount + 1);
+    for (size_t v = 0; v < vertexCount; v++) {
+        offsets[v + 1] = offsets[v] + remaining[v];
+    }
+
+    std::vector<uint32_t> triangles(triangleCount * 3);
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++) {
+        for (size_t j = 0; j < 3; j++) {
+            triangles[fill[mIndices[t * 3 + j]]++] = t;
+        }
+    }
+
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) {
+        vertexScores[v] = getVertexScore(-1, remaining[v], cacheSize);
+    }
+
+    std::vector<float> triangleScores(triangleCount);
+    std::vector<bool> drawn(triangleCount);
+    size_t best = 0;
+
+    for (size_t t = 0; t < triangleCount; t++) {
+        const uint32_t *tri = &mIndices[t * 3];
+        triangleScores[t] = vertexScores[tri[0]] + vertexScores[tri[1]] + vertexScores[tri[2]];
+        if (triangleScores[t] > triangleScores[best]) {
+            best = t;
+        }
+    }
+
+    std::vector<uint32_t> cache, nextCache;
+    cache.reserve(cacheSize + 3);
+    nextCache.reserve(cacheSize + 3);
+
+    std::vector<uint32_t> indices;
+    indices.reserve(triangleCount * 3);
+    size_t scan = 0;
+
+    for (size_t count = 0; count < triangleCount; count++) {
+        if (best == None) {
+            // nothing in the cache has triangles left; start somewhere new
+            while (drawn[scan]) {
+                scan++;
+            }
+            best = scan;
+        }
+
+        const uint32_t *tri = &mIndices[best * 3];
+        drawn[best] = true;
+        nextCache.assign(tri, tri + 3);
+
+        for (size_t j = 0; j < 3; j++) {
+            uint32_t v = tri[j];
+            indices.push_back(v);
+
+            // move the drawn triangle past the vertex's remaining ones
+            uint32_t *list = &triangles[offsets[v]];
+            std::swap(*std::find(list, list + remaining[v], best), list[remaining[v] - 1]);
+            remaining[v] -= 1;
+        }
+
+        for (uint32_t v : cache) {
+            if (v != tri[0] && v != tri[1] && v != tri[2]) {
+                nextCache.push_back(v);
+            }
+        }
+
+        // vertices pushed out of the cache lose their cache score
+        for (size_t i = cacheSize; i < nextCache.size(); i++) {
+            uint32_t v = nextCache[i];
+            vertexScores[v] = getVertexScore(-1, remaining[v], cacheSize);
+        }
+
+        if (nextCache.size() > cacheSize) {
+            nextCache.resize(cacheSize);
+        }
+
+        for (size_t i = 0; i < nextCache.size(); i++) {
+            uint32_t v = nextCache[i];
+            vertexScores[v] = getVertexScore(i, remaining[v], cacheSize);
+        }
+
+        cache.swap(nextCache);
+
+        // rescore the triangles of the cached vertices, and draw the best next
+        best = None;
+        float bestScore = -1;
+
+        for (uint32_t v : cache) {
+            for (size_t k = 0; k < remaining[v]; k++) {
+                uint32_t t = triangles[offsets[v] + k];
+                const uint32_t *other = &mIndices[t * 3];
+                float score = vertexScores[other[0]] + vertexScores[other[1]] + vertexScores[other[2]];
+                triangleScores[t] = score;
+
+                if (score > bestScore) {
+                    bestScore = score;
+                    best = t;
+                }
+            }
+        }
+    }
+
+    // any trailing indices past the last whole triangle are kept
+    indices.insert(indices.end(), mIndices.begin() + triangleCount * 3, mIndices.end());
+    mIndices.swap(indices);
+}
+
+void Model::optimizeVertexFetch() {
+    if (mIndices.empty()) {
+        return;
+    }
+
+    static const uint32_t Unused = std::numeric_limits<uint32_t>::max();
+
+    std::vector<uint32_t> remap(mVertices.size(), Unused);
+    std::vector<Vertex> vertices;
+    vertices.reserve(mVertices.size());
+
+    for (uint32_t &index : mIndices) {
+        if (remap[index] == Unused) {
+            remap[index] = vertices.size();
+            vertices.push_back(mVertices[index]);
+        }
+        index = remap[index];
+    }
+
+    mVertices.swap(vertices);
+}
+
+void Model::optimize(size_t cacheSize) {
+    weldVertices();
+    optimizeVertexCache(cacheSize);
+    optimizeVertexFetch();
+}
+
+MeshStats Model::getStats(size_t cacheSize) const {
+    MeshStats stats = { mVertices.size(), 0, 0, 0 };
+
+    size_t count = mIndices.empty() ? mVertices.size() : mIndices.size();
+    stats.triangles = mPrimitive == GLTriangles ? count / 3 : 0;
+
+    if (stats.triangles == 0 || stats.vertices == 0) {
+        return stats;
+    }
+
+    // a vertex is cached if fewer than cacheSize misses came after its own
+    static const size_t Never = std::numeric_limits<size_t>::max();
+    std::vector<size_t> missedAt(mVertices.size(), Never);
+    size_t misses = 0;
+
+    for (size_t i = 0; i < stats.triangles * 3; i++) {
+        uint32_t v = mIndices.empty() ? i : mIndices[i];
+        if (missedAt[v] == Never || misses - missedAt[v] >= cacheSize) {
+            missedAt[v] = misses;
+            misses += 1;
+        }
+    }
+
+    stats.acmr = float(misses) / stats.triangles;
+    stats.atvr = float(misses) / stats.vertices;
+    return stats;
+}
+
+BoundingSphere Model::getBoundingSphere() const {
+    BoundingSphere sphere = { glm::vec3(0, 0, 0), 0 };
+    if (mVertices.empty()) {
+        return sphere;
+    }
+
+    glm::vec3 low = mVertices[0].position;
+    glm::vec3 high = low;
+    for (const Vertex &vertex : mVertices) {
+        low = glm::min(low, vertex.position);
+        high = glm::max(high, vertex.position);
+    }
+
+    sphere.center = (low + high) * 0.5f;
+    for (const Vertex &vertex : mVertices) {
+        sphere.radius = std::max(sphere.radius, glm::distance(sphere.center, vertex.position));
+    }
+
+    return sphere;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+const size_t Model::CacheSize;
+
+const uint8_t PackedVertex::FaceMask;
+const uint8_t PackedVertex::OcclusionShift;
+const uint8_t PackedVertex::OcclusionMask;
+
+PackedModel::PackedModel(
+): mPrimitive(GLTriangles), mVertices(), mIndices(), mIndexType(GLUnsignedShort) {
+}
+
+PackedModel::PackedModel(
+    uint32_t primitive
+): mPrimitive(primitive), mVertices(), mIndices(), mIndexType(GLUnsignedShort) {
+}
+
+uint32_t PackedModel::getPrimitive() const {
+    return mPrimitive;
+}
+
+void PackedModel::setPrimitive(uint32_t primitive) {
+    mPrimitive = primitive;
+}
+
+const std::vector<PackedVertex> &PackedModel::getVertices() const {
+    return mVertices;
+}
+
+std::vector<PackedVertex> &PackedModel::getVertices() {
+    return mVertices;
+}
+
+void PackedModel::clearVertices() {
+    mVertices.clear();
+}
+
+void PackedModel::addVertex(const PackedVertex &vertex) {
+    mVertices.push_back(vertex);
+}
+
+const std::vector<uint32_t> &PackedModel::getIndices() const {
+    return mIndices;
+}
+
+std::vector<uint32_t> &PackedModel::getIndices() {
+    return mIndices;
+}
+
+void PackedModel::clearIndices() {
+    mIndices.clear();
+}
+
+void PackedModel::addTriangle(uint32_t a, uint32_t b, uint32_t c) {
+    mIndices.push_back(a);
+    mIndices.push_back(b);
+    mIndices.push_back(c);
+}
+
+void PackedModel::addQuad(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+    addTriangle(a, b, c);
+    addTriangle(c, d, a);
+}
+
+void PackedModel::setIndexType(uint32_t type) {
+    mIndexType = type;
+}
+
+uint32_t PackedModel::getIndexType() const {
+    return getDrawnIndexType(mIndexType, mVertices.size());
+}
+
+size_t PackedModel::getIndexBytes() const {
+    return mIndices.size() * getIndexSize(getIndexType());
+}
+
+void PackedModel::writeIndices(void *data) const {
+    ::writeIndices(mIndices, getIndexType(), data);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //  EOF
 ////////////////////////////////////////////////////////////////////////////////
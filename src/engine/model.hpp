@@ -7,6 +7,7 @@
 
 ////////////////////////////////////////////////////////////////////////////////
 
+#include <cstddef>
 #include <vector>
 #include <glm/glm.hpp>
 
@@ -14,6 +15,32 @@
 
 ////////////////////////////////////////////////////////////////////////////////
 
+/**
+ *  Primitive types, numbered as the matching GL_* constants.
+ */
+enum GLPrimitive {
+    GLPoints,
+    GLLines,
+    GLLineLoop,
+    GLLineStrip,
+    GLTriangles,
+    GLTriangleStrip,
+    GLTriangleFan,
+    GLQuads,
+    GLQuadStrip,
+    GLPolygon,
+};
+
+/**
+ *  Index types, numbered as the matching GL_* constants.
+ */
+enum GLIndexType {
+    GLUnsignedShort = 0x1403,
+    GLUnsignedInt   = 0x1405,
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
 struct Vertex {
     glm::vec2 texCoord;
     glm::vec3 normal;
@@ -75,12 +102,43 @@ struct Vertex {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+/**
+ *  Vertex cache efficiency of a triangle mesh, measured with a simulated
+ *  FIFO post-transform cache: misses per triangle (ACMR, from 3 at worst
+ *  down toward 0.5 for large regular meshes) and per vertex (ATVR, 1 at
+ *  best).
+ */
+struct MeshStats {
+    size_t vertices;
+    size_t triangles;
+    float acmr;
+    float atvr;
+};
+
+/**
+ *  A sphere around every vertex of a model.
+ */
+struct BoundingSphere {
+    glm::vec3 center;
+    float radius;
+};
+
+/**
+ *  Vertices, drawn in order or through indices.
+ *
+ *  Indices are kept 32 bits wide, and drawn as 16-bit indices (half the
+ *  bytes to upload and fetch) whenever every vertex can be reached with
+ *  them; see getIndexType().
+ */
 class Model {
     uint32_t mPrimitive;
     std::vector<Vertex> mVertices;
-    std::vector<uint16_t> mIndices;
+    std::vector<uint32_t> mIndices;
+    uint32_t mIndexType;
 
 public:
+    static const size_t CacheSize = 32;
+
     Model();
     explicit Model(uint32_t primitive);
 
@@ -89,7 +147,7 @@ public:
         uint32_t primitive,
         const I &start,
         const I &end
-    ): mPrimitive(primitive) {
+    ): mPrimitive(primitive), mIndexType(GLUnsignedShort) {
         addVertices(start, end);
     }
 
@@ -97,7 +155,7 @@ public:
     Model(
         uint32_t primitive,
         const A &array
-    ): mPrimitive(primitive) {
+    ): mPrimitive(primitive), mIndexType(GLUnsignedShort) {
         addVertices(array);
     }
 
@@ -133,16 +191,16 @@ public:
         }
     }
 
-    const std::vector<uint16_t> &getIndices() const;
-    std::vector<uint16_t> &getIndices();
+    const std::vector<uint32_t> &getIndices() const;
+    std::vector<uint32_t> &getIndices();
 
     void clearIndices();
     void reserveIndices(size_t count);
-    void addIndex(uint16_t index);
-    void addTriangle(uint16_t a, uint16_t b, uint16_t c);
-    void addQuad(uint16_t a, uint16_t b, uint16_t c, uint16_t d);
+    void addIndex(uint32_t index);
+    void addTriangle(uint32_t a, uint32_t b, uint32_t c);
+    void addQuad(uint32_t a, uint32_t b, uint32_t c, uint32_t d);
 
-    void addIndices(const uint16_t *indices, size_t count);
+    void addIndices(const uint32_t *indices, size_t count);
 
     template <typename I>
     void addIndices(
@@ -156,11 +214,34 @@ public:
     void addIndices(
         const A &array
     ) {
-        for (uint16_t v : array) {
+        for (uint32_t v : array) {
             addIndex(v);
         }
     }
 
+    /**
+     *  Sets the narrowest index type to draw with: GLUnsignedShort (the
+     *  default) narrows indices whenever the vertices allow, GLUnsignedInt
+     *  keeps them wide, for meshes about to grow past 16 bits.
+     */
+    void setIndexType(uint32_t type);
+
+    /**
+     *  Gets the type the indices are drawn as: GLUnsignedInt if asked for,
+     *  or if there are too many vertices for 16-bit indices.
+     */
+    uint32_t getIndexType() const;
+
+    /**
+     *  Gets the size of the indices as drawn, in bytes.
+     */
+    size_t getIndexBytes() const;
+
+    /**
+     *  Copies the indices, as drawn, to data (of getIndexBytes() bytes).
+     */
+    void writeIndices(void *data) const;
+
     void calcNormals(bool smooth = false);
     void calcNormals(size_t start, size_t end, bool smooth = false);
 
@@ -189,6 +270,129 @@ public:
     void makeBall(float radius, size_t step, size_t rstep);
     void makeBall(float radius, size_t step, const glm::vec3 &center);
     void makeBall(float radius, size_t step);
+
+    /**
+     *  Merges identical vertices, or those within epsilon of each other
+     *  (found by rounding to a grid, so a few near ones may be missed), and
+     *  drops the triangles this leaves degenerate.  An unindexed model is
+     *  indexed.  Returns the number of vertices removed.
+     */
+    size_t weldVertices(float epsilon = 0);
+
+    /**
+     *  Reorders indexed triangles for post-transform cache hits, after Tom
+     *  Forsyth's "Linear-Speed Vertex Cache Optimisation".
+     */
+    void optimizeVertexCache(size_t cacheSize = CacheSize);
+
+    /**
+     *  Reorders vertices into the order the indices first use them, and
+     *  drops vertices that are never used.
+     */
+    void optimizeVertexFetch();
+
+    /**
+     *  Welds exact duplicates, then optimizes for the vertex cache and
+     *  for vertex fetch.
+     */
+    void optimize(size_t cacheSize = CacheSize);
+
+    /**
+     *  Measures cache efficiency for triangles, indexed or not.
+     */
+    MeshStats getStats(size_t cacheSize = CacheSize) const;
+
+    /**
+     *  Gets a sphere around the vertices, centred on their bounding box;
+     *  a point at the origin for a model without vertices.
+     */
+    BoundingSphere getBoundingSphere() const;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ *  Eight byte vertex for chunk meshes, a quarter the size of Vertex.
+ *
+ *  x, y and z are in blocks from the chunk's lowest corner (0 to 16).  The
+ *  face (BlockFace order, from 0 for West) is in bits 0-2 of flags, and the
+ *  ambient occlusion level (0 darkest to 3 open) in bits 3-4.  tile is the
+ *  block's tile in the texture atlas, and light is the light of the block
+ *  in front of the face.  Normals and texture coordinates are found in the
+ *  shader from the face and position, so a merged quad repeats its tile
+ *  once per block.
+ */
+struct PackedVertex {
+    static const uint8_t FaceMask = 0x07;
+    static const uint8_t OcclusionShift = 3;
+    static const uint8_t OcclusionMask = 0x03;
+
+    uint8_t x, y, z;
+    uint8_t flags;
+    uint16_t tile;
+    uint8_t light;
+    uint8_t reserved;
+
+    PackedVertex(
+    ): x(), y(), z(), flags(), tile(), light(), reserved() {
+    }
+
+    PackedVertex(
+        uint8_t x, uint8_t y, uint8_t z,
+        int face, int occlusion,
+        uint16_t tile,
+        uint8_t light
+    ): x(x), y(y), z(z),
+       flags(uint8_t((face & FaceMask) | ((occlusion & OcclusionMask) << OcclusionShift))),
+       tile(tile), light(light), reserved() {
+    }
+
+    int getFace() const {
+        return flags & FaceMask;
+    }
+
+    int getOcclusion() const {
+        return (flags >> OcclusionShift) & OcclusionMask;
+    }
+};
+
+static_assert(sizeof(PackedVertex) == 8, "PackedVertex must stay 8 bytes");
+
+/**
+ *  Indexed mesh of packed vertices, as built for chunks.  Indices are
+ *  narrowed as for Model.
+ */
+class PackedModel {
+    uint32_t mPrimitive;
+    std::vector<PackedVertex> mVertices;
+    std::vector<uint32_t> mIndices;
+    uint32_t mIndexType;
+
+public:
+    PackedModel();
+    explicit PackedModel(uint32_t primitive);
+
+    uint32_t getPrimitive() const;
+
+    void setPrimitive(uint32_t primitive);
+
+    const std::vector<PackedVertex> &getVertices() const;
+    std::vector<PackedVertex> &getVertices();
+
+    void clearVertices();
+    void addVertex(const PackedVertex &vertex);
+
+    const std::vector<uint32_t> &getIndices() const;
+    std::vector<uint32_t> &getIndices();
+
+    void clearIndices();
+    void addTriangle(uint32_t a, uint32_t b, uint32_t c);
+    void addQuad(uint32_t a, uint32_t b, uint32_t c, uint32_t d);
+
+    void setIndexType(uint32_t type);
+    uint32_t getIndexType() const;
+    size_t getIndexBytes() const;
+    void writeIndices(void *data) const;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -6,9 +6,245 @@
 
 ////////////////////////////////////////////////////////////////////////////////
 
-/// @todo
+/// @todo reliable channel
 
 ////////////////////////////////////////////////////////////////////////////////
-//  EOF
+
+PacketChannel getPacketChannel(PacketType type) {
+    switch (type) {
+        case PacketType::PlayerMove:
+        case PacketType::PlayerLook:
+        case PacketType::EntityMove:
+        case PacketType::EntityLook: {
+            return PacketChannel::Unreliable;
+        }
+
+        default: {
+            return PacketChannel::Reliable;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static uint8_t *put8(uint8_t *p, uint8_t v) {
+    *p++ = v;
+    return p;
+}
+
+static uint8_t *put16(uint8_t *p, uint16_t v) {
+    *p++ = v >> 8;
+    *p++ = v;
+    return p;
+}
+
+static uint8_t *put64(uint8_t *p, uint64_t v) {
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        *p++ = v >> shift;
+    }
+    return p;
+}
+
+static const uint8_t *get8(const uint8_t *p, uint8_t &v) {
+    v = *p++;
+    return p;
+}
+
+static const uint8_t *get16(const uint8_t *p, uint16_t &v) {
+    v = (uint16_t(p[0]) << 8) | p[1];
+    return p + 2;
+}
+
+static const uint8_t *get64(const uint8_t *p, uint64_t &v) {
+    v = 0;
+    for (int i = 0; i < 8; i++) {
+        v = (v << 8) | *p++;
+    }
+    return p;
+}
+
+static bool isEntityPacket(PacketType type) {
+    return type == PacketType::EntityMove || type == PacketType::EntityLook;
+}
+
+static bool isMovePacket(PacketType type) {
+    return type == PacketType::PlayerMove || type == PacketType::EntityMove;
+}
+
+static size_t getMovementUpdateSize(PacketType type) {
+    if (getPacketChannel(type) != PacketChannel::Unreliable) {
+        return 0;
+    }
+    return 2 + 1 + (isEntityPacket(type) ? 8 : 0) + (isMovePacket(type) ? 6 : 2);
+}
+
+size_t encodeMovementUpdate(const MovementUpdate &update, uint8_t *buffer) {
+    size_t size = getMovementUpdateSize(update.type);
+
+    if (size == 0) {
+        return 0;
+    }
+
+    uint8_t *p = buffer;
+    p = put16(p, update.sequence);
+    p = put8(p, static_cast<uint8_t>(update.type));
+
+    if (isEntityPacket(update.type)) {
+        p = put64(p, update.id);
+    }
+
+    if (isMovePacket(update.type)) {
+        p = put16(p, update.delta.x);
+        p = put16(p, update.delta.y);
+        p = put16(p, update.delta.z);
+    } else {
+        p = put8(p, update.look.y.asByte());
+        p = put8(p, update.look.x.asByte());
+    }
+
+    return size;
+}
+
+bool decodeMovementUpdate(const uint8_t *buffer, size_t size, MovementUpdate &update) {
+    if (size < 3) {
+        return false;
+    }
+
+    PacketType type = static_cast<PacketType>(buffer[2]);
+
+    if (size != getMovementUpdateSize(type)) {
+        return false;
+    }
+
+    const uint8_t *p = get16(buffer, update.sequence);
+    p += 1;
+    update.type = type;
+    update.id = 0;
+
+    if (isEntityPacket(type)) {
+        p = get64(p, update.id);
+    }
+
+    if (isMovePacket(type)) {
+        uint16_t x, y, z;
+        p = get16(p, x);
+        p = get16(p, y);
+        p = get16(p, z);
+        update.delta = Velocity(x, y, z);
+    } else {
+        uint8_t pitch, yaw;
+        p = get8(p, pitch);
+        p = get8(p, yaw);
+        update.look = Orientation(Angle::fromByte(yaw), Angle::fromByte(pitch));
+    }
+
+    return true;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
+UdpLink::UdpLink(
+): mSocket(), mRemoteAddress(), mRemotePort() {
+    mSocket.setBlocking(false);
+}
+
+bool UdpLink::bind(unsigned short port) {
+    return mSocket.bind(port) == sf::Socket::Done;
+}
+
+unsigned short UdpLink::getLocalPort() const {
+    return mSocket.getLocalPort();
+}
+
+void UdpLink::setRemote(const sf::IpAddress &address, unsigned short port) {
+    mRemoteAddress = address;
+    mRemotePort = port;
+}
+
+bool UdpLink::send(const uint8_t *data, size_t size) {
+    return mSocket.send(data, size, mRemoteAddress, mRemotePort) == sf::Socket::Done;
+}
+
+bool UdpLink::receive(uint8_t *data, size_t capacity, size_t &size) {
+    sf::IpAddress address;
+    unsigned short port;
+
+    while (mSocket.receive(data, capacity, size, address, port) == sf::Socket::Done) {
+        if (address == mRemoteAddress && port == mRemotePort) {
+            return true;
+        }
+        // ignore datagrams from anyone but the peer
+    }
+
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+MovementChannel::MovementChannel(
+    DatagramLink &link
+): mLink(&link), mNextSequence(), mLatest(), mStaleCount(), mInvalidCount() {
+}
+
+bool MovementChannel::send(MovementUpdate &update) {
+    uint8_t buffer[MaxMovementDatagramSize];
+
+    if (getMovementUpdateSize(update.type) == 0) {
+        return false;
+    }
+
+    // player packets carry no id, so the receiver sees them with id 0
+    EntityID id = isEntityPacket(update.type) ? update.id : 0;
+    SequenceNumber &next = mNextSequence[StreamKey(update.type, id)];
+
+    update.sequence = next;
+    size_t size = encodeMovementUpdate(update, buffer);
+
+    next += 1;
+    return mLink->send(buffer, size);
+}
+
+bool MovementChannel::receive(MovementUpdate &update) {
+    uint8_t buffer[MaxMovementDatagramSize + 1];
+    size_t size;
+
+    while (mLink->receive(buffer, sizeof(buffer), size)) {
+        if (!decodeMovementUpdate(buffer, size, update)) {
+            mInvalidCount += 1;
+            continue;
+        }
+
+        StreamKey key(update.type, update.id);
+        auto found = mLatest.find(key);
+
+        if (found == mLatest.end()) {
+            mLatest.insert({key, update.sequence});
+            return true;
+        } else if (isSequenceNewer(update.sequence, found->second)) {
+            found->second = update.sequence;
+            return true;
+        }
+
+        // superseded (or duplicated) update
+        mStaleCount += 1;
+    }
+
+    return false;
+}
+
+void MovementChannel::forget(PacketType type, EntityID id) {
+    mNextSequence.erase(StreamKey(type, id));
+    mLatest.erase(StreamKey(type, id));
+}
+
+size_t MovementChannel::getStaleCount() const {
+    return mStaleCount;
+}
+
+size_t MovementChannel::getInvalidCount() const {
+    return mInvalidCount;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
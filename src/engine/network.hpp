@@ -7,6 +7,11 @@
 
 ////////////////////////////////////////////////////////////////////////////////
 
+#include <map>
+#include <utility>
+
+#include <SFML/Network/UdpSocket.hpp>
+
 #include "types.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -45,6 +50,21 @@ typedef uint16_t PacketSize;
  *      "blob32" - uint32 (length) followed by uint8[length]
  *      "string" - NUL-terminated UTF-8 string with uint16 prefix
  *                 (equivalent to blob16; length includes NUL)
+ *
+ *  Channels
+ *  -----
+ *
+ *  Packets are normally sent over the reliable (stream) connection.  Movement
+ *  updates (PlayerMove, PlayerLook, EntityMove, EntityLook) may instead be sent
+ *  over the unreliable (datagram) channel, one packet per datagram:
+ *
+ *      uint16 (sequence), uint8 (packet type), parameters...
+ *
+ *  A lost datagram is simply superseded by the next update, and a datagram
+ *  arriving after a newer one for the same stream is dropped, so a single
+ *  lost segment never holds up the updates behind it.  Since *Move packets
+ *  carry deltas, senders should still send an occasional *MoveTo over the
+ *  reliable channel to correct any accumulated drift.
  */
 
 enum class PacketType : uint8_t {
@@ -146,24 +166,27 @@ enum class PacketType : uint8_t {
     /**
      *  Check Resource (Client -> Server)
      *
-     *      Sends the timestamp of the client's version of the given resource.
-     *      If the client does not have the resource, set timestamp to zero.
-     *      If server decides the resource is outdated, it should send a
+     *      Sends the content hash of the client's version of the given
+     *      resource.  If the client does not have the resource, set hash to
+     *      zero.  If server decides the resource is outdated, it should send a
      *      LoadResource command with the new version.
      *
+     *      Hashes are 64-bit FNV-1a over the resource data (see resource.hpp).
      *
      *  Parameters:
-     *      uint32 (id), uint64 (timestamp)
+     *      uint32 (id), uint64 (hash)
      */
     CheckResource,
 
     /**
      *  Server -> Client
-     *      Sends resource data to the client.  The client should cache this
-     *      data for future connections to the server.
+     *      Announces resource data to the client; the data itself follows in
+     *      one or more ResourceData packets, which may be interleaved with
+     *      other packets (including data for other resources).  The client
+     *      should cache this data for future connections to the server.
      *
      *  Parameters:
-     *      uint32 (id), uint64 (timestamp), uint16 (type), blob32 (size, data)
+     *      uint32 (id), uint64 (hash), uint16 (type), uint32 (size)
      *      resource format described elsewhere; depends on type
      */
     LoadResource,
@@ -240,6 +263,17 @@ enum class PacketType : uint8_t {
      */
     EntityLook,
 
+    /**
+     *  Server -> Client
+     *      Sends part of the data announced by LoadResource.  Together, the
+     *      fragments for a resource make up the blob32 payload of the
+     *      resource; fragments for one resource are sent in order.
+     *
+     *  Parameters:
+     *      uint32 (id), uint32 (offset), blob16 (size, data)
+     */
+    ResourceData,
+
     CustomPacket = 0x80,
 };
 
@@ -254,6 +288,138 @@ struct Packet {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+enum class PacketChannel : uint8_t {
+    Reliable,   //!< Ordered stream; all packets may use this channel
+    Unreliable  //!< Sequenced datagrams; movement updates only
+};
+
+/**
+ *  Returns the preferred channel for the given packet type.
+ */
+PacketChannel getPacketChannel(PacketType type);
+
+typedef uint16_t SequenceNumber;
+
+/**
+ *  Compares sequence numbers with wraparound; returns true if a was sent
+ *  after b (assuming they are less than half the sequence space apart).
+ */
+inline bool isSequenceNewer(SequenceNumber a, SequenceNumber b) {
+    return static_cast<int16_t>(a - b) > 0;
+}
+
+/**
+ *  Decoded form of a movement packet sent over the unreliable channel.
+ */
+struct MovementUpdate {
+    PacketType type;            //!< PlayerMove, PlayerLook, EntityMove or EntityLook
+    SequenceNumber sequence;    //!< assigned by MovementChannel::send
+    EntityID id;                //!< Entity* packets only
+    Velocity delta;             //!< *Move packets only
+    Orientation look;           //!< *Look packets only (x = yaw, y = pitch)
+
+    MovementUpdate(
+    ): type(PacketType::PlayerMove), sequence(), id(), delta(), look(Angle::Zero, Angle::Zero) {
+    }
+};
+
+/**
+ *  Largest encoded MovementUpdate (EntityMove), in bytes.
+ */
+static const size_t MaxMovementDatagramSize = 2 + 1 + 8 + 6;
+
+/**
+ *  Encodes an update in the datagram format; returns the encoded size, or 0
+ *  if the packet type is not a movement packet.
+ */
+size_t encodeMovementUpdate(const MovementUpdate &update, uint8_t *buffer);
+
+/**
+ *  Decodes an update from the datagram format; returns false if the datagram
+ *  is malformed or not a movement packet.
+ */
+bool decodeMovementUpdate(const uint8_t *buffer, size_t size, MovementUpdate &update);
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ *  Sends and receives whole datagrams to and from a single peer.
+ */
+class DatagramLink {
+public:
+    virtual ~DatagramLink() {}
+
+    virtual bool send(const uint8_t *data, size_t size) = 0;
+
+    /**
+     *  Receives the next pending datagram, if any, without blocking.
+     */
+    virtual bool receive(uint8_t *data, size_t capacity, size_t &size) = 0;
+};
+
+/**
+ *  DatagramLink over a non-blocking UDP socket.
+ */
+class UdpLink : public DatagramLink {
+    sf::UdpSocket mSocket;
+    sf::IpAddress mRemoteAddress;
+    unsigned short mRemotePort;
+
+public:
+    UdpLink();
+
+    bool bind(unsigned short port = sf::Socket::AnyPort);
+    unsigned short getLocalPort() const;
+
+    void setRemote(const sf::IpAddress &address, unsigned short port);
+
+    bool send(const uint8_t *data, size_t size);
+    bool receive(uint8_t *data, size_t capacity, size_t &size);
+};
+
+/**
+ *  Unreliable-sequenced channel for movement updates.
+ *
+ *  Every update sent is stamped with the next sequence number of its stream
+ *  (packet type and entity); on receipt, updates older than the last one
+ *  accepted for the same stream are dropped as stale.  Counting per stream
+ *  keeps a stream comparable however long it idles while others send.
+ */
+class MovementChannel {
+    typedef std::pair<PacketType, EntityID> StreamKey;
+
+    DatagramLink *mLink;
+    std::map<StreamKey, SequenceNumber> mNextSequence;
+    std::map<StreamKey, SequenceNumber> mLatest;
+    size_t mStaleCount;
+    size_t mInvalidCount;
+
+public:
+    explicit MovementChannel(DatagramLink &link);
+
+    /**
+     *  Sends an update, assigning its sequence number.
+     */
+    bool send(MovementUpdate &update);
+
+    /**
+     *  Receives the next pending update that is newer than any previously
+     *  received for its stream; returns false when none remain.
+     */
+    bool receive(MovementUpdate &update);
+
+    /**
+     *  Forgets a stream, sent or received, e.g. when its entity is
+     *  despawned; both ends should forget it together.
+     */
+    void forget(PacketType type, EntityID id);
+
+    size_t getStaleCount() const;
+    size_t getInvalidCount() const;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
 #endif // __NETWORK_HPP__
 
 ////////////////////////////////////////////////////////////////////////////////
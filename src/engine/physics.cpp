@@ -3,8 +3,10 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #include "physics.hpp"
+#include "world.hpp"
 
-#include <SFML/System/Err.hpp>
+#include <algorithm>
+#include <cstdlib>
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -42,6 +44,10 @@ const Dimension &BoundingVolume::getDimensions() const {
     return mDimensions;
 }
 
+Size BoundingVolume::getWidth() const {
+    return mDimensions.x;
+}
+
 Size BoundingVolume::getRadius() const {
     return mDimensions.x;
 }
@@ -50,6 +56,24 @@ Size BoundingVolume::getHeight() const {
     return mDimensions.y;
 }
 
+Size BoundingVolume::getDepth() const {
+    return mDimensions.z;
+}
+
+Dimension BoundingVolume::getExtents() const {
+    switch (mType) {
+        case Capsule: {
+            Size radius = getRadius();
+            Size height = getHeight();
+            return Dimension(radius, height > radius ? height : radius, radius);
+        }
+
+        default: {
+            return mDimensions;
+        }
+    }
+}
+
 BoundingVolume BoundingVolume::box(const Dimension &dimensions) {
     return BoundingVolume(dimensions);
 }
@@ -68,108 +92,420 @@ Physics::Physics(
 ): mGravity(0,-6,0) {
 }
 
+const Velocity &Physics::getGravity() const {
+    return mGravity;
+}
+
+typedef Physics::CollisionType CollisionType;
+
+typedef CollisionType (*CollisionTest)(
+    const Position &pa, const BoundingVolume &va,
+    const Position &pb, const BoundingVolume &vb
+);
+
+/**
+ *  Classifies the distance between the cores of two shapes (points, segments
+ *  or boxes) against the sum of their radii.  Squared distances keep the
+ *  test in the integer domain.
+ */
+static CollisionType classify(HugeDelta distanceSquared, HugeDelta radius) {
+    HugeDelta outer = radius + Physics::Epsilon;
+    HugeDelta inner = radius - Physics::Epsilon;
+
+    if (distanceSquared > outer * outer) {
+        return CollisionType::None;
+    } else if (inner <= 0 || distanceSquared >= inner * inner) {
+        return CollisionType::Contact;
+    } else {
+        return CollisionType::Intrusion;
+    }
+}
+
+/**
+ *  Classifies a core lying inside a box, given how deep it is.
+ */
+static CollisionType classifyInside(HugeDelta depth, HugeDelta radius) {
+    if (depth + radius > Physics::Epsilon) {
+        return CollisionType::Intrusion;
+    } else {
+        return CollisionType::Contact;
+    }
+}
+
+/**
+ *  Gets the gap between two intervals, or zero if they overlap.
+ */
+static HugeDelta gap(Coord minA, Coord maxA, Coord minB, Coord maxB) {
+    if (minB > maxA) {
+        return minB - maxA;
+    } else if (minA > maxB) {
+        return minA - maxB;
+    } else {
+        return 0;
+    }
+}
+
+/**
+ *  Gets the vertical extent of a capsule's core segment.
+ */
+static void capsuleSegment(const Position &p, const BoundingVolume &v, Coord &bottom, Coord &top) {
+    Coord half = Coord(v.getHeight()) - v.getRadius();
+    if (half < 0) {
+        half = 0;
+    }
+    bottom = p.y - half;
+    top = p.y + half;
+}
+
+static CollisionType testBoxBox(
+    const Position &pa, const BoundingVolume &va,
+    const Position &pb, const BoundingVolume &vb
+) {
+    Position minA = pa - Position(va.getDimensions());
+    Position maxA = pa + Position(va.getDimensions());
+    Position minB = pb - Position(vb.getDimensions());
+    Position maxB = pb + Position(vb.getDimensions());
+
+    if (
+        minA.x <= maxB.x + Physics::Epsilon && minA.y <= maxB.y + Physics::Epsilon && minA.z <= maxB.z + Physics::Epsilon &&
+        minB.x <= maxA.x + Physics::Epsilon && minB.y <= maxA.y + Physics::Epsilon && minB.z <= maxA.z + Physics::Epsilon
+    ) {
+        if (
+            minA.x < maxB.x - Physics::Epsilon && minA.y < maxB.y - Physics::Epsilon && minA.z < maxB.z - Physics::Epsilon &&
+            minB.x < maxA.x - Physics::Epsilon && minB.y < maxA.y - Physics::Epsilon && minB.z < maxA.z - Physics::Epsilon
+        ) {
+            return CollisionType::Intrusion;
+        } else {
+            return CollisionType::Contact;
+        }
+    } else {
+        return CollisionType::None;
+    }
+}
+
+static CollisionType testSphereSphere(
+    const Position &pa, const BoundingVolume &va,
+    const Position &pb, const BoundingVolume &vb
+) {
+    Position c = pb - pa;
+    HugeDelta r = HugeDelta(va.getRadius()) + vb.getRadius();
+    return classify(c.x * c.x + c.y * c.y + c.z * c.z, r);
+}
+
+static CollisionType testCapsuleCapsule(
+    const Position &pa, const BoundingVolume &va,
+    const Position &pb, const BoundingVolume &vb
+) {
+    Coord bottomA, topA, bottomB, topB;
+    capsuleSegment(pa, va, bottomA, topA);
+    capsuleSegment(pb, vb, bottomB, topB);
+
+    // both segments are vertical, so the closest points are separated
+    // horizontally by the axis offset and vertically by the segment gap
+    Position c = pb - pa;
+    HugeDelta dy = gap(bottomA, topA, bottomB, topB);
+    HugeDelta r = HugeDelta(va.getRadius()) + vb.getRadius();
+    return classify(c.x * c.x + c.z * c.z + dy * dy, r);
+}
+
+static CollisionType testBoxSphere(
+    const Position &pa, const BoundingVolume &va,
+    const Position &pb, const BoundingVolume &vb
+) {
+    const Dimension &e = va.getDimensions();
+    Position c = pb - pa;
+
+    HugeDelta dx = std::abs(c.x) - e.x;
+    HugeDelta dy = std::abs(c.y) - e.y;
+    HugeDelta dz = std::abs(c.z) - e.z;
+    HugeDelta r = vb.getRadius();
+
+    if (dx <= 0 && dy <= 0 && dz <= 0) {
+        // centre inside the box
+        return classifyInside(-std::max(dx, std::max(dy, dz)), r);
+    }
+
+    dx = std::max<HugeDelta>(dx, 0);
+    dy = std::max<HugeDelta>(dy, 0);
+    dz = std::max<HugeDelta>(dz, 0);
+    return classify(dx * dx + dy * dy + dz * dz, r);
+}
+
+static CollisionType testBoxCapsule(
+    const Position &pa, const BoundingVolume &va,
+    const Position &pb, const BoundingVolume &vb
+) {
+    const Dimension &e = va.getDimensions();
+    Coord bottom, top;
+    capsuleSegment(pb, vb, bottom, top);
+
+    Position c = pb - pa;
+    HugeDelta dx = std::abs(c.x) - e.x;
+    HugeDelta dz = std::abs(c.z) - e.z;
+    HugeDelta dy = gap(pa.y - e.y, pa.y + e.y, bottom, top);
+    HugeDelta r = vb.getRadius();
+
+    if (dx <= 0 && dz <= 0 && dy == 0) {
+        // segment passes through the box; find the shortest way out
+        HugeDelta up = (pa.y + e.y) - bottom;
+        HugeDelta down = top - (pa.y - e.y);
+        HugeDelta depth = std::min(std::min(-dx, -dz), std::min(up, down));
+        return classifyInside(depth, r);
+    }
+
+    dx = std::max<HugeDelta>(dx, 0);
+    dz = std::max<HugeDelta>(dz, 0);
+    return classify(dx * dx + dy * dy + dz * dz, r);
+}
+
+static CollisionType testSphereCapsule(
+    const Position &pa, const BoundingVolume &va,
+    const Position &pb, const BoundingVolume &vb
+) {
+    Coord bottom, top;
+    capsuleSegment(pb, vb, bottom, top);
+
+    Position c = pb - pa;
+    HugeDelta dy = gap(pa.y, pa.y, bottom, top);
+    HugeDelta r = HugeDelta(va.getRadius()) + vb.getRadius();
+    return classify(c.x * c.x + c.z * c.z + dy * dy, r);
+}
+
+template <CollisionTest Test>
+static CollisionType swapped(
+    const Position &pa, const BoundingVolume &va,
+    const Position &pb, const BoundingVolume &vb
+) {
+    return Test(pb, vb, pa, va);
+}
+
+/**
+ *  Collision tests by shape pair, indexed by BoundingVolume::Type.
+ */
+static const CollisionTest sCollisionTests[3][3] = {
+    { testBoxBox,                     testBoxSphere,                    testBoxCapsule     },
+    { swapped<testBoxSphere>,         testSphereSphere,                 testSphereCapsule  },
+    { swapped<testBoxCapsule>,        swapped<testSphereCapsule>,       testCapsuleCapsule },
+};
+
 Physics::CollisionType Physics::checkCollision(
     const Body &a,
     const Body &b
-) {
+) const {
     const Position &pa = a.getPosition();
     const Position &pb = b.getPosition();
     const BoundingVolume &va = a.getBounds();
     const BoundingVolume &vb = b.getBounds();
 
-    if (va.getType() == vb.getType()) {
-        switch (va.getType()) {
-            case BoundingVolume::AABB: {
-                // box <-> box collision test
-                Position minA = pa - Position(va.getDimensions());
-                Position maxA = pa + Position(va.getDimensions());
-                Position minB = pb - Position(vb.getDimensions());
-                Position maxB = pb + Position(vb.getDimensions());
-
-                if (
-                    minA.x <= maxB.x + Epsilon && minA.y <= maxB.y + Epsilon && minA.z <= maxB.z + Epsilon &&
-                    minB.x <= maxA.x + Epsilon && minB.y <= maxA.y + Epsilon && minB.z <= maxA.z + Epsilon
-                ) {
-                    if (
-                        minA.x < maxB.x - Epsilon && minA.y < maxB.y - Epsilon && minA.z < maxB.z - Epsilon &&
-                        minB.x < maxA.x - Epsilon && minB.y < maxA.y - Epsilon && minB.z < maxA.z - Epsilon
-                    ) {
-                        return CollisionType::Intrusion;
-                    } else {
-                        return CollisionType::Contact;
-                    }
-                } else {
-                    return CollisionType::None;
-                }
-            }
+    // reject distant pairs by their enclosing boxes first; this also keeps
+    // the squared distances in the shape tests from overflowing
+    Dimension ea = va.getExtents();
+    Dimension eb = vb.getExtents();
+    Position c = pb - pa;
 
-            case BoundingVolume::Sphere: {
-                // sphere <-> sphere collision test
-                Position c = pb - pa;
-                LargeDelta r = vb.getRadius() + va.getRadius();
-                HugeDelta d = c.x * c.x + c.y * c.y + c.z * c.z - r * r;
-
-                if (d >= Epsilon) {
-                    return CollisionType::None;
-                } else if (d > -Epsilon) {
-                    return CollisionType::Contact;
-                } else {
-                    return CollisionType::Intrusion;
-                }
-            }
+    if (
+        std::abs(c.x) > Coord(ea.x) + eb.x + Epsilon ||
+        std::abs(c.y) > Coord(ea.y) + eb.y + Epsilon ||
+        std::abs(c.z) > Coord(ea.z) + eb.z + Epsilon
+    ) {
+        return CollisionType::None;
+    }
+
+    return sCollisionTests[va.getType()][vb.getType()](pa, va, pb, vb);
+}
 
-            case BoundingVolume::Capsule: {
-                // capsule <-> capsule collision test
-                Position c = pb - pa;
-                LargeDelta r = vb.getRadius() + va.getRadius();
-                //~ LargeDelta h = b.getHeight() + a.getHeight() - r;
-                HugeDelta d = c.x * c.x + c.z * c.z - r * r;
-
-                if (d >= Epsilon) {
-                    // out of horizontal range, no need to check vertical
-                    return CollisionType::None;
-                } else if (d > -Epsilon) {
-                    //! @todo vertical contact test
-                    return CollisionType::Contact;
-                } else {
-                    //! @todo vertical intrusion test
-                    return CollisionType::Intrusion;
+void Physics::update(Body &b, const sf::Time &t) const {
+    float s = t.asSeconds();
+    b.mPosition += Position(b.mVelocity.x * s, b.mVelocity.y * s, b.mVelocity.z * s);
+}
+
+/**
+ *  Looks up blocks, remembering the last chunk used.
+ */
+class VoxelQuery {
+    ChunkCache &mWorld;
+    Position mChunkPosition;
+    const Chunk *mChunk;
+
+public:
+    explicit VoxelQuery(ChunkCache &world): mWorld(world), mChunkPosition(), mChunk(nullptr) {}
+
+    bool isSolid(const Position &block) {
+        Position chunkPosition = toChunkPosition(block);
+        if (!mChunk || chunkPosition != mChunkPosition) {
+            mChunk = mWorld.getChunk(chunkPosition);
+            mChunkPosition = chunkPosition;
+        }
+        return mChunk && mChunk->getData() && Block::isSolid(mChunk->getData()->getType(block));
+    }
+};
+
+static Coord &component(Position &p, int axis) {
+    return axis == 0 ? p.x : axis == 1 ? p.y : p.z;
+}
+
+static Delta &component(Velocity &v, int axis) {
+    return axis == 0 ? v.x : axis == 1 ? v.y : v.z;
+}
+
+/**
+ *  Finds how far the box [min, max] can move along one axis before it meets
+ *  a solid block; only the slab of blocks swept by the leading face is tested.
+ */
+static Coord sweepAxis(
+    VoxelQuery &query,
+    const Position &min,
+    const Position &max,
+    int axis,
+    Coord distance
+) {
+    static const Coord BlockSize = Coord(1) << FixedPointBits;
+
+    int u = (axis + 1) % 3;
+    int v = (axis + 2) % 3;
+
+    Position lo(min), hi(max);
+
+    // blocks overlapped by the box across the other two axes; boxes only
+    // touching a block face do not overlap it
+    Coord uMin = component(lo, u) >> FixedPointBits;
+    Coord uMax = std::max(uMin, (component(hi, u) - 1) >> FixedPointBits);
+    Coord vMin = component(lo, v) >> FixedPointBits;
+    Coord vMax = std::max(vMin, (component(hi, v) - 1) >> FixedPointBits);
+
+    Coord start, end, step, lead;
+
+    if (distance > 0) {
+        lead = component(hi, axis);
+        start = (lead + BlockSize - 1) >> FixedPointBits;
+        end = (lead + distance - 1) >> FixedPointBits;
+        step = 1;
+        if (start > end) {
+            return distance;
+        }
+    } else {
+        lead = component(lo, axis);
+        start = (lead >> FixedPointBits) - 1;
+        end = (lead + distance) >> FixedPointBits;
+        step = -1;
+        if (start < end) {
+            return distance;
+        }
+    }
+
+    Position block;
+
+    for (Coord k = start; ; k += step) {
+        component(block, axis) = k;
+
+        for (Coord j = vMin; j <= vMax; j++) {
+            component(block, v) = j;
+
+            for (Coord i = uMin; i <= uMax; i++) {
+                component(block, u) = i;
+
+                if (query.isSolid(block)) {
+                    // stop at the near face of the block
+                    return (step > 0 ? k : k + 1) * BlockSize - lead;
                 }
             }
         }
-    } else {
-        if (va.getType() == BoundingVolume::AABB && vb.getType() == BoundingVolume::Sphere) {
-            //! @todo box <-> sphere collision test
-        } else if (va.getType() == BoundingVolume::Sphere && vb.getType() == BoundingVolume::AABB) {
-            //! @todo sphere <-> box collision test
-        } else if (va.getType() == BoundingVolume::AABB && vb.getType() == BoundingVolume::Capsule) {
-            //! @todo box <-> capsule collision test
-        } else if (va.getType() == BoundingVolume::Capsule && vb.getType() == BoundingVolume::AABB) {
-            //! @todo capsule <-> box collision test
-        } else if (va.getType() == BoundingVolume::Sphere && vb.getType() == BoundingVolume::Capsule) {
-            //! @todo sphere <-> capsule collision test
-        } else if (va.getType() == BoundingVolume::Capsule && vb.getType() == BoundingVolume::Sphere) {
-            //! @todo capsule <-> sphere collision test
+
+        if (k == end) {
+            break;
         }
     }
 
-    // no collision, or no test for given bounding volumes
-    sf::err() << "no collision test for given bounding volumes (" <<
-        va.getType() << ", " << vb.getType() << ")\n";
-    return CollisionType::None;
+    return distance;
 }
 
-void Physics::update(Body &b, const sf::Time &t) const {
+bool Physics::move(Body &b, ChunkCache &world, const Position &offset) const {
+    static const int Axes[3] = { 1, 0, 2 };
+
+    VoxelQuery query(world);
+    Position extents(b.mBounds.getExtents());
+    Position delta(offset);
+    bool blocked = false;
+
+    for (int axis : Axes) {
+        Coord distance = component(delta, axis);
+
+        if (distance == 0) {
+            continue;
+        }
+
+        Position min = b.mPosition - extents;
+        Position max = b.mPosition + extents;
+        Coord allowed = sweepAxis(query, min, max, axis, distance);
+
+        component(b.mPosition, axis) += allowed;
+
+        if (allowed != distance) {
+            component(b.mVelocity, axis) = 0;
+            blocked = true;
+        }
+    }
+
+    return blocked;
+}
+
+bool Physics::update(Body &b, ChunkCache &world, const sf::Time &t) const {
+    if (b.mAsleep) {
+        return false;
+    }
+
     float s = t.asSeconds();
-    b.mPosition += Position(b.mVelocity.x * s, b.mVelocity.y * s, b.mVelocity.z * s);
+    return move(b, world, Position(b.mVelocity.x * s, b.mVelocity.y * s, b.mVelocity.z * s));
+}
+
+void Physics::tick(Body &b, unsigned int ticks) const {
+    Coord t = ticks;
+    b.mPosition += Position(b.mVelocity.x * t, b.mVelocity.y * t, b.mVelocity.z * t);
+}
+
+bool Physics::tick(Body &b, ChunkCache &world, unsigned int ticks) const {
+    if (b.mAsleep) {
+        return false;
+    }
+
+    Coord t = ticks;
+    return move(b, world, Position(b.mVelocity.x * t, b.mVelocity.y * t, b.mVelocity.z * t));
+}
+
+bool Physics::settle(Body &b, unsigned int ticks) const {
+    if (b.mAsleep) {
+        return true;
+    }
+
+    if (
+        std::abs(b.mVelocity.x) <= SleepVelocity &&
+        std::abs(b.mVelocity.y) <= SleepVelocity &&
+        std::abs(b.mVelocity.z) <= SleepVelocity
+    ) {
+        b.mIdleTicks = std::min<unsigned int>(b.mIdleTicks + ticks, SleepTicks);
+        if (b.mIdleTicks >= SleepTicks) {
+            b.mAsleep = true;
+            b.mVelocity = Velocity(0, 0, 0);
+        }
+    } else {
+        b.mIdleTicks = 0;
+    }
+
+    return b.mAsleep;
 }
 
 void Physics::accelerate(Body &b, const Velocity &v) const {
+    if (v != Velocity(0, 0, 0)) {
+        b.wake();
+    }
+
     b.mVelocity += v;
 }
 
 void Physics::gravitate(Body &b) const {
-    accelerate(b, mGravity);
+    if (!b.mAsleep) {
+        b.mVelocity += mGravity;
+    }
 }
 
 void Physics::impulse(Body &b, const Velocity &v, const sf::Time &t) const {
@@ -177,6 +513,36 @@ void Physics::impulse(Body &b, const Velocity &v, const sf::Time &t) const {
     accelerate(b, Velocity(v.x * s, v.y * s, v.z * s));
 }
 
+void Physics::impulse(Body &b, const Velocity &v, unsigned int ticks) const {
+    accelerate(b, Velocity(v.x * ticks, v.y * ticks, v.z * ticks));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static uint64_t hashValue(uint64_t hash, uint64_t value, unsigned int bytes) {
+    for (unsigned int i = 0; i < bytes; i++) {
+        hash ^= (value >> (i * 8)) & 0xff;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+uint64_t hashBody(const Physics::Body &body, uint64_t hash) {
+    const Position &p = body.getPosition();
+    const Velocity &v = body.getVelocity();
+
+    hash = hashValue(hash, p.x, 8);
+    hash = hashValue(hash, p.y, 8);
+    hash = hashValue(hash, p.z, 8);
+    hash = hashValue(hash, uint16_t(v.x), 2);
+    hash = hashValue(hash, uint16_t(v.y), 2);
+    hash = hashValue(hash, uint16_t(v.z), 2);
+    hash = hashValue(hash, body.getMass(), 2);
+    hash = hashValue(hash, body.getIdleTicks(), 2);
+    hash = hashValue(hash, body.isAsleep(), 1);
+    return hash;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //  EOF
 ////////////////////////////////////////////////////////////////////////////////
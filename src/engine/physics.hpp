@@ -13,6 +13,8 @@
 
 ////////////////////////////////////////////////////////////////////////////////
 
+class ChunkCache;
+
 /**
  *  Axis-aligned box, used for physics simulation of (most) blocks.
  */
@@ -44,6 +46,16 @@ public:
     Size getHeight() const; // for box and capsule
     Size getDepth() const; // for box
 
+    /**
+     *  Gets the half-size of the axis-aligned box enclosing the volume.
+     *
+     *  Boxes extend by their dimensions either side of the body position;
+     *  spheres by their radius.  Capsules are vertical and extend by their
+     *  radius horizontally and by their height (the half-height, including
+     *  the rounded ends) vertically.
+     */
+    Dimension getExtents() const;
+
 public:
     static BoundingVolume box(const Dimension &dimensions);
     static BoundingVolume sphere(Size radius);
@@ -58,8 +70,17 @@ class Physics {
 public:
     static const Size Epsilon = 3; // ~1%
 
+    /**
+     *  Bodies moving no faster than SleepVelocity on every axis for
+     *  SleepTicks ticks fall asleep (see settle).
+     */
+    static const Delta SleepVelocity = 2;
+    static const uint16_t SleepTicks = 20;
+
     Physics();
 
+    const Velocity &getGravity() const;
+
     enum class CollisionType {
         None,       //!< Bounding volumes do not intersect
         Contact,    //!< Bounding volume surfaces intersect ("touch")
@@ -71,10 +92,15 @@ public:
         Velocity mVelocity;
         Size mMass;
         BoundingVolume mBounds;
+        uint16_t mIdleTicks;
+        bool mAsleep;
 
         friend class Physics;
+        friend class PhysicsWorld;
 
     public:
+        Body(): mPosition(), mVelocity(), mMass(), mBounds(), mIdleTicks(0), mAsleep(false) {}
+
         const Position &getPosition() const {
             return mPosition;
         }
@@ -88,6 +114,9 @@ public:
         }
 
         void setVelocity(const Velocity &velocity) {
+            if (velocity != Velocity(0, 0, 0)) {
+                wake();
+            }
             mVelocity = velocity;
         }
 
@@ -106,16 +135,78 @@ public:
         void setBounds(const BoundingVolume &bounds) {
             mBounds = bounds;
         }
+
+        bool isAsleep() const {
+            return mAsleep;
+        }
+
+        uint16_t getIdleTicks() const {
+            return mIdleTicks;
+        }
+
+        /**
+         *  Wakes the body, e.g. when a block it rests on changes.
+         */
+        void wake() {
+            mAsleep = false;
+            mIdleTicks = 0;
+        }
     };
 
-    CollisionType checkCollision(const Body &a, const Body &b);
+    CollisionType checkCollision(const Body &a, const Body &b) const;
 
     void update(Body &b, const sf::Time &t) const;
+
+    /**
+     *  Moves a body through the block world, stopping it at solid blocks.
+     *
+     *  Movement is resolved one axis at a time (vertical first), examining
+     *  only the blocks swept by the body's box along each axis; velocity
+     *  along a blocked axis is cleared.  Capsules collide as their enclosing
+     *  box, which for a vertical capsule on the block grid differs only at
+     *  the rounded ends.  Returns true if the body was blocked on any axis.
+     */
+    bool move(Body &b, ChunkCache &world, const Position &offset) const;
+    bool update(Body &b, ChunkCache &world, const sf::Time &t) const;
+
+    /**
+     *  Integer-only stepping by whole ticks.  Velocities are in meters/tick,
+     *  so these never touch floating point and give the same result on
+     *  every machine; anything both client and server simulate (such as
+     *  predicted movement) should use these instead of the sf::Time forms.
+     */
+    void tick(Body &b, unsigned int ticks = 1) const;
+    bool tick(Body &b, ChunkCache &world, unsigned int ticks = 1) const;
+
+    /**
+     *  Tracks how long a body has been (nearly) still, putting it to sleep
+     *  once it has been still for SleepTicks; call after moving it.  A
+     *  sleeping body has no velocity and is skipped by gravitate and the
+     *  block world forms of update and tick until it is woken, which any
+     *  non-zero accelerate or impulse does.  Returns true if asleep.
+     */
+    bool settle(Body &b, unsigned int ticks = 1) const;
+
     void accelerate(Body &b, const Velocity &v) const;
     void gravitate(Body &b) const;
     void impulse(Body &b, const Velocity &v, const sf::Time &t) const;
+    void impulse(Body &b, const Velocity &v, unsigned int ticks) const;
 };
 
+/**
+ *  Basis for state hashes, and the hash of no state.
+ */
+const uint64_t StateHashBasis = 0xcbf29ce484222325ULL;
+
+/**
+ *  Folds a body's position, velocity, mass and sleep state into a 64-bit
+ *  FNV-1a hash.
+ *  Values are hashed byte by byte in little-endian order, so equal states
+ *  hash equal on any machine; compare hashes to detect divergence between
+ *  simulations run in lockstep.
+ */
+uint64_t hashBody(const Physics::Body &body, uint64_t hash = StateHashBasis);
+
 ////////////////////////////////////////////////////////////////////////////////
 
 #endif // __PHYSICS_HPP__
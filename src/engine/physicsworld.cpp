@@ -0,0 +1,533 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "physicsworld.hpp"
+#include "world.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ *  Adds a constant to the velocity component of every awake body, wrapping
+ *  like Velocity's operator+= does.
+ */
+static void addVelocity(Delta *velocity, const uint8_t *asleep, size_t count, Delta v) {
+    for (size_t i = 0; i < count; i++) {
+        velocity[i] = Delta(velocity[i] + (asleep[i] ? 0 : v));
+    }
+}
+
+/**
+ *  Moves every position component by velocity * s, truncated toward zero
+ *  as Physics::update does.  The product is truncated to 32 bits, which
+ *  packs twice as many lanes as 64 bits and is exact while |v * s| < 2^31.
+ */
+static void integrate(Coord *position, const Delta *velocity, size_t count, float s) {
+    for (size_t i = 0; i < count; i++) {
+        position[i] += int32_t(float(velocity[i]) * s);
+    }
+}
+
+static void integrateTicks(Coord *position, const Delta *velocity, size_t count, Coord ticks) {
+    for (size_t i = 0; i < count; i++) {
+        position[i] += velocity[i] * ticks;
+    }
+}
+
+static void integrateWide(Coord *position, const Delta *velocity, size_t count, float s) {
+    for (size_t i = 0; i < count; i++) {
+        position[i] += Coord(float(velocity[i]) * s);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+PhysicsWorld::PhysicsWorld(
+    const Physics &physics
+): mPhysics(physics), mPositionX(), mPositionY(), mPositionZ(),
+   mVelocityX(), mVelocityY(), mVelocityZ(), mMass(), mBounds(),
+   mIdleTicks(), mAsleep(), mAwakeCount(0), mSleepingCount(0), mBroadphase(), mProxies(), mProxyBodies(), mPairs(), mPairTypes(), mContacts(),
+   mParents(), mIslands(), mIslandContacts(), mIslandStarts() {
+}
+
+PhysicsWorld::Index PhysicsWorld::add(const Physics::Body &body) {
+    Index index = mMass.size();
+
+    mPositionX.push_back(0);
+    mPositionY.push_back(0);
+    mPositionZ.push_back(0);
+    mVelocityX.push_back(0);
+    mVelocityY.push_back(0);
+    mVelocityZ.push_back(0);
+    mMass.push_back(0);
+    mBounds.push_back(BoundingVolume());
+    mIdleTicks.push_back(0);
+    mAsleep.push_back(0);
+
+    setBody(index, body);
+
+    Broadphase::Proxy proxy = mBroadphase.insert(body);
+    if (proxy >= mProxyBodies.size()) {
+        mProxyBodies.resize(proxy + 1);
+    }
+    mProxyBodies[proxy] = index;
+    mProxies.push_back(proxy);
+
+    return index;
+}
+
+PhysicsWorld::Index PhysicsWorld::remove(Index index) {
+    Index last = mMass.size() - 1;
+
+    mBroadphase.remove(mProxies[index]);
+
+    if (index != last) {
+        mProxies[index] = mProxies[last];
+        mProxyBodies[mProxies[index]] = index;
+
+        mPositionX[index] = mPositionX[last];
+        mPositionY[index] = mPositionY[last];
+        mPositionZ[index] = mPositionZ[last];
+        mVelocityX[index] = mVelocityX[last];
+        mVelocityY[index] = mVelocityY[last];
+        mVelocityZ[index] = mVelocityZ[last];
+        mMass[index] = mMass[last];
+        mBounds[index] = mBounds[last];
+        mIdleTicks[index] = mIdleTicks[last];
+        mAsleep[index] = mAsleep[last];
+    }
+
+    mPositionX.pop_back();
+    mPositionY.pop_back();
+    mPositionZ.pop_back();
+    mVelocityX.pop_back();
+    mVelocityY.pop_back();
+    mVelocityZ.pop_back();
+    mMass.pop_back();
+    mBounds.pop_back();
+    mIdleTicks.pop_back();
+    mAsleep.pop_back();
+    mProxies.pop_back();
+
+    return last;
+}
+
+void PhysicsWorld::clear() {
+    for (Broadphase::Proxy proxy : mProxies) {
+        mBroadphase.remove(proxy);
+    }
+
+    mProxies.clear();
+    mPositionX.clear();
+    mPositionY.clear();
+    mPositionZ.clear();
+    mVelocityX.clear();
+    mVelocityY.clear();
+    mVelocityZ.clear();
+    mMass.clear();
+    mBounds.clear();
+    mIdleTicks.clear();
+    mAsleep.clear();
+}
+
+size_t PhysicsWorld::getBodyCount() const {
+    return mMass.size();
+}
+
+Physics::Body PhysicsWorld::getBody(Index index) const {
+    Physics::Body body;
+    body.setPosition(getPosition(index));
+    body.setVelocity(getVelocity(index));
+    body.setMass(mMass[index]);
+    body.setBounds(mBounds[index]);
+    body.mIdleTicks = mIdleTicks[index];
+    body.mAsleep = mAsleep[index];
+    return body;
+}
+
+void PhysicsWorld::setBody(Index index, const Physics::Body &body) {
+    setPosition(index, body.getPosition());
+    setVelocity(index, body.getVelocity());
+    mMass[index] = body.getMass();
+    mBounds[index] = body.getBounds();
+    mIdleTicks[index] = body.getIdleTicks();
+    mAsleep[index] = body.isAsleep();
+}
+
+Position PhysicsWorld::getPosition(Index index) const {
+    return Position(mPositionX[index], mPositionY[index], mPositionZ[index]);
+}
+
+void PhysicsWorld::setPosition(Index index, const Position &position) {
+    mPositionX[index] = position.x;
+    mPositionY[index] = position.y;
+    mPositionZ[index] = position.z;
+}
+
+Velocity PhysicsWorld::getVelocity(Index index) const {
+    return Velocity(mVelocityX[index], mVelocityY[index], mVelocityZ[index]);
+}
+
+void PhysicsWorld::setVelocity(Index index, const Velocity &velocity) {
+    if (velocity != Velocity(0, 0, 0)) {
+        wake(index);
+    }
+
+    mVelocityX[index] = velocity.x;
+    mVelocityY[index] = velocity.y;
+    mVelocityZ[index] = velocity.z;
+}
+
+Size PhysicsWorld::getMass(Index index) const {
+    return mMass[index];
+}
+
+const BoundingVolume &PhysicsWorld::getBounds(Index index) const {
+    return mBounds[index];
+}
+
+bool PhysicsWorld::isAsleep(Index index) const {
+    return mAsleep[index];
+}
+
+void PhysicsWorld::wake(Index index) {
+    mAsleep[index] = 0;
+    mIdleTicks[index] = 0;
+}
+
+void PhysicsWorld::blockChanged(const Position &block) {
+    static const Coord BlockSize = Coord(1) << FixedPointBits;
+
+    Position min(block.x * BlockSize, block.y * BlockSize, block.z * BlockSize);
+    Position max(min.x + BlockSize, min.y + BlockSize, min.z + BlockSize);
+
+    // sleeping bodies have not moved since their proxies were last updated
+    std::vector<Broadphase::Proxy> proxies;
+    mBroadphase.query(min, max, proxies);
+
+    for (Broadphase::Proxy proxy : proxies) {
+        wake(mProxyBodies[proxy]);
+    }
+}
+
+void PhysicsWorld::accelerate(const Velocity &v) {
+    size_t count = mMass.size();
+    addVelocity(mVelocityX.data(), mAsleep.data(), count, v.x);
+    addVelocity(mVelocityY.data(), mAsleep.data(), count, v.y);
+    addVelocity(mVelocityZ.data(), mAsleep.data(), count, v.z);
+}
+
+void PhysicsWorld::gravitate() {
+    accelerate(mPhysics.getGravity());
+}
+
+void PhysicsWorld::update(const sf::Time &t) {
+    size_t count = mMass.size();
+    float s = t.asSeconds();
+
+    // the largest velocity magnitude is 2^15, so the 32-bit path is exact
+    // for steps up to 2^16 seconds
+    if (std::abs(s) < 65536.0f) {
+        integrate(mPositionX.data(), mVelocityX.data(), count, s);
+        integrate(mPositionY.data(), mVelocityY.data(), count, s);
+        integrate(mPositionZ.data(), mVelocityZ.data(), count, s);
+    } else {
+        integrateWide(mPositionX.data(), mVelocityX.data(), count, s);
+        integrateWide(mPositionY.data(), mVelocityY.data(), count, s);
+        integrateWide(mPositionZ.data(), mVelocityZ.data(), count, s);
+    }
+}
+
+void PhysicsWorld::tick(unsigned int ticks) {
+    size_t count = mMass.size();
+    integrateTicks(mPositionX.data(), mVelocityX.data(), count, ticks);
+    integrateTicks(mPositionY.data(), mVelocityY.data(), count, ticks);
+    integrateTicks(mPositionZ.data(), mVelocityZ.data(), count, ticks);
+}
+
+void PhysicsWorld::findContacts(std::vector<Contact> &contacts, JobPool *jobs) {
+    static const size_t BatchSize = 256;
+
+    contacts.clear();
+
+    for (size_t i = 0; i < mProxies.size(); i++) {
+        if (!mAsleep[i]) {
+            mBroadphase.update(mProxies[i], getPosition(i), mBounds[i].getExtents());
+        }
+        mBroadphase.setActive(mProxies[i], !mAsleep[i]);
+    }
+
+    mBroadphase.findPairs(mPairs);
+    mPairTypes.resize(mPairs.size());
+
+    auto test = [this](size_t batch) {
+        size_t end = std::min(mPairs.size(), (batch + 1) * BatchSize);
+        for (size_t i = batch * BatchSize; i < end; i++) {
+            Index a = mProxyBodies[mPairs[i].first];
+            Index b = mProxyBodies[mPairs[i].second];
+            mPairTypes[i] = mPhysics.checkCollision(getBody(a), getBody(b));
+        }
+    };
+
+    size_t batches = (mPairs.size() + BatchSize - 1) / BatchSize;
+    if (jobs) {
+        jobs->run(batches, test);
+    } else {
+        for (size_t batch = 0; batch < batches; batch++) {
+            test(batch);
+        }
+    }
+
+    for (size_t i = 0; i < mPairs.size(); i++) {
+        if (mPairTypes[i] != Physics::CollisionType::None) {
+            Index a = mProxyBodies[mPairs[i].first];
+            Index b = mProxyBodies[mPairs[i].second];
+            Contact contact = {std::min(a, b), std::max(a, b), mPairTypes[i]};
+            contacts.push_back(contact);
+        }
+    }
+
+    // proxies and body indices differ after removals
+    std::sort(contacts.begin(), contacts.end(), [](const Contact &x, const Contact &y) {
+        return x.a < y.a || (x.a == y.a && x.b < y.b);
+    });
+}
+
+void PhysicsWorld::step(const sf::Time &t, JobPool &jobs) {
+    solve(jobs);
+    update(t);
+    settle(1);
+}
+
+void PhysicsWorld::step(unsigned int ticks, JobPool &jobs) {
+    solve(jobs);
+    tick(ticks);
+    settle(ticks);
+}
+
+void PhysicsWorld::step(unsigned int ticks, JobPool &jobs, ChunkCache &terrain) {
+    solve(jobs);
+
+    for (size_t i = 0; i < mMass.size(); i++) {
+        if (mAsleep[i]) {
+            continue;
+        }
+
+        Physics::Body body = getBody(i);
+        mPhysics.tick(body, terrain, ticks);
+
+        const Position &p = body.getPosition();
+        const Velocity &v = body.getVelocity();
+        mPositionX[i] = p.x;
+        mPositionY[i] = p.y;
+        mPositionZ[i] = p.z;
+        mVelocityX[i] = v.x;
+        mVelocityY[i] = v.y;
+        mVelocityZ[i] = v.z;
+    }
+
+    settle(ticks);
+}
+
+uint64_t PhysicsWorld::getStateHash() const {
+    uint64_t hash = StateHashBasis;
+    for (size_t i = 0; i < mMass.size(); i++) {
+        hash = hashBody(getBody(i), hash);
+    }
+    return hash;
+}
+
+size_t PhysicsWorld::getIslandCount() const {
+    return mIslandStarts.empty() ? 0 : mIslandStarts.size() - 1;
+}
+
+size_t PhysicsWorld::getAwakeCount() const {
+    return mAwakeCount;
+}
+
+size_t PhysicsWorld::getSleepingCount() const {
+    return mSleepingCount;
+}
+
+void PhysicsWorld::solve(JobPool &jobs) {
+    gravitate();
+    findContacts(mContacts, &jobs);
+    buildIslands();
+    wakeIslands();
+
+    jobs.run(getIslandCount(), [this](size_t island) {
+        solveIsland(island);
+    });
+}
+
+PhysicsWorld::Index PhysicsWorld::findRoot(Index index) {
+    while (mParents[index] != index) {
+        mParents[index] = mParents[mParents[index]];
+        index = mParents[index];
+    }
+    return index;
+}
+
+void PhysicsWorld::buildIslands() {
+    static const Index None = ~Index(0);
+    size_t count = mMass.size();
+
+    mParents.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        mParents[i] = i;
+    }
+
+    // the lowest body of each island becomes its root, so island numbering
+    // only depends on the contacts
+    for (const Contact &contact : mContacts) {
+        Index a = findRoot(contact.a);
+        Index b = findRoot(contact.b);
+        if (a < b) {
+            mParents[b] = a;
+        } else if (b < a) {
+            mParents[a] = b;
+        }
+    }
+
+    mIslands.assign(count, None);
+    mIslandStarts.clear();
+
+    for (const Contact &contact : mContacts) {
+        Index root = findRoot(contact.a);
+        if (mIslands[root] == None) {
+            mIslands[root] = mIslandStarts.size();
+            mIslandStarts.push_back(0);
+        }
+        mIslandStarts[mIslands[root]] += 1;
+    }
+
+    // counting sort of the contacts by island, keeping their order within
+    // each island
+    size_t start = 0;
+    for (size_t &island : mIslandStarts) {
+        size_t size = island;
+        island = start;
+        start += size;
+    }
+    mIslandStarts.push_back(start);
+
+    mIslandContacts.resize(mContacts.size());
+    std::vector<size_t> next(mIslandStarts.begin(), mIslandStarts.end() - 1);
+
+    for (const Contact &contact : mContacts) {
+        mIslandContacts[next[mIslands[findRoot(contact.a)]]++] = contact;
+    }
+}
+
+void PhysicsWorld::settle(unsigned int ticks) {
+    size_t count = mMass.size();
+    mSleepingCount = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        if (!mAsleep[i]) {
+            if (
+                std::abs(mVelocityX[i]) <= Physics::SleepVelocity &&
+                std::abs(mVelocityY[i]) <= Physics::SleepVelocity &&
+                std::abs(mVelocityZ[i]) <= Physics::SleepVelocity
+            ) {
+                mIdleTicks[i] = std::min<unsigned int>(mIdleTicks[i] + ticks, Physics::SleepTicks);
+                if (mIdleTicks[i] >= Physics::SleepTicks) {
+                    mAsleep[i] = 1;
+                    mVelocityX[i] = 0;
+                    mVelocityY[i] = 0;
+                    mVelocityZ[i] = 0;
+                }
+            } else {
+                mIdleTicks[i] = 0;
+            }
+        }
+
+        mSleepingCount += mAsleep[i];
+    }
+
+    mAwakeCount = count - mSleepingCount;
+}
+
+void PhysicsWorld::wakeIslands() {
+    // an island is solved as a whole, so one awake body wakes all of it
+    for (size_t island = 0; island < getIslandCount(); island++) {
+        size_t begin = mIslandStarts[island];
+        size_t end = mIslandStarts[island + 1];
+        bool awake = false;
+
+        for (size_t i = begin; i < end && !awake; i++) {
+            awake = !mAsleep[mIslandContacts[i].a] || !mAsleep[mIslandContacts[i].b];
+        }
+
+        if (awake) {
+            for (size_t i = begin; i < end; i++) {
+                if (mAsleep[mIslandContacts[i].a]) {
+                    wake(mIslandContacts[i].a);
+                }
+                if (mAsleep[mIslandContacts[i].b]) {
+                    wake(mIslandContacts[i].b);
+                }
+            }
+        }
+    }
+}
+
+void PhysicsWorld::solveIsland(size_t island) {
+    size_t begin = mIslandStarts[island];
+    size_t end = mIslandStarts[island + 1];
+
+    if (mAsleep[mIslandContacts[begin].a]) {
+        // woken islands are entirely awake, so this one is entirely asleep
+        return;
+    }
+
+    for (unsigned int iteration = 0; iteration < SolverIterations; iteration++) {
+        for (size_t i = begin; i < end; i++) {
+            solveContact(mIslandContacts[i]);
+        }
+    }
+}
+
+void PhysicsWorld::solveContact(const Contact &contact) {
+    Index a = contact.a;
+    Index b = contact.b;
+
+    // separate along the axis of largest offset between the bodies
+    HugeDelta dx = mPositionX[b] - mPositionX[a];
+    HugeDelta dy = mPositionY[b] - mPositionY[a];
+    HugeDelta dz = mPositionZ[b] - mPositionZ[a];
+
+    Delta *velocity = mVelocityX.data();
+    HugeDelta offset = dx;
+
+    if (std::abs(dy) >= std::abs(offset)) {
+        velocity = mVelocityY.data();
+        offset = dy;
+    }
+    if (std::abs(dz) > std::abs(offset)) {
+        velocity = mVelocityZ.data();
+        offset = dz;
+    }
+
+    HugeDelta approach = HugeDelta(velocity[a]) - velocity[b];
+    if ((offset >= 0 && approach <= 0) || (offset < 0 && approach >= 0)) {
+        return;
+    }
+
+    // perfectly inelastic along the axis; massless bodies count as equal
+    HugeDelta ma = mMass[a], mb = mMass[b];
+    if (ma + mb == 0) {
+        ma = mb = 1;
+    }
+
+    HugeDelta v = (ma * velocity[a] + mb * velocity[b]) / (ma + mb);
+    velocity[a] = v;
+    velocity[b] = v;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
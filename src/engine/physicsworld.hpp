@@ -0,0 +1,188 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __PHYSICSWORLD_HPP__
+#define __PHYSICSWORLD_HPP__ 1
+
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstddef>
+#include <vector>
+
+#include "broadphase.hpp"
+#include "jobs.hpp"
+#include "physics.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ *  Bodies stored as separate arrays per component, so that whole-world
+ *  passes (gravity, integration) run as tight loops the compiler can
+ *  vectorize instead of one member call per body.
+ *
+ *  Results are bit-identical to calling the Physics methods on each body.
+ *  Bodies are kept densely packed: removing one moves the last body into
+ *  its place, so indices are only stable until the next removal.
+ *
+ *  step() also resolves collisions between bodies.  Touching bodies are
+ *  grouped into islands, which share no bodies and are solved in parallel;
+ *  each island is solved in a fixed order, so the result does not depend
+ *  on the number of threads.
+ *
+ *  Bodies that stay still fall asleep as described for Physics::settle.
+ *  Sleeping bodies are not moved, are not tested against each other, and
+ *  islands of only sleeping bodies are not solved, so the cost of a step
+ *  follows the number of awake bodies.  A sleeping body wakes when given a
+ *  velocity, when an awake body touches its island, or through
+ *  blockChanged.
+ */
+class PhysicsWorld {
+public:
+    typedef uint32_t Index;
+
+    struct Contact {
+        Index a;
+        Index b;
+        Physics::CollisionType type;
+    };
+
+    /**
+     *  Number of passes over an island's contacts per step.
+     */
+    static const unsigned int SolverIterations = 4;
+
+private:
+    const Physics &mPhysics;
+
+    std::vector<Coord> mPositionX;
+    std::vector<Coord> mPositionY;
+    std::vector<Coord> mPositionZ;
+    std::vector<Delta> mVelocityX;
+    std::vector<Delta> mVelocityY;
+    std::vector<Delta> mVelocityZ;
+    std::vector<Size> mMass;
+    std::vector<BoundingVolume> mBounds;
+    std::vector<uint16_t> mIdleTicks;
+    std::vector<uint8_t> mAsleep;
+
+    size_t mAwakeCount;
+    size_t mSleepingCount;
+
+    Broadphase mBroadphase;
+    std::vector<Broadphase::Proxy> mProxies;
+    std::vector<Index> mProxyBodies;
+
+    std::vector<Broadphase::Pair> mPairs;
+    std::vector<Physics::CollisionType> mPairTypes;
+    std::vector<Contact> mContacts;
+    std::vector<Index> mParents;
+    std::vector<Index> mIslands;
+    std::vector<Contact> mIslandContacts;
+    std::vector<size_t> mIslandStarts;
+
+public:
+    explicit PhysicsWorld(const Physics &physics);
+
+    Index add(const Physics::Body &body);
+
+    /**
+     *  Removes a body, moving the last body into its place.  Returns the
+     *  previous index of the moved body, which equals the given index if
+     *  the removed body was the last one.
+     */
+    Index remove(Index index);
+
+    void clear();
+
+    size_t getBodyCount() const;
+
+    Physics::Body getBody(Index index) const;
+    void setBody(Index index, const Physics::Body &body);
+
+    Position getPosition(Index index) const;
+    void setPosition(Index index, const Position &position);
+
+    Velocity getVelocity(Index index) const;
+    void setVelocity(Index index, const Velocity &velocity);
+
+    Size getMass(Index index) const;
+    const BoundingVolume &getBounds(Index index) const;
+
+    bool isAsleep(Index index) const;
+    void wake(Index index);
+
+    /**
+     *  Wakes every body touching the given block; call whenever a block
+     *  changes so that bodies resting on or against it react.
+     */
+    void blockChanged(const Position &block);
+
+    /**
+     *  Changes the velocity of every awake body.
+     */
+    void accelerate(const Velocity &v);
+    void gravitate();
+    void update(const sf::Time &t);
+
+    /**
+     *  Moves all bodies by whole ticks, using integer arithmetic only; see
+     *  Physics::tick.
+     */
+    void tick(unsigned int ticks = 1);
+
+    /**
+     *  Finds all pairs of touching or overlapping bodies, other than pairs
+     *  of sleeping bodies, each given once as (lower, higher) index and
+     *  sorted.  Narrowphase tests are spread over the job pool if given.
+     */
+    void findContacts(std::vector<Contact> &contacts, JobPool *jobs = nullptr);
+
+    /**
+     *  Applies gravity, stops colliding bodies from approaching each other
+     *  and moves all bodies.  Colliding bodies lose their relative velocity
+     *  along the axis separating them, keeping their total momentum.
+     */
+    void step(const sf::Time &t, JobPool &jobs);
+    void step(unsigned int ticks, JobPool &jobs);
+
+    /**
+     *  Steps by whole ticks, moving awake bodies through the block world as
+     *  Physics::tick does.  The block world is not thread-safe, so bodies
+     *  are moved one at a time after islands are solved in parallel.
+     */
+    void step(unsigned int ticks, JobPool &jobs, ChunkCache &terrain);
+
+    /**
+     *  Hashes the state of every body in index order; see hashBody.
+     */
+    uint64_t getStateHash() const;
+
+    /**
+     *  Gets the number of islands of two or more bodies in the last step.
+     */
+    size_t getIslandCount() const;
+
+    /**
+     *  Gets the number of awake and sleeping bodies after the last step.
+     */
+    size_t getAwakeCount() const;
+    size_t getSleepingCount() const;
+
+private:
+    void solve(JobPool &jobs);
+    void settle(unsigned int ticks);
+    void wakeIslands();
+    Index findRoot(Index index);
+    void buildIslands();
+    void solveIsland(size_t island);
+    void solveContact(const Contact &contact);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // __PHYSICSWORLD_HPP__
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,210 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+
+////////////////////////////////////////////////////////////////////////////////
+
+static double toMilliseconds(sf::Time time) {
+    return time.asMicroseconds() / 1000.0;
+}
+
+void TickTrace::write(FILE *file) const {
+    fprintf(file, "slow tick %" PRIu64 ": %.3f ms (budget %.3f ms)\n",
+            tick, toMilliseconds(length), toMilliseconds(budget));
+
+    for (const TickSpan &span : spans) {
+        fprintf(file, "  %*s%-*s %8.3f ms  @ %.3f ms\n",
+                int(span.depth * 2), "", int(20 - span.depth * 2), span.name,
+                toMilliseconds(span.length), toMilliseconds(span.start));
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+TickProfiler::Scope::Scope(
+    TickProfiler &profiler,
+    Phase phase
+): mProfiler(profiler) {
+    mProfiler.begin(phase);
+}
+
+TickProfiler::Scope::Scope(
+    TickProfiler &profiler,
+    const char *name
+): mProfiler(profiler) {
+    mProfiler.begin(name);
+}
+
+TickProfiler::Scope::~Scope() {
+    mProfiler.end();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+TickProfiler::TickProfiler(
+    sf::Time budget,
+    size_t window
+): mBudget(budget), mWindow(std::max(window, size_t(1))), mClock(), mTickStart(), mTrace(), mOpen(),
+   mPhaseTimes(), mInTick(false), mHistory(), mTickHistory(), mNext(0), mCount(0), mSlowTicks(0),
+   mSlowTrace(), mSlowTickHandler(
+    [](const TickTrace &trace) { trace.write(stderr); }
+) {
+    for (std::vector<sf::Time> &history : mHistory) {
+        history.resize(mWindow);
+    }
+    mTickHistory.resize(mWindow);
+}
+
+void TickProfiler::setBudget(sf::Time budget) {
+    mBudget = budget;
+}
+
+sf::Time TickProfiler::getBudget() const {
+    return mBudget;
+}
+
+void TickProfiler::setSlowTickHandler(const SlowTickHandler &handler) {
+    mSlowTickHandler = handler;
+}
+
+void TickProfiler::beginTick(uint64_t tick) {
+    mTickStart = mClock.getElapsedTime();
+    mTrace.tick = tick;
+    mTrace.length = sf::Time::Zero;
+    mTrace.budget = mBudget;
+    mTrace.spans.clear();
+    mOpen.clear();
+    std::fill(mPhaseTimes, mPhaseTimes + PhaseCount, sf::Time::Zero);
+    mInTick = true;
+}
+
+void TickProfiler::endTick() {
+    if (!mInTick) {
+        return;
+    }
+
+    while (!mOpen.empty()) {
+        end();
+    }
+
+    mTrace.length = getTickTime();
+    mInTick = false;
+
+    for (int phase = 0; phase < PhaseCount; phase++) {
+        mHistory[phase][mNext] = mPhaseTimes[phase];
+    }
+    mTickHistory[mNext] = mTrace.length;
+    mNext = (mNext + 1) % mWindow;
+    mCount = std::min(mCount + 1, mWindow);
+
+    if (mTrace.length > mBudget) {
+        mSlowTicks += 1;
+        mSlowTrace = mTrace;
+        if (mSlowTickHandler) {
+            mSlowTickHandler(mSlowTrace);
+        }
+    }
+}
+
+void TickProfiler::begin(Phase phase) {
+    open(getPhaseName(phase), phase);
+}
+
+void TickProfiler::begin(const char *name) {
+    open(name, -1);
+}
+
+void TickProfiler::end() {
+    if (mOpen.empty()) {
+        return;
+    }
+
+    OpenSpan open = mOpen.back();
+    mOpen.pop_back();
+
+    TickSpan &span = mTrace.spans[open.span];
+    span.length = getTickTime() - span.start;
+
+    if (open.phase >= 0) {
+        mPhaseTimes[open.phase] += span.length;
+    }
+}
+
+void TickProfiler::addSpan(const char *name, sf::Time start, sf::Time length) {
+    TickSpan span = { name, unsigned(mOpen.size()), start, length };
+    mTrace.spans.push_back(span);
+}
+
+sf::Time TickProfiler::getTickTime() const {
+    return mClock.getElapsedTime() - mTickStart;
+}
+
+sf::Time TickProfiler::getPhaseTime(Phase phase) const {
+    return mPhaseTimes[phase];
+}
+
+sf::Time TickProfiler::getPercentile(Phase phase, float percentile) const {
+    return TickProfiler::percentile(mHistory[phase], mCount, percentile);
+}
+
+sf::Time TickProfiler::getTickPercentile(float percentile) const {
+    return TickProfiler::percentile(mTickHistory, mCount, percentile);
+}
+
+size_t TickProfiler::getSampleCount() const {
+    return mCount;
+}
+
+uint64_t TickProfiler::getSlowTickCount() const {
+    return mSlowTicks;
+}
+
+const TickTrace &TickProfiler::getSlowTrace() const {
+    return mSlowTrace;
+}
+
+const TickTrace &TickProfiler::getTrace() const {
+    return mTrace;
+}
+
+const char *TickProfiler::getPhaseName(Phase phase) {
+    static const char *Names[PhaseCount] = {
+        "network in",
+        "entities",
+        "physics",
+        "block updates",
+        "lighting",
+        "network out",
+        "saving"
+    };
+    return phase < PhaseCount ? Names[phase] : "unknown";
+}
+
+void TickProfiler::open(const char *name, int phase) {
+    TickSpan span = { name, unsigned(mOpen.size()), getTickTime(), sf::Time::Zero };
+    OpenSpan open = { mTrace.spans.size(), phase };
+
+    mTrace.spans.push_back(span);
+    mOpen.push_back(open);
+}
+
+sf::Time TickProfiler::percentile(const std::vector<sf::Time> &samples, size_t count, float percentile) {
+    if (count == 0) {
+        return sf::Time::Zero;
+    }
+
+    // nearest rank
+    std::vector<sf::Time> sorted(samples.begin(), samples.begin() + count);
+    size_t rank = size_t(std::max(0.0f, std::min(percentile, 100.0f)) / 100.0f * (count - 1) + 0.5f);
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,190 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __PROFILER_HPP__
+#define __PROFILER_HPP__ 1
+
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+#include <SFML/System/Clock.hpp>
+#include <SFML/System/Time.hpp>
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ *  One timed span of a tick: a phase, or a named part of one.
+ */
+struct TickSpan {
+    const char *name;
+    unsigned int depth;     //!< 0 for phases, more for parts nested in them
+    sf::Time start;         //!< From the start of the tick
+    sf::Time length;
+};
+
+/**
+ *  Everything recorded about one tick.
+ */
+struct TickTrace {
+    uint64_t tick;
+    sf::Time length;
+    sf::Time budget;
+    std::vector<TickSpan> spans;
+
+    /**
+     *  Writes the trace as indented text, one span per line.
+     */
+    void write(FILE *file) const;
+};
+
+/**
+ *  Times the phases of each server tick.
+ *
+ *  Phase times are kept for a rolling window of ticks, from which
+ *  percentiles are taken.  Every tick is traced in full, and whenever a
+ *  tick takes longer than its budget the trace is handed to the slow tick
+ *  handler, which by default writes it to stderr.
+ *
+ *  Spans are opened and closed by Scope objects and must nest properly;
+ *  the profiler is not thread-safe, so only the thread running the tick
+ *  should use it (parts run on other threads can be added with addSpan).
+ */
+class TickProfiler {
+public:
+    enum Phase {
+        NetworkIn,
+        Entities,
+        Physics,
+        BlockUpdates,
+        Lighting,
+        NetworkOut,
+        Saving,
+        PhaseCount
+    };
+
+    typedef std::function<void(const TickTrace &)> SlowTickHandler;
+
+    /**
+     *  Times a phase, or a named part of the current phase, for as long as
+     *  it exists.
+     */
+    class Scope {
+        TickProfiler &mProfiler;
+
+    public:
+        Scope(TickProfiler &profiler, Phase phase);
+        Scope(TickProfiler &profiler, const char *name);
+        ~Scope();
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+    };
+
+private:
+    struct OpenSpan {
+        size_t span;
+        int phase;      //!< Phase, or -1 for a part of one
+    };
+
+    sf::Time mBudget;
+    size_t mWindow;
+
+    sf::Clock mClock;
+    sf::Time mTickStart;
+    TickTrace mTrace;
+    std::vector<OpenSpan> mOpen;        //!< Spans not yet closed, innermost last
+    sf::Time mPhaseTimes[PhaseCount];
+    bool mInTick;
+
+    // ring buffers of the last mWindow ticks
+    std::vector<sf::Time> mHistory[PhaseCount];
+    std::vector<sf::Time> mTickHistory;
+    size_t mNext;
+    size_t mCount;
+
+    uint64_t mSlowTicks;
+    TickTrace mSlowTrace;
+    SlowTickHandler mSlowTickHandler;
+
+public:
+    explicit TickProfiler(sf::Time budget, size_t window = 256);
+
+    void setBudget(sf::Time budget);
+    sf::Time getBudget() const;
+
+    /**
+     *  Sets the handler for slow ticks; an empty handler disables dumps.
+     */
+    void setSlowTickHandler(const SlowTickHandler &handler);
+
+    void beginTick(uint64_t tick);
+    void endTick();
+
+    void begin(Phase phase);
+    void begin(const char *name);
+    void end();
+
+    /**
+     *  Adds a span measured elsewhere (such as on worker threads), nested in
+     *  the current span, starting at a time relative to the tick.
+     */
+    void addSpan(const char *name, sf::Time start, sf::Time length);
+
+    /**
+     *  Gets the time since the start of the current tick.
+     */
+    sf::Time getTickTime() const;
+
+    /**
+     *  Gets a phase's time in the last tick.
+     */
+    sf::Time getPhaseTime(Phase phase) const;
+
+    /**
+     *  Gets a percentile (0 to 100) of a phase's time over the window.
+     */
+    sf::Time getPercentile(Phase phase, float percentile) const;
+
+    /**
+     *  Gets a percentile (0 to 100) of whole tick times over the window.
+     */
+    sf::Time getTickPercentile(float percentile) const;
+
+    /**
+     *  Gets the number of ticks in the window.
+     */
+    size_t getSampleCount() const;
+
+    uint64_t getSlowTickCount() const;
+
+    /**
+     *  Gets the trace of the last tick to exceed its budget.
+     */
+    const TickTrace &getSlowTrace() const;
+
+    /**
+     *  Gets the trace of the last tick, or of the tick so far.
+     */
+    const TickTrace &getTrace() const;
+
+    static const char *getPhaseName(Phase phase);
+
+private:
+    void open(const char *name, int phase);
+
+    static sf::Time percentile(const std::vector<sf::Time> &samples, size_t count, float percentile);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // __PROFILER_HPP__
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,86 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __QUEUE_HPP__
+#define __QUEUE_HPP__ 1
+
+////////////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <utility>
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ *  Unbounded lock-free queue for many producer threads and one consumer
+ *  (Vyukov's intrusive MPSC queue).
+ *
+ *  push() may be called from any thread; pop() only from the one consumer
+ *  thread.  A push is a single atomic exchange, so producers never wait on
+ *  each other or on the consumer.  Between the exchange and the link that
+ *  follows it, pop() may briefly see the queue as empty though it is not;
+ *  the item is found by a later pop().
+ */
+template <typename T>
+class MPSCQueue {
+    struct Node {
+        std::atomic<Node *> next;
+        T value;
+
+        Node(): next(nullptr), value() {}
+        explicit Node(T &&value): next(nullptr), value(std::move(value)) {}
+    };
+
+    std::atomic<Node *> mHead;  //!< Last pushed, updated by producers
+    Node *mTail;                //!< Stub before the next item, consumer only
+
+public:
+    MPSCQueue(): mHead(), mTail(new Node()) {
+        mHead.store(mTail, std::memory_order_relaxed);
+    }
+
+    ~MPSCQueue() {
+        T value;
+        while (pop(value)) {
+        }
+        delete mTail;
+    }
+
+    MPSCQueue(const MPSCQueue &) = delete;
+    MPSCQueue &operator=(const MPSCQueue &) = delete;
+
+    void push(T value) {
+        Node *node = new Node(std::move(value));
+        Node *prev = mHead.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    bool pop(T &value) {
+        Node *next = mTail->next.load(std::memory_order_acquire);
+        if (!next) {
+            return false;
+        }
+
+        // next becomes the stub; its value is no longer needed
+        value = std::move(next->value);
+        delete mTail;
+        mTail = next;
+        return true;
+    }
+
+    /**
+     *  Checks for items; only meaningful on the consumer thread.
+     */
+    bool empty() const {
+        return mTail->next.load(std::memory_order_acquire) == nullptr;
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // __QUEUE_HPP__
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
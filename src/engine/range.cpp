@@ -0,0 +1,172 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "range.hpp"
+
+#include <iterator>
+#include <limits>
+
+////////////////////////////////////////////////////////////////////////////////
+
+const size_t RangeAllocator::None = std::numeric_limits<size_t>::max();
+
+RangeAllocator::RangeAllocator(
+    size_t capacity
+): mCapacity(0), mUsed(0), mFree(), mBySize(), mAllocated() {
+    grow(capacity);
+}
+
+size_t RangeAllocator::allocate(size_t size) {
+    if (size == 0) {
+        return None;
+    }
+
+    auto fit = mBySize.lower_bound(std::make_pair(size, size_t(0)));
+    if (fit == mBySize.end()) {
+        return None;
+    }
+
+    size_t available = fit->first;
+    size_t offset = fit->second;
+    eraseFree(mFree.find(offset));
+
+    if (available > size) {
+        insertFree(offset + size, available - size);
+    }
+
+    mAllocated[offset] = size;
+    mUsed += size;
+    return offset;
+}
+
+bool RangeAllocator::free(size_t offset) {
+    auto allocated = mAllocated.find(offset);
+    if (allocated == mAllocated.end()) {
+        return false;
+    }
+
+    size_t size = allocated->second;
+    mAllocated.erase(allocated);
+    mUsed -= size;
+
+    // merge with the free ranges either side
+    auto next = mFree.lower_bound(offset);
+    if (next != mFree.end() && next->first == offset + size) {
+        size += next->second;
+        eraseFree(next);
+    }
+
+    auto previous = mFree.lower_bound(offset);
+    if (previous != mFree.begin()) {
+        --previous;
+        if (previous->first + previous->second == offset) {
+            offset = previous->first;
+            size += previous->second;
+            eraseFree(previous);
+        }
+    }
+
+    insertFree(offset, size);
+    return true;
+}
+
+size_t RangeAllocator::getSize(size_t offset) const {
+    auto allocated = mAllocated.find(offset);
+    return allocated == mAllocated.end() ? 0 : allocated->second;
+}
+
+void RangeAllocator::grow(size_t capacity) {
+    if (capacity <= mCapacity) {
+        return;
+    }
+
+    size_t offset = mCapacity;
+    size_t size = capacity - mCapacity;
+    mCapacity = capacity;
+
+    // the new space joins a free range at the old end
+    if (!mFree.empty()) {
+        auto last = std::prev(mFree.end());
+        if (last->first + last->second == offset) {
+            offset = last->first;
+            size += last->second;
+            eraseFree(last);
+        }
+    }
+
+    insertFree(offset, size);
+}
+
+std::vector<RangeAllocator::Move> RangeAllocator::compact() {
+    std::vector<Move> moves;
+    std::map<size_t, size_t> allocated;
+    size_t end = 0;
+
+    for (const auto &range : mAllocated) {
+        if (range.first != end) {
+            moves.push_back(Move { range.first, end, range.second });
+        }
+        allocated[end] = range.second;
+        end += range.second;
+    }
+
+    mAllocated.swap(allocated);
+    mFree.clear();
+    mBySize.clear();
+
+    if (end < mCapacity) {
+        insertFree(end, mCapacity - end);
+    }
+
+    return moves;
+}
+
+void RangeAllocator::clear() {
+    mUsed = 0;
+    mAllocated.clear();
+    mFree.clear();
+    mBySize.clear();
+
+    if (mCapacity > 0) {
+        insertFree(0, mCapacity);
+    }
+}
+
+size_t RangeAllocator::getCapacity() const {
+    return mCapacity;
+}
+
+size_t RangeAllocator::getUsed() const {
+    return mUsed;
+}
+
+size_t RangeAllocator::getFree() const {
+    return mCapacity - mUsed;
+}
+
+size_t RangeAllocator::getLargestFree() const {
+    return mBySize.empty() ? 0 : mBySize.rbegin()->first;
+}
+
+size_t RangeAllocator::getFreeCount() const {
+    return mFree.size();
+}
+
+size_t RangeAllocator::getAllocatedCount() const {
+    return mAllocated.size();
+}
+
+void RangeAllocator::insertFree(size_t offset, size_t size) {
+    mFree[offset] = size;
+    mBySize.insert(std::make_pair(size, offset));
+}
+
+void RangeAllocator::eraseFree(std::map<size_t, size_t>::iterator free) {
+    mBySize.erase(std::make_pair(free->second, free->first));
+    mFree.erase(free);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,94 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __RANGE_HPP__
+#define __RANGE_HPP__ 1
+
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstddef>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ *  Hands out ranges of a fixed span (of bytes, vertices, whatever unit the
+ *  owner likes) from a free list, in any order.
+ *
+ *  Allocation takes the smallest free range that fits, and freed ranges
+ *  merge with their free neighbours.  When the free space is there but in
+ *  pieces, compact() slides every range down to the start, and returns the
+ *  moves for the owner to copy the data along.
+ */
+class RangeAllocator {
+    size_t mCapacity;
+    size_t mUsed;
+
+    std::map<size_t, size_t> mFree;                 //!< Offset to size
+    std::set<std::pair<size_t, size_t>> mBySize;    //!< Size and offset
+    std::map<size_t, size_t> mAllocated;            //!< Offset to size
+
+public:
+    struct Move {
+        size_t from;
+        size_t to;
+        size_t size;
+    };
+
+    static const size_t None;
+
+    explicit RangeAllocator(size_t capacity = 0);
+
+    /**
+     *  Allocates size units, returning their offset, or None if no free
+     *  range is large enough.
+     */
+    size_t allocate(size_t size);
+
+    /**
+     *  Frees the range allocated at offset; false if there is none.
+     */
+    bool free(size_t offset);
+
+    /**
+     *  Gets the size of the range allocated at offset, or 0.
+     */
+    size_t getSize(size_t offset) const;
+
+    /**
+     *  Adds capacity at the end; it cannot shrink.
+     */
+    void grow(size_t capacity);
+
+    /**
+     *  Moves every range down, in order, so the free space is one range at
+     *  the end.  Returns the ranges that moved, lowest first; copying them
+     *  in that order never overwrites a range still to be copied.
+     */
+    std::vector<Move> compact();
+
+    void clear();
+
+    size_t getCapacity() const;
+    size_t getUsed() const;
+    size_t getFree() const;
+    size_t getLargestFree() const;
+    size_t getFreeCount() const;
+    size_t getAllocatedCount() const;
+
+private:
+    void insertFree(size_t offset, size_t size);
+    void eraseFree(std::map<size_t, size_t>::iterator free);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // __RANGE_HPP__
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
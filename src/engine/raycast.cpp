@@ -0,0 +1,275 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "raycast.hpp"
+
+#include <cmath>
+#include <cstdlib>
+
+////////////////////////////////////////////////////////////////////////////////
+
+static const Coord BlockSize = Coord(1) << FixedPointBits;
+static const Coord ChunkSize = BlockSize << ChunkBits;
+
+/**
+ *  Longest ray searched, and largest direction component used; together
+ *  they keep every product in the traversal within 64 bits.
+ */
+static const Coord MaxLength = Coord(1) << 32;
+static const Coord MaxDirection = Coord(1) << 20;
+
+static Coord floorDiv(Coord a, Coord b) {
+    Coord q = a / b;
+    if (a % b != 0 && a < 0) {
+        q -= 1;
+    }
+    return q;
+}
+
+static Coord isqrt(uint64_t n) {
+    // correct the floating point estimate so the result is exact
+    uint64_t r = std::sqrt(double(n));
+    while (r > 0 && r * r > n) {
+        r -= 1;
+    }
+    while ((r + 1) * (r + 1) <= n) {
+        r += 1;
+    }
+    return r;
+}
+
+/**
+ *  Shortens a direction until its components fit in MaxDirection; returns
+ *  the number of halvings.
+ */
+static unsigned int reduce(Position &d) {
+    unsigned int shift = 0;
+    while (std::abs(d.x) > MaxDirection || std::abs(d.y) > MaxDirection || std::abs(d.z) > MaxDirection) {
+        d.x /= 2;
+        d.y /= 2;
+        d.z /= 2;
+        shift += 1;
+    }
+    return shift;
+}
+
+static Coord length(const Position &d) {
+    return isqrt(uint64_t(d.x * d.x) + uint64_t(d.y * d.y) + uint64_t(d.z * d.z));
+}
+
+static Coord &component(Position &p, int axis) {
+    return axis == 0 ? p.x : axis == 1 ? p.y : p.z;
+}
+
+static Coord component(const Position &p, int axis) {
+    return axis == 0 ? p.x : axis == 1 ? p.y : p.z;
+}
+
+/**
+ *  Face entered when stepping along an axis, by axis and direction.
+ */
+static const BlockFace EnteredFaces[3][2] = {
+    {BlockFace::East,  BlockFace::West},
+    {BlockFace::Top,   BlockFace::Bottom},
+    {BlockFace::South, BlockFace::North},
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+Raycaster::Raycaster(
+    ChunkCache &world,
+    Block::Attributes passThrough,
+    bool skipChunks
+): mWorld(world), mPassThrough(passThrough), mSkipChunks(skipChunks),
+   mEmptyChunks(), mEmptyPosition(), mEmpty(false), mEmptyValid(false),
+   mChunkPosition(), mChunk(nullptr), mPassTypes() {
+}
+
+bool Raycaster::cast(const Ray &ray, RayHit &hit) {
+    // other users of the world may have unloaded the chunk kept from the
+    // last ray
+    mChunk = nullptr;
+
+    const Position &o = ray.origin;
+    Position d = ray.direction;
+    reduce(d);
+
+    Coord len = length(d);
+    Coord limit = std::min(ray.length, MaxLength);
+    Coord den[3] = {std::abs(d.x), std::abs(d.y), std::abs(d.z)};
+
+    Position block = toBlockPosition(o);
+
+    if (!passes(block)) {
+        hit.block = block;
+        hit.type = getChunk(toChunkPosition(block))->getData()->getType(block);
+        hit.face = BlockFace::None;
+        hit.distance = 0;
+        return true;
+    }
+
+    if (len == 0) {
+        return false;
+    }
+
+    for (;;) {
+        // the boundary crossed next is the one at the smallest fraction of
+        // the direction, num / den; fractions are compared cross-multiplied
+        int axis = -1;
+        Coord num = 0;
+        bool skip = mSkipChunks && isEmpty(toChunkPosition(block));
+
+        for (int a = 0; a < 3; a++) {
+            if (den[a] == 0) {
+                continue;
+            }
+
+            Coord b = component(block, a);
+            Coord n;
+
+            if (skip) {
+                Coord c = b >> ChunkBits;
+                n = component(d, a) > 0 ? (c + 1) * ChunkSize - component(o, a) :
+                                          component(o, a) - c * ChunkSize;
+            } else {
+                n = component(d, a) > 0 ? (b + 1) * BlockSize - component(o, a) :
+                                          component(o, a) - b * BlockSize;
+            }
+
+            if (axis < 0 || n * den[axis] < num * den[a]) {
+                axis = a;
+                num = n;
+            }
+        }
+
+        if (num * len > limit * den[axis]) {
+            return false;
+        }
+
+        bool positive = component(d, axis) > 0;
+
+        if (skip) {
+            // leave the chunk: step off its far face and find the block
+            // reached on the other axes
+            Coord c = component(block, axis) >> ChunkBits;
+            for (int a = 0; a < 3; a++) {
+                if (a != axis && den[a] != 0) {
+                    Coord p = component(o, a) + floorDiv(component(d, a) * num, den[axis]);
+                    component(block, a) = p >> FixedPointBits;
+                }
+            }
+            component(block, axis) = positive ? (c + 1) << ChunkBits : (c << ChunkBits) - 1;
+        } else {
+            component(block, axis) += positive ? 1 : -1;
+        }
+
+        if (!passes(block)) {
+            hit.block = block;
+            hit.type = getChunk(toChunkPosition(block))->getData()->getType(block);
+            hit.face = EnteredFaces[axis][positive];
+            hit.distance = num * len / den[axis];
+            return true;
+        }
+    }
+}
+
+void Raycaster::cast(
+    const std::vector<Ray> &rays,
+    std::vector<RayHit> &hits,
+    std::vector<uint8_t> &found
+) {
+    hits.resize(rays.size());
+    found.resize(rays.size());
+
+    for (size_t i = 0; i < rays.size(); i++) {
+        found[i] = cast(rays[i], hits[i]);
+    }
+}
+
+bool Raycaster::isVisible(const Position &from, const Position &to) {
+    Ray ray;
+    ray.origin = from;
+    ray.direction = to - from;
+
+    Position d = ray.direction;
+    unsigned int shift = reduce(d);
+    ray.length = length(d) << shift;
+
+    RayHit hit;
+    return !cast(ray, hit);
+}
+
+void Raycaster::clear() {
+    mEmptyChunks.clear();
+    mEmptyValid = false;
+    mChunk = nullptr;
+    mPassTypes.clear();
+}
+
+const Chunk *Raycaster::getChunk(const Position &chunkPosition) {
+    if (!mChunk || chunkPosition != mChunkPosition) {
+        mChunk = mWorld.getChunk(chunkPosition);
+        mChunkPosition = chunkPosition;
+    }
+    return mChunk;
+}
+
+bool Raycaster::isEmpty(const Position &chunkPosition) {
+    // rays take many steps in each chunk they cross
+    if (mEmptyValid && chunkPosition == mEmptyPosition) {
+        return mEmpty;
+    }
+
+    mEmptyPosition = chunkPosition;
+    mEmptyValid = true;
+
+    uint64_t key = toPositionKey(chunkPosition);
+    auto found = mEmptyChunks.find(key);
+    if (found != mEmptyChunks.end()) {
+        mEmpty = found->second;
+        return mEmpty;
+    }
+
+    const Chunk *chunk = getChunk(chunkPosition);
+    const ChunkData *data = chunk ? chunk->getData() : nullptr;
+    bool empty = true;
+
+    if (data) {
+        Position block;
+        for (block.z = 0; block.z < ChunkData::Count && empty; block.z++) {
+            for (block.y = 0; block.y < ChunkData::Count && empty; block.y++) {
+                for (block.x = 0; block.x < ChunkData::Count && empty; block.x++) {
+                    empty = passes(data->getType(block));
+                }
+            }
+        }
+    }
+
+    mEmptyChunks[key] = empty;
+    mEmpty = empty;
+    return empty;
+}
+
+bool Raycaster::passes(const Position &block) {
+    const Chunk *chunk = getChunk(toChunkPosition(block));
+    if (!chunk || !chunk->getData()) {
+        return true;
+    }
+    return passes(chunk->getData()->getType(block));
+}
+
+bool Raycaster::passes(BlockType type) {
+    // block attributes are looked up once per type: 1 passes, 2 stops
+    if (type >= mPassTypes.size()) {
+        mPassTypes.resize(type + 1, 0);
+    }
+    if (!mPassTypes[type]) {
+        mPassTypes[type] = Block::hasAttribute(type, mPassThrough) ? 1 : 2;
+    }
+    return mPassTypes[type] == 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
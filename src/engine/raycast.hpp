@@ -0,0 +1,113 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __RAYCAST_HPP__
+#define __RAYCAST_HPP__ 1
+
+////////////////////////////////////////////////////////////////////////////////
+
+#include <unordered_map>
+#include <vector>
+
+#include "types.hpp"
+#include "world.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ *  Face of a block, named by the direction it faces.
+ */
+enum class BlockFace : uint8_t {
+    None,   //!< No face (the ray started inside the block)
+    West,   //!< -X
+    East,   //!< +X
+    Bottom, //!< -Y
+    Top,    //!< +Y
+    North,  //!< -Z
+    South   //!< +Z
+};
+
+struct Ray {
+    Position origin;    //!< Fixed-point start of the ray
+    Position direction; //!< Fixed-point direction, of any non-zero length
+    Coord length;       //!< Fixed-point distance to search
+};
+
+struct RayHit {
+    Position block;     //!< Block hit, in block coordinates
+    BlockType type;     //!< Type of the block hit
+    BlockFace face;     //!< Face the ray entered through
+    Coord distance;     //!< Fixed-point distance from the ray origin
+};
+
+/**
+ *  Casts rays through the block world (Amanatidis & Woo's grid traversal).
+ *
+ *  Traversal is exact: crossings of block boundaries are compared as
+ *  fractions in integer arithmetic, so the same ray hits the same block on
+ *  every machine.  Chunks found to hold only blocks rays pass through are
+ *  crossed in one step.  That finding is cached per chunk for the life of
+ *  the raycaster, so keep one per batch of rays (such as a tick's line of
+ *  sight checks) and make a new one, or call clear(), after blocks change.
+ */
+class Raycaster {
+    ChunkCache &mWorld;
+    Block::Attributes mPassThrough;
+    bool mSkipChunks;
+
+    std::unordered_map<uint64_t, bool> mEmptyChunks;
+    Position mEmptyPosition;
+    bool mEmpty;
+    bool mEmptyValid;
+
+    Position mChunkPosition;
+    const Chunk *mChunk;
+
+    std::vector<uint8_t> mPassTypes;
+
+public:
+    /**
+     *  Creates a raycaster stopping at blocks without the given attribute;
+     *  the default stops at solid blocks, while Transparent suits lines of
+     *  sight.  Chunk skipping can be turned off for comparison.
+     */
+    explicit Raycaster(
+        ChunkCache &world,
+        Block::Attributes passThrough = Block::Attributes::Passable,
+        bool skipChunks = true
+    );
+
+    /**
+     *  Finds the first block hit within the length of the ray.  A block
+     *  containing the origin is hit at distance zero, with no face.
+     */
+    bool cast(const Ray &ray, RayHit &hit);
+
+    /**
+     *  Casts many rays, sharing the chunk cache; hits[i] is only valid if
+     *  found[i] is set.
+     */
+    void cast(const std::vector<Ray> &rays, std::vector<RayHit> &hits, std::vector<uint8_t> &found);
+
+    /**
+     *  Checks that no block stops a ray between two points.
+     */
+    bool isVisible(const Position &from, const Position &to);
+
+    void clear();
+
+private:
+    const Chunk *getChunk(const Position &chunkPosition);
+    bool isEmpty(const Position &chunkPosition);
+    bool passes(const Position &block);
+    bool passes(BlockType type);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // __RAYCAST_HPP__
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,359 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "resource.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+#include <SFML/System/Err.hpp>
+
+////////////////////////////////////////////////////////////////////////////////
+
+ResourceHash hashResource(const uint8_t *data, size_t size) {
+    ResourceHash hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+ResourceHash hashResource(const std::vector<uint8_t> &data) {
+    return hashResource(data.data(), data.size());
+}
+
+static bool readFile(const std::string &path, std::vector<uint8_t> &data) {
+    FILE *file = std::fopen(path.c_str(), "rb");
+
+    if (!file) {
+        return false;
+    }
+
+    data.clear();
+
+    uint8_t buffer[4096];
+    size_t count;
+
+    while ((count = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data.insert(data.end(), buffer, buffer + count);
+    }
+
+    bool ok = !std::ferror(file);
+    std::fclose(file);
+    return ok;
+}
+
+static bool writeFile(const std::string &path, const std::vector<uint8_t> &data) {
+    // write to a temporary file first, so an interrupted write never leaves
+    // a truncated file under the final name
+    std::string temp = path + ".tmp";
+    FILE *file = std::fopen(temp.c_str(), "wb");
+
+    if (!file) {
+        return false;
+    }
+
+    bool ok = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+    ok = (std::fclose(file) == 0) && ok;
+
+    if (ok) {
+        std::remove(path.c_str());
+        ok = std::rename(temp.c_str(), path.c_str()) == 0;
+    }
+
+    if (!ok) {
+        std::remove(temp.c_str());
+    }
+
+    return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+const ResourceInfo &ResourceIndex::add(
+    ResourceID id,
+    ResourceType type,
+    const std::vector<uint8_t> &data
+) {
+    ResourceInfo &info = mResources[id];
+    info.id = id;
+    info.type = type;
+    info.hash = hashResource(data);
+    info.data = data;
+    return info;
+}
+
+const ResourceInfo *ResourceIndex::addFile(
+    ResourceID id,
+    ResourceType type,
+    const std::string &path
+) {
+    std::vector<uint8_t> data;
+
+    if (!readFile(path, data)) {
+        sf::err() << "Unable to read resource \"" << path << "\"\n";
+        return nullptr;
+    }
+
+    return &add(id, type, data);
+}
+
+void ResourceIndex::remove(ResourceID id) {
+    mResources.erase(id);
+}
+
+const ResourceInfo *ResourceIndex::find(ResourceID id) const {
+    auto found = mResources.find(id);
+    if (found != mResources.end()) {
+        return &found->second;
+    }
+    return nullptr;
+}
+
+bool ResourceIndex::isOutdated(ResourceID id, ResourceHash hash) const {
+    const ResourceInfo *info = find(id);
+    return info && info->hash != hash;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+ResourceSender::ResourceSender(
+    const ResourceIndex &index,
+    uint32_t fragmentSize
+): mIndex(&index), mFragmentSize(fragmentSize > 0 ? fragmentSize : DefaultFragmentSize) {
+}
+
+bool ResourceSender::check(ResourceID id, ResourceHash hash) {
+    if (!mIndex->isOutdated(id, hash)) {
+        return false;
+    }
+
+    const ResourceInfo *info = mIndex->find(id);
+
+    for (Transfer &transfer : mTransfers) {
+        if (transfer.id == id) {
+            // already being sent; no need to start over (nextFragment() does
+            // if the data changed)
+            return true;
+        }
+    }
+
+    Transfer transfer = { id, info->hash, 0 };
+    mTransfers.push_back(transfer);
+    return true;
+}
+
+bool ResourceSender::nextFragment(ResourceFragment &fragment) {
+    const ResourceInfo *info = nullptr;
+    Transfer transfer;
+
+    while (!info) {
+        if (mTransfers.empty()) {
+            return false;
+        }
+
+        transfer = mTransfers.front();
+        mTransfers.pop_front();
+
+        // removed since it was queued; the client keeps its old version
+        info = mIndex->find(transfer.id);
+    }
+
+    if (info->hash != transfer.hash) {
+        // replaced since it was queued; the fragments sent are useless now
+        transfer.hash = info->hash;
+        transfer.offset = 0;
+    }
+
+    uint32_t size = info->data.size();
+    uint32_t length = size - transfer.offset;
+
+    if (length > mFragmentSize) {
+        length = mFragmentSize;
+    }
+
+    fragment.id = info->id;
+    fragment.hash = info->hash;
+    fragment.type = info->type;
+    fragment.size = size;
+    fragment.offset = transfer.offset;
+    fragment.length = length;
+    fragment.data = info->data.data() + transfer.offset;
+
+    transfer.offset += length;
+
+    if (transfer.offset < size) {
+        // requeue behind the other transfers
+        mTransfers.push_back(transfer);
+    }
+
+    return true;
+}
+
+bool ResourceSender::isIdle() const {
+    return mTransfers.empty();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+ResourceStore::ResourceStore(
+    const std::string &path
+): mPath(path) {
+    loadIndex();
+}
+
+ResourceHash ResourceStore::getHash(ResourceID id) const {
+    auto found = mIndex.find(id);
+    if (found != mIndex.end() && contains(found->second)) {
+        return found->second;
+    }
+    return 0;
+}
+
+std::string ResourceStore::getPath(ResourceHash hash) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash));
+    return mPath + name;
+}
+
+bool ResourceStore::contains(ResourceHash hash) const {
+    FILE *file = std::fopen(getPath(hash).c_str(), "rb");
+    if (file) {
+        std::fclose(file);
+        return true;
+    }
+    return false;
+}
+
+bool ResourceStore::load(ResourceHash hash, std::vector<uint8_t> &data) const {
+    // verify, in case the file was damaged since it was stored
+    return readFile(getPath(hash), data) && hashResource(data) == hash;
+}
+
+bool ResourceStore::store(ResourceID id, const std::vector<uint8_t> &data) {
+    ResourceHash hash = hashResource(data);
+
+    if (!contains(hash) && !writeFile(getPath(hash), data)) {
+        sf::err() << "Unable to write resource \"" << getPath(hash) << "\"\n";
+        return false;
+    }
+
+    mIndex[id] = hash;
+    return saveIndex();
+}
+
+bool ResourceStore::loadIndex() {
+    mIndex.clear();
+
+    FILE *file = std::fopen((mPath + "index").c_str(), "r");
+
+    if (!file) {
+        return false;
+    }
+
+    unsigned long id;
+    unsigned long long hash;
+
+    while (std::fscanf(file, "%lu %llx", &id, &hash) == 2) {
+        mIndex[id] = hash;
+    }
+
+    std::fclose(file);
+    return true;
+}
+
+bool ResourceStore::saveIndex() const {
+    std::vector<uint8_t> data;
+    char line[64];
+
+    for (auto &item : mIndex) {
+        int length = std::snprintf(line, sizeof(line), "%lu %016llx\n",
+                                   static_cast<unsigned long>(item.first),
+                                   static_cast<unsigned long long>(item.second));
+        data.insert(data.end(), line, line + length);
+    }
+
+    return writeFile(mPath + "index", data);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+ResourceReceiver::ResourceReceiver(
+    ResourceStore &store
+): mStore(&store), mTransfers(), mBytesReceived() {
+}
+
+void ResourceReceiver::begin(
+    ResourceID id,
+    ResourceHash hash,
+    ResourceType type,
+    uint32_t size
+) {
+    Transfer &transfer = mTransfers[id];
+    transfer.hash = hash;
+    transfer.type = type;
+    transfer.data.assign(size, 0);
+    transfer.received = 0;
+}
+
+bool ResourceReceiver::receive(
+    ResourceID id,
+    uint32_t offset,
+    const uint8_t *data,
+    uint32_t length
+) {
+    auto found = mTransfers.find(id);
+
+    if (found == mTransfers.end()) {
+        sf::err() << "Unexpected data for resource " << id << "\n";
+        return false;
+    }
+
+    Transfer &transfer = found->second;
+
+    if (offset != transfer.received || length > transfer.data.size() - offset) {
+        sf::err() << "Out of sequence data for resource " << id << "\n";
+        mTransfers.erase(found);
+        return false;
+    }
+
+    std::memcpy(transfer.data.data() + offset, data, length);
+    transfer.received += length;
+    mBytesReceived += length;
+
+    if (transfer.received < transfer.data.size()) {
+        return false;
+    }
+
+    bool ok = hashResource(transfer.data) == transfer.hash;
+
+    if (!ok) {
+        sf::err() << "Hash mismatch for resource " << id << "\n";
+    } else {
+        ok = mStore->store(id, transfer.data);
+    }
+
+    mTransfers.erase(found);
+    return ok;
+}
+
+bool ResourceReceiver::receive(const ResourceFragment &fragment) {
+    if (fragment.offset == 0) {
+        begin(fragment.id, fragment.hash, fragment.type, fragment.size);
+    }
+    return receive(fragment.id, fragment.offset, fragment.data, fragment.length);
+}
+
+bool ResourceReceiver::isIdle() const {
+    return mTransfers.empty();
+}
+
+uint64_t ResourceReceiver::getBytesReceived() const {
+    return mBytesReceived;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
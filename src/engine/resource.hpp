@@ -0,0 +1,209 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __RESOURCE_HPP__
+#define __RESOURCE_HPP__ 1
+
+////////////////////////////////////////////////////////////////////////////////
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "types.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+typedef uint32_t ResourceID;
+typedef uint16_t ResourceType;
+typedef uint64_t ResourceHash;
+
+/**
+ *  Hashes resource data (64-bit FNV-1a).  A hash of zero is reserved to mean
+ *  "no resource".
+ */
+ResourceHash hashResource(const uint8_t *data, size_t size);
+ResourceHash hashResource(const std::vector<uint8_t> &data);
+
+struct ResourceInfo {
+    ResourceID id;
+    ResourceType type;
+    ResourceHash hash;
+    std::vector<uint8_t> data;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ *  Server-side index of the resources offered to clients.
+ */
+class ResourceIndex {
+    std::map<ResourceID, ResourceInfo> mResources;
+
+public:
+    const ResourceInfo &add(ResourceID id, ResourceType type, const std::vector<uint8_t> &data);
+    const ResourceInfo *addFile(ResourceID id, ResourceType type, const std::string &path);
+
+    void remove(ResourceID id);
+
+    const ResourceInfo *find(ResourceID id) const;
+
+    /**
+     *  Handles CheckResource; returns true if the client's version (given by
+     *  its hash) is missing or outdated.
+     */
+    bool isOutdated(ResourceID id, ResourceHash hash) const;
+};
+
+/**
+ *  Part of a resource being streamed to a client.
+ *
+ *  The first fragment of each transfer (offset 0) should be preceded by a
+ *  LoadResource packet built from id, hash, type and size; each fragment is
+ *  then sent as a ResourceData packet.
+ */
+struct ResourceFragment {
+    ResourceID id;
+    ResourceHash hash;
+    ResourceType type;
+    uint32_t size;          //!< size of the whole resource
+    uint32_t offset;        //!< offset of this fragment
+    uint32_t length;        //!< length of this fragment
+    const uint8_t *data;
+};
+
+/**
+ *  Streams resources to one client in fixed-size fragments.
+ *
+ *  Transfers are served round-robin, one fragment at a time, so a large
+ *  texture never blocks smaller resources (or, if the caller limits the
+ *  fragments sent per tick, any other traffic) on the connection.
+ *
+ *  Each transfer looks its resource up in the index for every fragment, so
+ *  the index may change while transfers are pending: a transfer of a
+ *  removed resource is dropped, and one of a resource added again with new
+ *  data starts over from offset 0.
+ */
+class ResourceSender {
+    struct Transfer {
+        ResourceID id;
+        ResourceHash hash;
+        uint32_t offset;
+    };
+
+    const ResourceIndex *mIndex;
+    uint32_t mFragmentSize;
+    std::deque<Transfer> mTransfers;
+
+public:
+    static const uint32_t DefaultFragmentSize = 4096;
+
+    explicit ResourceSender(const ResourceIndex &index, uint32_t fragmentSize = DefaultFragmentSize);
+
+    /**
+     *  Handles CheckResource; queues a transfer if the client's version is
+     *  outdated.  Returns true if a transfer was queued.
+     */
+    bool check(ResourceID id, ResourceHash hash);
+
+    /**
+     *  Gets the next fragment to send; returns false if nothing is pending.
+     *
+     *  The fragment data points into the index and stays valid until the
+     *  resource is next added or removed.
+     */
+    bool nextFragment(ResourceFragment &fragment);
+
+    bool isIdle() const;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ *  Client-side persistent, content-addressed resource cache.
+ *
+ *  Each resource is kept in a file named after its hash, so identical data is
+ *  only stored (and downloaded) once; an index file maps the server's
+ *  resource ids to the hashes last received for them.  The path is used as a
+ *  prefix for all file names (for a directory, include the trailing
+ *  separator; the directory must exist).  Use one store per server, since
+ *  resource ids are only meaningful to the server that assigned them.
+ *
+ *  Cached files can be given to the client resource caches directly, e.g.
+ *  gTextureCache.acquire(store.getPath(hash)).
+ */
+class ResourceStore {
+    std::string mPath;
+    std::map<ResourceID, ResourceHash> mIndex;
+
+public:
+    explicit ResourceStore(const std::string &path);
+
+    /**
+     *  Gets the hash of the cached version of a resource, or 0 if none; this
+     *  is the hash to send in CheckResource.
+     */
+    ResourceHash getHash(ResourceID id) const;
+
+    std::string getPath(ResourceHash hash) const;
+
+    bool contains(ResourceHash hash) const;
+    bool load(ResourceHash hash, std::vector<uint8_t> &data) const;
+
+    /**
+     *  Saves resource data and records it as the current version of the
+     *  given resource.
+     */
+    bool store(ResourceID id, const std::vector<uint8_t> &data);
+
+    bool loadIndex();
+    bool saveIndex() const;
+};
+
+/**
+ *  Reassembles resources streamed by a ResourceSender into a ResourceStore.
+ */
+class ResourceReceiver {
+    struct Transfer {
+        ResourceHash hash;
+        ResourceType type;
+        std::vector<uint8_t> data;
+        uint32_t received;
+    };
+
+    ResourceStore *mStore;
+    std::map<ResourceID, Transfer> mTransfers;
+    uint64_t mBytesReceived;
+
+public:
+    explicit ResourceReceiver(ResourceStore &store);
+
+    /**
+     *  Handles LoadResource.
+     */
+    void begin(ResourceID id, ResourceHash hash, ResourceType type, uint32_t size);
+
+    /**
+     *  Handles ResourceData; returns true when the resource is complete, has
+     *  been verified against its hash and saved to the store.
+     */
+    bool receive(ResourceID id, uint32_t offset, const uint8_t *data, uint32_t length);
+
+    /**
+     *  Handles a whole fragment, as LoadResource (if first) and ResourceData.
+     */
+    bool receive(const ResourceFragment &fragment);
+
+    bool isIdle() const;
+    uint64_t getBytesReceived() const;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // __RESOURCE_HPP__
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,102 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "ring.hpp"
+
+#include <limits>
+
+////////////////////////////////////////////////////////////////////////////////
+
+const size_t RingAllocator::None = std::numeric_limits<size_t>::max();
+
+RingAllocator::RingAllocator(
+    size_t capacity
+): mCapacity(capacity), mHead(0), mTail(0), mUsed(0), mBatches(),
+   mOpenBytes(0), mNextBatch(1) {
+}
+
+size_t RingAllocator::allocate(size_t size, size_t alignment) {
+    if (size == 0 || size > mCapacity) {
+        return None;
+    }
+
+    if (alignment == 0) {
+        alignment = 1;
+    }
+
+    if (mUsed == 0 && mBatches.empty()) {
+        // nothing in use; start again from the beginning
+        mHead = mTail = 0;
+    } else if (mHead == mTail && mUsed > 0) {
+        return None;
+    }
+
+    size_t start = (mHead + alignment - 1) / alignment * alignment;
+    size_t skipped = start - mHead;
+
+    if (mHead >= mTail) {
+        // free space runs from the head to the end, then from 0 to the tail
+        if (start + size > mCapacity) {
+            if (size > mTail) {
+                return None;
+            }
+            skipped = mCapacity - mHead;
+            start = 0;
+        }
+    } else if (start + size > mTail) {
+        return None;
+    }
+
+    size_t bytes = skipped + size;
+    mHead = start + size;
+    mUsed += bytes;
+    mOpenBytes += bytes;
+    return start;
+}
+
+uint64_t RingAllocator::close() {
+    Batch batch = { mNextBatch++, mHead, mOpenBytes };
+    mBatches.push_back(batch);
+    mOpenBytes = 0;
+    return batch.id;
+}
+
+bool RingAllocator::reclaim() {
+    if (mBatches.empty()) {
+        return false;
+    }
+
+    const Batch &batch = mBatches.front();
+    mTail = batch.end;
+    mUsed -= batch.bytes;
+    mBatches.pop_front();
+    return true;
+}
+
+void RingAllocator::clear() {
+    mHead = mTail = 0;
+    mUsed = 0;
+    mBatches.clear();
+    mOpenBytes = 0;
+}
+
+size_t RingAllocator::getCapacity() const {
+    return mCapacity;
+}
+
+size_t RingAllocator::getUsed() const {
+    return mUsed;
+}
+
+size_t RingAllocator::getOpenBytes() const {
+    return mOpenBytes;
+}
+
+size_t RingAllocator::getClosedCount() const {
+    return mBatches.size();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,81 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __RING_HPP__
+#define __RING_HPP__ 1
+
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ *  Hands out ranges of a ring buffer in order, and takes them back in
+ *  batches.
+ *
+ *  Ranges allocated since the last close() form the open batch.  close()
+ *  ends it, and the owner marks the point (with a GL fence, say); once the
+ *  consumer is past that point, reclaim() frees the oldest closed batch.
+ *  A range never wraps around the end of the ring: if it does not fit
+ *  before the end, the rest of the ring is skipped and counted as used by
+ *  the batch.
+ */
+class RingAllocator {
+    struct Batch {
+        uint64_t id;
+        size_t end;     //!< Where the head was when the batch closed
+        size_t bytes;   //!< Bytes used, counting skipped and padding bytes
+    };
+
+    size_t mCapacity;
+    size_t mHead;       //!< Next free byte
+    size_t mTail;       //!< First byte still in use
+    size_t mUsed;
+
+    std::deque<Batch> mBatches;
+    size_t mOpenBytes;
+    uint64_t mNextBatch;
+
+public:
+    static const size_t None;
+
+    explicit RingAllocator(size_t capacity);
+
+    /**
+     *  Allocates size bytes at a multiple of alignment, returning their
+     *  offset, or None if there is no room until batches are reclaimed.
+     */
+    size_t allocate(size_t size, size_t alignment = 1);
+
+    /**
+     *  Ends the open batch, returning its id.
+     */
+    uint64_t close();
+
+    /**
+     *  Frees the oldest closed batch; false if there is none.
+     */
+    bool reclaim();
+
+    /**
+     *  Frees everything, closed batches and open.
+     */
+    void clear();
+
+    size_t getCapacity() const;
+    size_t getUsed() const;
+    size_t getOpenBytes() const;
+    size_t getClosedCount() const;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // __RING_HPP__
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
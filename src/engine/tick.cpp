@@ -0,0 +1,218 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "tick.hpp"
+
+#include <algorithm>
+
+#include <SFML/System/Clock.hpp>
+
+////////////////////////////////////////////////////////////////////////////////
+
+EntityCommand::EntityCommand(
+    Type type,
+    EntityID id
+): type(type), id(id), position(), from(), velocity(), orientation(Angle::Zero, Angle::Zero), bounds() {
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+CommandBuffer::CommandBuffer(
+): mCommands() {
+}
+
+void CommandBuffer::spawn(
+    const Position &position,
+    const Velocity &velocity,
+    const Orientation &orientation,
+    const BoundingVolume &bounds
+) {
+    mCommands.push_back(EntityCommand(EntityCommand::Spawn, 0));
+
+    EntityCommand &command = mCommands.back();
+    command.position = position;
+    command.velocity = velocity;
+    command.orientation = orientation;
+    command.bounds = bounds;
+}
+
+void CommandBuffer::despawn(EntityID id) {
+    mCommands.push_back(EntityCommand(EntityCommand::Despawn, id));
+}
+
+void CommandBuffer::migrate(EntityID id, const Position &from, const Position &to) {
+    mCommands.push_back(EntityCommand(EntityCommand::Migrate, id));
+    mCommands.back().from = from;
+    mCommands.back().position = to;
+}
+
+void CommandBuffer::clear() {
+    mCommands.clear();
+}
+
+bool CommandBuffer::empty() const {
+    return mCommands.empty();
+}
+
+const std::vector<EntityCommand> &CommandBuffer::getCommands() const {
+    return mCommands;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+const size_t TickPipeline::BatchSize;
+
+TickPipeline::TickPipeline(
+    JobPool &jobs
+): mJobs(jobs), mIDs(), mRegistry(), mIndex(), mSystems(), mBuffers(), mTick(), mPhaseTimes(), mTickTime() {
+}
+
+void TickPipeline::addSystem(const System &system) {
+    mSystems.push_back(system);
+}
+
+EntityID TickPipeline::spawn(
+    const Position &position,
+    const Velocity &velocity,
+    const Orientation &orientation,
+    const BoundingVolume &bounds
+) {
+    EntityID id = mIDs.allocate();
+    mRegistry.insert(Entity(id, position, velocity, orientation), bounds);
+    mIndex.insert(id, position);
+    return id;
+}
+
+bool TickPipeline::despawn(EntityID id) {
+    size_t index = mRegistry.find(id);
+    if (index == EntityRegistry::Null) {
+        return false;
+    }
+
+    mIndex.remove(id, mRegistry.getPositions()[index]);
+    mRegistry.erase(id);
+    mIDs.release(id);
+    return true;
+}
+
+void TickPipeline::tick() {
+    sf::Clock clock;
+    sf::Time start = clock.getElapsedTime();
+
+    size_t batches = getBatchCount();
+    if (mBuffers.size() < batches) {
+        mBuffers.resize(batches);
+    }
+
+    if (!mSystems.empty()) {
+        mJobs.run(batches, [&](size_t batch) {
+            size_t begin = batch * BatchSize;
+            size_t end = std::min(begin + BatchSize, mRegistry.size());
+            for (const System &system : mSystems) {
+                system(mRegistry, begin, end, mBuffers[batch]);
+            }
+        });
+    }
+
+    sf::Time systems = clock.getElapsedTime();
+
+    mJobs.run(batches, [&](size_t batch) {
+        size_t begin = batch * BatchSize;
+        move(begin, std::min(begin + BatchSize, mRegistry.size()), mBuffers[batch]);
+    });
+
+    sf::Time motion = clock.getElapsedTime();
+
+    apply();
+
+    sf::Time end = clock.getElapsedTime();
+
+    mPhaseTimes[Systems] = systems - start;
+    mPhaseTimes[Motion] = motion - systems;
+    mPhaseTimes[Apply] = end - motion;
+    mTickTime = end - start;
+    mTick += 1;
+}
+
+uint64_t TickPipeline::getTick() const {
+    return mTick;
+}
+
+const EntityRegistry &TickPipeline::getRegistry() const {
+    return mRegistry;
+}
+
+const EntityIndex &TickPipeline::getIndex() const {
+    return mIndex;
+}
+
+sf::Time TickPipeline::getPhaseTime(Phase phase) const {
+    return mPhaseTimes[phase];
+}
+
+sf::Time TickPipeline::getTickTime() const {
+    return mTickTime;
+}
+
+const char *TickPipeline::getPhaseName(Phase phase) {
+    static const char *Names[PhaseCount] = {
+        "systems",
+        "motion",
+        "apply"
+    };
+    return phase < PhaseCount ? Names[phase] : "unknown";
+}
+
+size_t TickPipeline::getBatchCount() const {
+    return (mRegistry.size() + BatchSize - 1) / BatchSize;
+}
+
+void TickPipeline::move(size_t begin, size_t end, CommandBuffer &buffer) {
+    const EntityID *ids = mRegistry.getIDs().data();
+    Position *position = mRegistry.getPositions().data();
+    const Velocity *velocity = mRegistry.getVelocities().data();
+
+    for (size_t i = begin; i < end; i++) {
+        Position from = position[i];
+        position[i].x += velocity[i].x;
+        position[i].y += velocity[i].y;
+        position[i].z += velocity[i].z;
+
+        if (EntityIndex::getChunk(from) != EntityIndex::getChunk(position[i])) {
+            buffer.migrate(ids[i], from, position[i]);
+        }
+    }
+}
+
+void TickPipeline::apply() {
+    // migrations first, so a despawn finds the entity in its current chunk
+    for (const CommandBuffer &buffer : mBuffers) {
+        for (const EntityCommand &command : buffer.getCommands()) {
+            if (command.type == EntityCommand::Migrate) {
+                mIndex.move(command.id, command.from, command.position);
+            }
+        }
+    }
+
+    for (const CommandBuffer &buffer : mBuffers) {
+        for (const EntityCommand &command : buffer.getCommands()) {
+            if (command.type == EntityCommand::Despawn) {
+                despawn(command.id);
+            }
+        }
+    }
+
+    for (CommandBuffer &buffer : mBuffers) {
+        for (const EntityCommand &command : buffer.getCommands()) {
+            if (command.type == EntityCommand::Spawn) {
+                spawn(command.position, command.velocity, command.orientation, command.bounds);
+            }
+        }
+        buffer.clear();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,177 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __TICK_HPP__
+#define __TICK_HPP__ 1
+
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include <SFML/System/Time.hpp>
+
+#include "entity.hpp"
+#include "jobs.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ *  A change to the set of entities, or to the chunk an entity is indexed
+ *  in, recorded during the parallel part of a tick and applied after it.
+ */
+struct EntityCommand {
+    enum Type : uint8_t {
+        Spawn,
+        Despawn,
+        Migrate
+    };
+
+    Type type;
+    EntityID id;                //!< Despawn and Migrate only
+    Position position;          //!< Spawn position, or Migrate destination
+    Position from;              //!< Migrate only
+    Velocity velocity;          //!< Spawn only
+    Orientation orientation;    //!< Spawn only
+    BoundingVolume bounds;      //!< Spawn only
+
+    EntityCommand(Type type, EntityID id);
+};
+
+/**
+ *  Commands recorded by one batch of entities.  Each batch has its own
+ *  buffer, so recording needs no locking.
+ */
+class CommandBuffer {
+    std::vector<EntityCommand> mCommands;
+
+public:
+    CommandBuffer();
+
+    /**
+     *  Spawns an entity; it is given an id when the command is applied.
+     */
+    void spawn(
+        const Position &position,
+        const Velocity &velocity,
+        const Orientation &orientation,
+        const BoundingVolume &bounds = BoundingVolume()
+    );
+
+    void despawn(EntityID id);
+    void migrate(EntityID id, const Position &from, const Position &to);
+
+    void clear();
+    bool empty() const;
+
+    const std::vector<EntityCommand> &getCommands() const;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ *  Runs the entity part of a server tick.
+ *
+ *  A tick first runs every system and then moves every entity, over
+ *  batches of entities in parallel on a JobPool.  Systems may read and
+ *  change the components of the entities of their own batch only; beyond
+ *  that they may only read what does not change during the phase, such as
+ *  the entity index (changed only while applying) or state the caller
+ *  holds fixed for the tick.  Another batch's components are being written
+ *  by that batch's systems, so a system that needs its neighbours' state
+ *  must read it from a copy taken before the tick.  Systems must record
+ *  spawns and despawns into the batch's command buffer rather than change
+ *  the registry; moving an entity into another chunk records a migration
+ *  rather than changing the index.  Buffers are then applied in batch order
+ *  (migrations, then despawns, then spawns), so the result does not depend
+ *  on the number of threads.
+ */
+class TickPipeline {
+public:
+    enum Phase {
+        Systems,    //!< Running systems over batches, in parallel
+        Motion,     //!< Moving entities over batches, in parallel
+        Apply,      //!< Applying command buffers
+        PhaseCount
+    };
+
+    /**
+     *  Runs over entities [begin, end) of the registry.
+     */
+    typedef std::function<void(EntityRegistry &, size_t begin, size_t end, CommandBuffer &)> System;
+
+    static const size_t BatchSize = 1024;
+
+private:
+    JobPool &mJobs;
+
+    EntityIDAllocator mIDs;
+    EntityRegistry mRegistry;
+    EntityIndex mIndex;
+
+    std::vector<System> mSystems;
+    std::vector<CommandBuffer> mBuffers;
+
+    uint64_t mTick;
+    sf::Time mPhaseTimes[PhaseCount];
+    sf::Time mTickTime;
+
+public:
+    explicit TickPipeline(JobPool &jobs);
+
+    TickPipeline(const TickPipeline &) = delete;
+    TickPipeline &operator=(const TickPipeline &) = delete;
+
+    void addSystem(const System &system);
+
+    /**
+     *  Spawns an entity at once, outside a tick.
+     */
+    EntityID spawn(
+        const Position &position,
+        const Velocity &velocity,
+        const Orientation &orientation,
+        const BoundingVolume &bounds = BoundingVolume()
+    );
+
+    /**
+     *  Despawns an entity at once, outside a tick; returns false if the
+     *  id is stale.
+     */
+    bool despawn(EntityID id);
+
+    void tick();
+
+    uint64_t getTick() const;
+
+    const EntityRegistry &getRegistry() const;
+    const EntityIndex &getIndex() const;
+
+    /**
+     *  Gets how long a phase of the last tick took.
+     */
+    sf::Time getPhaseTime(Phase phase) const;
+
+    /**
+     *  Gets how long the whole of the last tick took.
+     */
+    sf::Time getTickTime() const;
+
+    static const char *getPhaseName(Phase phase);
+
+private:
+    size_t getBatchCount() const;
+
+    void move(size_t begin, size_t end, CommandBuffer &buffer);
+    void apply();
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // __TICK_HPP__
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
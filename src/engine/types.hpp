@@ -101,6 +101,39 @@ typedef sf::Vector3<LargeDelta> Force;
 static const unsigned int FixedPointBits = 8;
 static const float FixedPointScale = static_cast<float>(1 << FixedPointBits);
 
+static const unsigned int ChunkBits = 4;
+
+/**
+ *  Converts entity (fixed-point) coordinates to the containing block.
+ */
+inline Position toBlockPosition(const Position &position) {
+    // arithmetic shift rounds toward negative infinity
+    return Position(
+        position.x >> FixedPointBits,
+        position.y >> FixedPointBits,
+        position.z >> FixedPointBits
+    );
+}
+
+/**
+ *  Converts block coordinates to the containing chunk.
+ */
+inline Position toChunkPosition(const Position &block) {
+    return Position(block.x >> ChunkBits, block.y >> ChunkBits, block.z >> ChunkBits);
+}
+
+/**
+ *  Packs the low 21 bits of each coordinate into a 64-bit key, for hashing
+ *  chunk, block or cell positions. Positions 2^21 apart along an axis share a
+ *  key, so tables keyed by it must only hold nearby positions.
+ */
+inline uint64_t toPositionKey(const Position &position) {
+    static const uint64_t Mask = (uint64_t(1) << 21) - 1;
+    return (uint64_t(position.x) & Mask) |
+           ((uint64_t(position.y) & Mask) << 21) |
+           ((uint64_t(position.z) & Mask) << 42);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 #endif // __TYPES_HPP__
@@ -0,0 +1,192 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "visibility.hpp"
+#include "world.hpp"
+
+#include <cstdlib>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+const int FaceSteps[6][3] = {
+    { -1, 0, 0 }, { 1, 0, 0 },
+    { 0, -1, 0 }, { 0, 1, 0 },
+    { 0, 0, -1 }, { 0, 0, 1 },
+};
+
+int getOpposite(int face) {
+    return face ^ 1;
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+const int ChunkConnectivity::FaceCount;
+
+ChunkConnectivity ChunkConnectivity::open() {
+    ChunkConnectivity connectivity;
+    connectivity.connectAll(0x3f);
+    return connectivity;
+}
+
+void ChunkConnectivity::connect(int a, int b) {
+    mBits |= (uint64_t(1) << (a * FaceCount + b)) | (uint64_t(1) << (b * FaceCount + a));
+}
+
+void ChunkConnectivity::connectAll(uint8_t faces) {
+    for (int a = 0; a < FaceCount; a++) {
+        if (faces & (1 << a)) {
+            for (int b = a; b < FaceCount; b++) {
+                if (faces & (1 << b)) {
+                    connect(a, b);
+                }
+            }
+        }
+    }
+}
+
+bool ChunkConnectivity::connects(int a, int b) const {
+    return (mBits >> (a * FaceCount + b)) & 1;
+}
+
+bool ChunkConnectivity::isOpen() const {
+    return *this == open();
+}
+
+bool ChunkConnectivity::isClosed() const {
+    return mBits == 0;
+}
+
+uint64_t ChunkConnectivity::getBits() const {
+    return mBits;
+}
+
+bool ChunkConnectivity::operator==(const ChunkConnectivity &other) const {
+    return mBits == other.mBits;
+}
+
+bool ChunkConnectivity::operator!=(const ChunkConnectivity &other) const {
+    return mBits != other.mBits;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+ChunkVisibility::ChunkVisibility(
+): mChunks(), mVisited(), mQueue() {
+}
+
+void ChunkVisibility::set(const Position &chunk, const ChunkConnectivity &connectivity) {
+    mChunks[toPositionKey(chunk)] = connectivity;
+}
+
+void ChunkVisibility::remove(const Position &chunk) {
+    mChunks.erase(toPositionKey(chunk));
+}
+
+void ChunkVisibility::clear() {
+    mChunks.clear();
+}
+
+ChunkConnectivity ChunkVisibility::get(const Position &chunk) const {
+    auto found = mChunks.find(toPositionKey(chunk));
+    return found == mChunks.end() ? ChunkConnectivity::open() : found->second;
+}
+
+bool ChunkVisibility::contains(const Position &chunk) const {
+    return mChunks.count(toPositionKey(chunk)) > 0;
+}
+
+size_t ChunkVisibility::size() const {
+    return mChunks.size();
+}
+
+void ChunkVisibility::findVisible(
+    const Position &start,
+    int distance,
+    const Frustum &frustum,
+    std::vector<Position> &visible,
+    CullStats *stats
+) {
+    visible.clear();
+
+    if (distance < 0) {
+        return;
+    }
+
+    // chunks seen so far, in a cube around the start
+    size_t side = size_t(distance) * 2 + 1;
+    mVisited.assign(side * side * side, 0);
+
+    auto getVisited = [&](const Position &chunk) -> uint8_t& {
+        size_t x = size_t(chunk.x - start.x + distance);
+        size_t y = size_t(chunk.y - start.y + distance);
+        size_t z = size_t(chunk.z - start.z + distance);
+        return mVisited[(z * side + y) * side + x];
+    };
+
+    mQueue.clear();
+    mQueue.push_back(Step { start, -1, 0 });
+    getVisited(start) = 1;
+
+    for (size_t head = 0; head < mQueue.size(); head++) {
+        Step step = mQueue[head];
+        visible.push_back(step.chunk);
+
+        ChunkConnectivity connectivity = get(step.chunk);
+
+        for (int face = 0; face < ChunkConnectivity::FaceCount; face++) {
+            if (step.directions & (1 << getOpposite(face))) {
+                continue;
+            }
+
+            if (step.entry >= 0 && !connectivity.connects(step.entry, face)) {
+                continue;
+            }
+
+            Position next(
+                step.chunk.x + FaceSteps[face][0],
+                step.chunk.y + FaceSteps[face][1],
+                step.chunk.z + FaceSteps[face][2]
+            );
+
+            if (std::abs(next.x - start.x) > distance ||
+                std::abs(next.y - start.y) > distance ||
+                std::abs(next.z - start.z) > distance) {
+                continue;
+            }
+
+            uint8_t &visited = getVisited(next);
+            if (visited) {
+                continue;
+            }
+            visited = 1;
+
+            glm::vec3 low(
+                float(next.x * ChunkData::Count),
+                float(next.y * ChunkData::Count),
+                float(next.z * ChunkData::Count)
+            );
+
+            if (stats) {
+                stats->tested += 1;
+            }
+
+            if (!frustum.intersects(low, low + glm::vec3(ChunkData::Count))) {
+                if (stats) {
+                    stats->culled += 1;
+                }
+                continue;
+            }
+
+            mQueue.push_back(Step { next, int8_t(getOpposite(face)), uint8_t(step.directions | (1 << face)) });
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,112 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __VISIBILITY_HPP__
+#define __VISIBILITY_HPP__ 1
+
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "frustum.hpp"
+#include "types.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ *  Which faces of a chunk can see each other through it: two faces are
+ *  connected when some path of transparent blocks runs from one to the
+ *  other.  Faces are numbered 0 to 5 in BlockFace order (West, East,
+ *  Bottom, Top, North, South), as the mesher numbers them.
+ */
+class ChunkConnectivity {
+    uint64_t mBits;     //!< Bit a * 6 + b for faces a and b
+
+public:
+    static const int FaceCount = 6;
+
+    ChunkConnectivity(): mBits(0) {}
+
+    /**
+     *  Gets a connectivity with every face connected, as for air.
+     */
+    static ChunkConnectivity open();
+
+    void connect(int a, int b);
+
+    /**
+     *  Connects every pair of the faces in a mask, face n in bit n.
+     */
+    void connectAll(uint8_t faces);
+
+    bool connects(int a, int b) const;
+    bool isOpen() const;
+    bool isClosed() const;
+    uint64_t getBits() const;
+
+    bool operator==(const ChunkConnectivity &other) const;
+    bool operator!=(const ChunkConnectivity &other) const;
+};
+
+/**
+ *  Finds the chunks that may be seen from a chunk, through the faces of the
+ *  chunks between.
+ *
+ *  findVisible() walks out from the camera's chunk, breadth first.  It
+ *  leaves a chunk only through faces connected to the face it came in by,
+ *  never steps back against a direction it has already moved in (so the
+ *  walk fans out from the camera), and skips chunks outside the frustum or
+ *  further than the distance along any axis.  Solid rock and closed caves
+ *  are never visited, however near.  Chunks whose connectivity is not known
+ *  count as open.
+ */
+class ChunkVisibility {
+    struct Step {
+        Position chunk;
+        int8_t entry;           //!< Face it was entered by, or -1
+        uint8_t directions;     //!< Faces stepped out of on the way
+    };
+
+    std::unordered_map<uint64_t, ChunkConnectivity> mChunks;
+    std::vector<uint8_t> mVisited;
+    std::vector<Step> mQueue;
+
+public:
+    ChunkVisibility();
+
+    void set(const Position &chunk, const ChunkConnectivity &connectivity);
+    void remove(const Position &chunk);
+    void clear();
+
+    /**
+     *  Gets a chunk's connectivity; open if it is not known.
+     */
+    ChunkConnectivity get(const Position &chunk) const;
+    bool contains(const Position &chunk) const;
+    size_t size() const;
+
+    /**
+     *  Replaces visible with the chunks that may be seen from start, start
+     *  first, then outward.  Counts the chunks tested against the frustum,
+     *  and those culled, in stats if given.
+     */
+    void findVisible(
+        const Position &start,
+        int distance,
+        const Frustum &frustum,
+        std::vector<Position> &visible,
+        CullStats *stats = nullptr
+    );
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // __VISIBILITY_HPP__
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -4,9 +4,17 @@
 
 #include "world.hpp"
 
+#include <algorithm>
+#include <cmath>
+
+#include "jobs.hpp"
+#include "math.hpp"
+#include "tick.hpp"
+
 ////////////////////////////////////////////////////////////////////////////////
 
-namespace std {
+// declared alongside the vector types so std::map can find them by ADL
+namespace sf {
     template <typename T>
     bool operator< (const sf::Vector3<T> &a, const sf::Vector3<T> &b) {
         if (a.z == b.z) {
@@ -29,6 +37,72 @@ namespace std {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+std::vector<Block::Attributes> Block::mAttrs;
+std::map<std::string, BlockType> Block::mNames;
+std::map<BlockType, std::string> Block::mNamesInv;
+
+std::string Block::getName(BlockType type) {
+    auto found = mNamesInv.find(type);
+    if (found != mNamesInv.end()) {
+        return found->second;
+    }
+    return std::string();
+}
+
+BlockType Block::getType(const std::string &name) {
+    auto found = mNames.find(name);
+    if (found != mNames.end()) {
+        return found->second;
+    }
+    return 0;
+}
+
+Block::Attributes Block::getAttributes(BlockType type) {
+    if (type == 0) {
+        return static_cast<Attributes>(
+            static_cast<uint8_t>(Attributes::Transparent) |
+            static_cast<uint8_t>(Attributes::Passable)
+        );
+    } else if (type < mAttrs.size()) {
+        return mAttrs[type];
+    }
+    return Attributes::Default;
+}
+
+Block::Attributes Block::getAttributes(const std::string &name) {
+    return getAttributes(getType(name));
+}
+
+bool Block::hasAttribute(BlockType type, Attributes attr) {
+    return (static_cast<uint8_t>(getAttributes(type)) & static_cast<uint8_t>(attr)) != 0;
+}
+
+bool Block::isSolid(BlockType type) {
+    return !hasAttribute(type, Attributes::Passable);
+}
+
+void Block::enlist(BlockType type, const std::string &name, Attributes attr) {
+    if (type >= mAttrs.size()) {
+        mAttrs.resize(type + 1, Attributes::Default);
+    }
+    mAttrs[type] = attr;
+    mNames[name] = type;
+    mNamesInv[type] = name;
+}
+
+void Block::delist(BlockType type) {
+    if (type < mAttrs.size()) {
+        mAttrs[type] = Attributes::Default;
+    }
+    auto found = mNamesInv.find(type);
+    if (found != mNamesInv.end()) {
+        mNames.erase(found->second);
+        mNamesInv.erase(found);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 ChunkData::ChunkData() {
     std::fill(mBlockType, std::end(mBlockType), 0);
     std::fill(mBlockData, std::end(mBlockData), 0);
@@ -38,8 +112,51 @@ ChunkData::ChunkData() {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+static float noise(int32_t x, int32_t z, uint32_t seed) {
+    uint32_t h = seed ^ (uint32_t(x) * 0x8da6b343) ^ (uint32_t(z) * 0xd8163841);
+    h ^= h >> 13;
+    h *= 0x5bd1e995;
+    h ^= h >> 15;
+    return (h & 0xffff) / 65535.0f;
+}
+
+static float smoothNoise(Coord x, Coord z, unsigned int bits, uint32_t seed) {
+    Coord step = Coord(1) << bits;
+    int32_t cx = int32_t(x >> bits);
+    int32_t cz = int32_t(z >> bits);
+    float fx = float(x & (step - 1)) / step;
+    float fz = float(z & (step - 1)) / step;
+
+    float a = noise(cx, cz, seed);
+    float b = noise(cx + 1, cz, seed);
+    float c = noise(cx, cz + 1, seed);
+    float d = noise(cx + 1, cz + 1, seed);
+
+    return lerp(fz, lerp(fx, a, b), lerp(fx, c, d));
+}
+
+Coord ChunkGenerator::getHeight(Coord x, Coord z) const {
+    float height = 24.0f * smoothNoise(x, z, 5, mSeed) +
+                    8.0f * smoothNoise(x, z, 3, mSeed + 1) - 16.0f;
+    return static_cast<Coord>(std::floor(height));
+}
+
 Chunk *ChunkGenerator::loadChunk(Chunk &chunk, const Position &position) {
-    return nullptr;
+    ChunkData *data = chunk.getData();
+    Position origin(position.x * ChunkData::Count, position.y * ChunkData::Count, position.z * ChunkData::Count);
+
+    for (unsigned int z = 0; z < ChunkData::Count; z++) {
+        for (unsigned int x = 0; x < ChunkData::Count; x++) {
+            Coord height = getHeight(origin.x + x, origin.z + z);
+
+            for (unsigned int y = 0; y < ChunkData::Count; y++) {
+                Position pos(x, y, z);
+                data->getBlock(pos).setType(origin.y + y <= height ? Ground : 0);
+            }
+        }
+    }
+
+    return &chunk;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -83,6 +200,119 @@ Chunk *ChunkCache::getChunk(const Position &position) {
     }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+
+World::World(
+    ChunkSource *upstream,
+    uint32_t ticksPerSecond,
+    unsigned int threads
+): mUpstream(upstream), mTicksPerSecond(
+    ticksPerSecond == 0 ? DefaultTicksPerSecond :
+    ticksPerSecond > MaxTicksPerSecond ? MaxTicksPerSecond : ticksPerSecond
+), mTicksPerDay(
+    uint64_t(mTicksPerSecond) * 20 * 60 // 20 minute days
+), mJobs(
+    new JobPool(threads)
+), mPipeline(
+    new TickPipeline(*mJobs)
+), mPhaseHandlers(
+), mProfiler(
+    sf::microseconds(1000000 / mTicksPerSecond)
+), mTickLength(
+    sf::microseconds(1000000 / mTicksPerSecond)
+), mTickAccum() {
+}
+
+World::~World() {
+}
+
+uint32_t World::getTicksPerSecond() const {
+    return mTicksPerSecond;
+}
+
+sf::Time World::getTickLength() const {
+    return mTickLength;
+}
+
+unsigned int World::getThreadCount() const {
+    return mJobs->getThreadCount();
+}
+
+uint64_t World::getTimeOfDay() const {
+    return getTick() % mTicksPerDay;
+}
+
+unsigned int World::update(sf::Time elapsed, unsigned int maxTicks) {
+    unsigned int ticks = 0;
+    mTickAccum += elapsed;
+
+    while (mTickAccum >= mTickLength) {
+        mTickAccum -= mTickLength;
+
+        if (ticks < maxTicks) {
+            tick();
+            ticks += 1;
+        }
+    }
+
+    return ticks;
+}
+
+void World::tick() {
+    mProfiler.beginTick(getTick());
+
+    for (int i = 0; i < TickProfiler::PhaseCount; i++) {
+        TickProfiler::Phase phase = TickProfiler::Phase(i);
+
+        if (phase == TickProfiler::Entities) {
+            TickProfiler::Scope scope(mProfiler, phase);
+
+            sf::Time start = mProfiler.getTickTime();
+            mPipeline->tick();
+
+            // the pipeline's phases ran on the job pool, so add them afterward
+            for (int j = 0; j < TickPipeline::PhaseCount; j++) {
+                TickPipeline::Phase part = TickPipeline::Phase(j);
+                mProfiler.addSpan(TickPipeline::getPhaseName(part), start, mPipeline->getPhaseTime(part));
+                start += mPipeline->getPhaseTime(part);
+            }
+
+            if (mPhaseHandlers[phase]) {
+                mPhaseHandlers[phase](*this);
+            }
+        } else if (mPhaseHandlers[phase]) {
+            TickProfiler::Scope scope(mProfiler, phase);
+            mPhaseHandlers[phase](*this);
+        }
+    }
+
+    mProfiler.endTick();
+}
+
+uint64_t World::getTick() const {
+    return mPipeline->getTick();
+}
+
+TickPipeline &World::getPipeline() {
+    return *mPipeline;
+}
+
+const TickPipeline &World::getPipeline() const {
+    return *mPipeline;
+}
+
+void World::setPhaseHandler(TickProfiler::Phase phase, const PhaseHandler &handler) {
+    mPhaseHandlers[phase] = handler;
+}
+
+TickProfiler &World::getProfiler() {
+    return mProfiler;
+}
+
+const TickProfiler &World::getProfiler() const {
+    return mProfiler;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //  EOF
 ////////////////////////////////////////////////////////////////////////////////
@@ -8,10 +8,15 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #include <deque>
+#include <functional>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include <SFML/System/Time.hpp>
+
+#include "profiler.hpp"
 #include "types.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -45,9 +50,15 @@ public:
     void setLight(LightData light) { *mLight = light; }
 
 public:
+    /**
+     *  Block attribute flags.
+     *
+     *  Block type 0 is always air, which is transparent and passable.
+     */
     enum class Attributes : uint8_t {
         Default     = 0,
-        Transparent = 1,
+        Transparent = 1,    //!< Light and sight pass through
+        Passable    = 2,    //!< Bodies pass through (not solid)
     };
 
 private:
@@ -60,30 +71,47 @@ public:
     static BlockType getType(const std::string &name);
     static Attributes getAttributes(BlockType type);
     static Attributes getAttributes(const std::string &name);
+    static bool hasAttribute(BlockType type, Attributes attr);
+    static bool isSolid(BlockType type);
 
     static void enlist(BlockType type, const std::string &name, Attributes attr = Attributes::Default);
     static void delist(BlockType type);
 };
 
 class ChunkData {
-    static const unsigned int Count = 16;
+public:
+    static const unsigned int Count = 1 << ChunkBits;
 
+private:
     BlockType mBlockType[Count * Count * Count];
     BlockData mBlockData[Count * Count * Count];
     LightData mLightData[Count * Count * Count];
 
+    static uint16_t getIndex(const Position &pos) {
+        // masking (rather than %) wraps negative block coordinates correctly
+        return (pos.z & (Count - 1)) * Count * Count +
+               (pos.y & (Count - 1)) * Count +
+               (pos.x & (Count - 1));
+    }
+
 public:
     ChunkData();
 
     //~ ~ChunkData() {}
 
     Block getBlock(const Position &pos) {
-        uint16_t i = (pos.z % Count) * Count * Count +
-                     (pos.y % Count) * Count +
-                     (pos.x % Count);
+        uint16_t i = getIndex(pos);
         return Block(&mBlockType[i], &mBlockData[i], &mLightData[i]);
     }
 
+    BlockType getType(const Position &pos) const {
+        return mBlockType[getIndex(pos)];
+    }
+
+    LightData getLight(const Position &pos) const {
+        return mLightData[getIndex(pos)];
+    }
+
     Block operator[](const Position &pos) {
         return getBlock(pos);
     }
@@ -150,9 +178,19 @@ public:
  * Generates randomized chunk data.
  */
 class ChunkGenerator : public ChunkSource {
+    uint32_t mSeed;
 
 public:
+    static const BlockType Ground = 1;
+
+    explicit ChunkGenerator(uint32_t seed = 0): mSeed(seed) {}
+
     Chunk *loadChunk(Chunk &chunk, const Position &pos);
+
+    /**
+     *  Gets the height of the terrain surface at the given block column.
+     */
+    Coord getHeight(Coord x, Coord z) const;
 };
 
 /**
@@ -218,14 +256,79 @@ public:
 
 ////////////////////////////////////////////////////////////////////////////////
 
+class JobPool;
+class TickPipeline;
+
+/**
+ *  Server side state of a world, advanced in fixed ticks.
+ *
+ *  update() runs as many ticks as the elapsed time calls for, at most
+ *  maxTicks at once; time beyond that is dropped rather than caught up
+ *  later, so an overloaded server slows down instead of stalling.
+ *
+ *  A tick runs the phases of TickProfiler in order.  The entities phase
+ *  runs the tick pipeline; the others run handlers set by the server, if
+ *  any.  Each phase is profiled, with a budget of one tick length.
+ */
 class World {
+public:
+    typedef std::function<void(World &)> PhaseHandler;
+
+    static const uint32_t DefaultTicksPerSecond = 50;
+    static const uint32_t MaxTicksPerSecond = 1000;
+
+private:
     ChunkSource *mUpstream;
 
     uint32_t mTicksPerSecond;
     uint64_t mTicksPerDay;
 
+    std::unique_ptr<JobPool> mJobs;
+    std::unique_ptr<TickPipeline> mPipeline;
+    PhaseHandler mPhaseHandlers[TickProfiler::PhaseCount];
+    TickProfiler mProfiler;
+
+    sf::Time mTickLength;
+    sf::Time mTickAccum;
+
 public:
-    explicit World(ChunkSource *upstream): mUpstream(upstream) {}
+    /**
+     *  Creates a world ticking ticksPerSecond times a second, with the given
+     *  number of threads for entity updates (zero for one per core).  A rate
+     *  of zero falls back to DefaultTicksPerSecond, and faster rates than
+     *  MaxTicksPerSecond are clamped to it.
+     */
+    explicit World(ChunkSource *upstream, uint32_t ticksPerSecond = DefaultTicksPerSecond, unsigned int threads = 0);
+    ~World();
+
+    uint32_t getTicksPerSecond() const;
+    sf::Time getTickLength() const;
+    unsigned int getThreadCount() const;
+
+    /**
+     *  Gets the tick within the current day.
+     */
+    uint64_t getTimeOfDay() const;
+
+    /**
+     *  Runs the ticks due after elapsed time, returning how many ran.
+     */
+    unsigned int update(sf::Time elapsed, unsigned int maxTicks = 5);
+
+    void tick();
+    uint64_t getTick() const;
+
+    TickPipeline &getPipeline();
+    const TickPipeline &getPipeline() const;
+
+    /**
+     *  Sets the handler run in a phase of each tick; the entities phase
+     *  runs its handler after the tick pipeline.
+     */
+    void setPhaseHandler(TickProfiler::Phase phase, const PhaseHandler &handler);
+
+    TickProfiler &getProfiler();
+    const TickProfiler &getProfiler() const;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,105 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __TEST_HELPERS_HPP__
+#define __TEST_HELPERS_HPP__ 1
+
+////////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+
+#include "engine/engine.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ *  A small linear congruential generator, so that test data is the same on
+ *  every platform and standard library.
+ */
+class Random {
+    uint32_t mState;
+
+public:
+    explicit Random(uint32_t seed): mState(seed) {}
+
+    uint32_t next() {
+        mState = mState * 1103515245 + 12345;
+        return mState >> 8;
+    }
+
+    int32_t range(int32_t min, int32_t max) {
+        return min + int32_t(next() % uint32_t(max - min + 1));
+    }
+};
+
+/**
+ *  Solid ground below y = 0, with a wall 4 blocks high at x = 4 and x = -8.
+ */
+class TestSource : public ChunkSource {
+public:
+    Chunk *loadChunk(Chunk &chunk, const Position &pos) {
+        ChunkData *data = chunk.getData();
+        Position origin(pos.x * ChunkData::Count, pos.y * ChunkData::Count, pos.z * ChunkData::Count);
+
+        for (unsigned int z = 0; z < ChunkData::Count; z++) {
+            for (unsigned int y = 0; y < ChunkData::Count; y++) {
+                for (unsigned int x = 0; x < ChunkData::Count; x++) {
+                    Position block(origin.x + x, origin.y + y, origin.z + z);
+                    bool wall = (block.x == 4 || block.x == -8) && block.y >= 0 && block.y < 4;
+                    bool solid = block.y < 0 || wall;
+                    data->getBlock(Position(x, y, z)).setType(solid ? 1 : 0);
+                }
+            }
+        }
+
+        return &chunk;
+    }
+};
+
+/**
+ *  Fills bodies with count bodies placed within span of the origin, with
+ *  velocities of up to speed and masses of 1 to maxMass.  Mixed bodies are
+ *  boxes, spheres and capsules alike; otherwise all are spheres.
+ */
+inline void makeBodies(
+    std::vector<Physics::Body> &bodies,
+    size_t count,
+    Random &random,
+    int32_t span,
+    int32_t speed,
+    int32_t maxMass,
+    bool mixed
+) {
+    bodies.resize(count);
+
+    for (Physics::Body &body : bodies) {
+        body.setPosition(Position(random.range(-span, span), random.range(-span, span), random.range(-span, span)));
+        body.setVelocity(Velocity(random.range(-speed, speed), random.range(-speed, speed), random.range(-speed, speed)));
+        body.setMass(maxMass > 1 ? random.range(1, maxMass) : 1);
+
+        switch (mixed ? random.next() % 3 : 1) {
+            case 0: {
+                Size w = random.range(32, 256);
+                body.setBounds(BoundingVolume::box(Dimension(w, random.range(32, 256), w)));
+                break;
+            }
+            case 1: {
+                body.setBounds(BoundingVolume::sphere(random.range(32, 256)));
+                break;
+            }
+            case 2: {
+                body.setBounds(BoundingVolume::capsule(random.range(32, 128), random.range(128, 512)));
+                break;
+            }
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // __TEST_HELPERS_HPP__
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
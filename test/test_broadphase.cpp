@@ -0,0 +1,141 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch.hpp"
+
+#include "engine/engine.hpp"
+#include "helpers.hpp"
+
+#include <SFML/System/Clock.hpp>
+
+#include <set>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+bool overlaps(const Physics::Body &a, const Physics::Body &b) {
+    Dimension ea = a.getBounds().getExtents();
+    Dimension eb = b.getBounds().getExtents();
+    Position d = a.getPosition() - b.getPosition();
+    return std::abs(d.x) <= Coord(ea.x) + eb.x + 2 * Physics::Epsilon &&
+           std::abs(d.y) <= Coord(ea.y) + eb.y + 2 * Physics::Epsilon &&
+           std::abs(d.z) <= Coord(ea.z) + eb.z + 2 * Physics::Epsilon;
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+SCENARIO("broadphase","[physics][broadphase]") {
+
+    Physics physics;
+    Random random(1234);
+
+    GIVEN("500 moving bodies of mixed shapes") {
+        std::vector<Physics::Body> bodies;
+        makeBodies(bodies, 500, random, 16 << 8, 64, 1, true);
+
+        Broadphase broadphase(9);
+        std::vector<Broadphase::Proxy> proxies;
+
+        for (Physics::Body &body : bodies) {
+            proxies.push_back(broadphase.insert(body, &body));
+        }
+
+        CHECK(broadphase.getProxyCount() == bodies.size());
+        CHECK(broadphase.getUserData(proxies[7]) == &bodies[7]);
+
+        for (int tick = 0; tick < 20; tick++) {
+            CAPTURE(tick);
+
+            std::vector<Broadphase::Pair> pairs;
+            broadphase.findPairs(pairs);
+
+            std::set<Broadphase::Pair> found(pairs.begin(), pairs.end());
+            CHECK(found.size() == pairs.size());
+
+            std::set<Broadphase::Pair> expected;
+            for (size_t i = 0; i < bodies.size(); i++) {
+                for (size_t j = i + 1; j < bodies.size(); j++) {
+                    if (overlaps(bodies[i], bodies[j])) {
+                        expected.insert(Broadphase::Pair(proxies[i], proxies[j]));
+                    }
+                }
+            }
+
+            CHECK(found == expected);
+            CHECK(broadphase.getPairsTested() < bodies.size() * bodies.size() / 2);
+
+            for (size_t i = 0; i < bodies.size(); i++) {
+                physics.update(bodies[i], sf::seconds(1));
+                broadphase.update(proxies[i], bodies[i]);
+            }
+        }
+
+        WHEN("Bodies are removed") {
+            for (size_t i = 0; i < bodies.size(); i += 2) {
+                broadphase.remove(proxies[i]);
+            }
+
+            CHECK(broadphase.getProxyCount() == bodies.size() / 2);
+
+            std::vector<Broadphase::Pair> pairs;
+            broadphase.findPairs(pairs);
+
+            for (const Broadphase::Pair &pair : pairs) {
+                CHECK(pair.first % 2 == 1);
+                CHECK(pair.second % 2 == 1);
+            }
+
+            THEN("Their proxies are reused") {
+                Broadphase::Proxy proxy = broadphase.insert(bodies[0]);
+                CHECK(proxy % 2 == 0);
+            }
+        }
+    }
+}
+
+TEST_CASE("broadphase benchmark","[.][benchmark][broadphase]") {
+    static const size_t Count = 10000;
+    static const int Ticks = 100;
+
+    Physics physics;
+    Random random(5678);
+
+    std::vector<Physics::Body> bodies;
+    makeBodies(bodies, Count, random, 128 << 8, 64, 1, true);
+
+    Broadphase broadphase;
+    std::vector<Broadphase::Proxy> proxies;
+
+    for (Physics::Body &body : bodies) {
+        proxies.push_back(broadphase.insert(body, &body));
+    }
+
+    std::vector<Broadphase::Pair> pairs;
+    size_t pairsTested = 0, pairsFound = 0;
+    sf::Clock clock;
+
+    for (int tick = 0; tick < Ticks; tick++) {
+        for (size_t i = 0; i < Count; i++) {
+            physics.update(bodies[i], sf::seconds(1));
+            broadphase.update(proxies[i], bodies[i]);
+        }
+
+        broadphase.findPairs(pairs);
+        pairsTested += broadphase.getPairsTested();
+        pairsFound += pairs.size();
+    }
+
+    float ms = clock.getElapsedTime().asSeconds() * 1000.0f / Ticks;
+
+    WARN(Count << " bodies: " << ms << " ms/tick, " <<
+         pairsTested / Ticks << " pairs tested/tick (brute force " <<
+         Count * (Count - 1) / 2 << "), " << pairsFound / Ticks << " pairs found/tick");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,363 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch.hpp"
+
+#include "engine/engine.hpp"
+#include "helpers.hpp"
+
+#include <SFML/System/Clock.hpp>
+
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+Entity makeEntity(EntityID id, Random &random) {
+    return Entity(
+        id,
+        Position(random.range(-1 << 20, 1 << 20), random.range(-1 << 12, 1 << 12), random.range(-1 << 20, 1 << 20)),
+        Velocity(random.range(-64, 64), random.range(-64, 64), random.range(-64, 64)),
+        Orientation(Angle::Zero, Angle::Zero)
+    );
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+SCENARIO("entity ids","[entity]") {
+
+    EntityIDAllocator ids;
+
+    GIVEN("100 allocated ids") {
+        std::vector<EntityID> allocated;
+        for (int i = 0; i < 100; i++) {
+            allocated.push_back(ids.allocate());
+        }
+
+        CHECK(ids.size() == 100);
+        CHECK(EntityIDAllocator::getIndex(allocated[42]) == 42);
+        CHECK(EntityIDAllocator::getGeneration(allocated[42]) == 1);
+
+        for (EntityID id : allocated) {
+            CHECK(id != 0);
+            CHECK(ids.isAlive(id));
+        }
+
+        WHEN("Some are released") {
+            CHECK(ids.release(allocated[7]));
+            CHECK(ids.release(allocated[3]));
+            CHECK_FALSE(ids.release(allocated[7]));
+            CHECK_FALSE(ids.isAlive(allocated[7]));
+            CHECK(ids.size() == 98);
+
+            THEN("Their indices are reused oldest first, with a new generation") {
+                EntityID a = ids.allocate();
+                EntityID b = ids.allocate();
+                CHECK(EntityIDAllocator::getIndex(a) == 7);
+                CHECK(EntityIDAllocator::getGeneration(a) == 2);
+                CHECK(EntityIDAllocator::getIndex(b) == 3);
+
+                CHECK(ids.isAlive(a));
+                CHECK_FALSE(ids.isAlive(allocated[7]));
+                CHECK_FALSE(ids.release(allocated[7]));
+                CHECK(ids.getCapacity() == 100);
+            }
+        }
+    }
+
+    GIVEN("Generations that wrap around") {
+        CHECK(EntityIDAllocator::isNewer(2, 1));
+        CHECK_FALSE(EntityIDAllocator::isNewer(1, 1));
+        CHECK_FALSE(EntityIDAllocator::isNewer(1, 2));
+        CHECK(EntityIDAllocator::isNewer(1, 0xffffffff));
+    }
+
+    GIVEN("A client registry fed by the server's ids") {
+        EntityRegistry client;
+        Orientation facing(Angle::Zero, Angle::Zero);
+
+        EntityID first = ids.allocate();
+        CHECK(client.insert(Entity(first, Position(), Velocity(), facing)) != EntityRegistry::Null);
+
+        WHEN("The despawn is lost and the index is reused") {
+            ids.release(first);
+            EntityID second = ids.allocate();
+            REQUIRE(EntityIDAllocator::getIndex(second) == EntityIDAllocator::getIndex(first));
+
+            CHECK(client.insert(Entity(second, Position(1, 2, 3), Velocity(), facing)) != EntityRegistry::Null);
+
+            THEN("The new entity replaces the stale one") {
+                CHECK(client.size() == 1);
+                CHECK_FALSE(client.contains(first));
+                REQUIRE(client.contains(second));
+                CHECK(client.getPositions()[client.find(second)] == Position(1, 2, 3));
+            }
+
+            THEN("Late packets for the old entity are ignored") {
+                CHECK(client.find(first) == EntityRegistry::Null);
+                CHECK_FALSE(client.erase(first));
+                CHECK(client.insert(Entity(first, Position(), Velocity(), facing)) == EntityRegistry::Null);
+                CHECK(client.contains(second));
+            }
+        }
+    }
+}
+
+SCENARIO("entity registry","[entity]") {
+
+    Random random(777);
+
+    GIVEN("A registry of 1000 entities") {
+        EntityRegistry registry;
+        std::vector<Entity> entities;
+
+        for (EntityID id = 0; id < 1000; id++) {
+            entities.push_back(makeEntity(id * 3 + 1, random));
+            CHECK(registry.insert(entities.back()) == id);
+        }
+
+        CHECK(registry.size() == 1000);
+        CHECK(registry.contains(4));
+        CHECK_FALSE(registry.contains(5));
+        CHECK(registry.find(1 << 30) == EntityRegistry::Null);
+
+        THEN("Ids in use are refused") {
+            CHECK(registry.insert(entities[10]) == EntityRegistry::Null);
+            CHECK(registry.size() == 1000);
+        }
+
+        THEN("Updating matches updating each entity") {
+            for (int tick = 0; tick < 10; tick++) {
+                registry.update();
+                for (Entity &entity : entities) {
+                    entity.update();
+                }
+            }
+
+            for (const Entity &entity : entities) {
+                size_t index = registry.find(entity.getID());
+                REQUIRE(index != EntityRegistry::Null);
+                CHECK(registry.getPositions()[index] == entity.getPosition());
+            }
+        }
+
+        WHEN("Entities are erased") {
+            for (size_t i = 0; i < entities.size(); i += 2) {
+                CHECK(registry.erase(entities[i].getID()));
+            }
+            CHECK_FALSE(registry.erase(entities[0].getID()));
+            CHECK(registry.size() == 500);
+
+            THEN("The others are still found with their components") {
+                for (size_t i = 0; i < entities.size(); i++) {
+                    size_t index = registry.find(entities[i].getID());
+                    if (i % 2) {
+                        REQUIRE(index != EntityRegistry::Null);
+                        CHECK(registry.getIDs()[index] == entities[i].getID());
+                        CHECK(registry.getEntity(index).getPosition() == entities[i].getPosition());
+                        CHECK(registry.getVelocities()[index] == entities[i].getVelocity());
+                    } else {
+                        CHECK(index == EntityRegistry::Null);
+                    }
+                }
+            }
+
+            THEN("Their ids can be used again") {
+                CHECK(registry.insert(entities[0]) == 500);
+            }
+        }
+    }
+}
+
+SCENARIO("entity index","[entity]") {
+
+    const Coord M = 1 << FixedPointBits;
+    const Coord ChunkSize = ChunkData::Count * M;
+    Orientation facing(Angle::Zero, Angle::Zero);
+
+    GIVEN("An entity at the edge of a chunk") {
+        EntityIndex index;
+        Entity entity(1, Position(ChunkSize - 1, 0, -1), Velocity(1, 0, 0), facing);
+        index.insert(entity.getID(), entity.getPosition());
+
+        REQUIRE(index.getEntities(Position(0, 0, -1)) != nullptr);
+        CHECK(index.getEntities(Position(0, 0, -1))->front() == 1);
+
+        WHEN("It moves across the boundary") {
+            entity.update(index);
+
+            THEN("It is in the next chunk only") {
+                CHECK(index.size() == 1);
+                CHECK(index.getEntities(Position(0, 0, -1)) == nullptr);
+                REQUIRE(index.getEntities(Position(1, 0, -1)) != nullptr);
+                CHECK(index.getEntities(Position(1, 0, -1))->front() == 1);
+            }
+
+            THEN("It can be removed") {
+                CHECK_FALSE(index.remove(1, Position()));
+                CHECK(index.remove(1, entity.getPosition()));
+                CHECK(index.size() == 0);
+            }
+        }
+    }
+
+    GIVEN("2000 moving entities") {
+        Random random(31337);
+        EntityRegistry registry;
+        EntityIDAllocator ids;
+
+        for (int i = 0; i < 2000; i++) {
+            Entity entity = makeEntity(ids.allocate(), random);
+            Position p = entity.getPosition();
+            registry.insert(Entity(entity.getID(), Position(p.x / 16, p.y, p.z / 16), entity.getVelocity(), facing));
+        }
+
+        EntityIndex index;
+        index.insert(registry);
+        CHECK(index.size() == registry.size());
+
+        for (int tick = 0; tick < 20; tick++) {
+            CAPTURE(tick);
+            registry.update(index);
+
+            Position center(random.range(-64 * M, 64 * M), 0, random.range(-64 * M, 64 * M));
+            Coord radius = random.range(M, 64 * M);
+            Position extents(radius, 16 * M, radius / 2);
+
+            std::vector<EntityID> inRadius, inBox;
+            index.queryRadius(center, radius, registry, inRadius);
+            index.queryBox(center - extents, center + extents, registry, inBox);
+
+            std::vector<EntityID> expectRadius, expectBox;
+            for (size_t i = 0; i < registry.size(); i++) {
+                Position d = registry.getPositions()[i] - center;
+                if (d.x * d.x + d.y * d.y + d.z * d.z <= radius * radius) {
+                    expectRadius.push_back(registry.getIDs()[i]);
+                }
+                if (std::abs(d.x) <= extents.x && std::abs(d.y) <= extents.y && std::abs(d.z) <= extents.z) {
+                    expectBox.push_back(registry.getIDs()[i]);
+                }
+            }
+            std::sort(expectRadius.begin(), expectRadius.end());
+            std::sort(expectBox.begin(), expectBox.end());
+
+            CHECK(inRadius == expectRadius);
+            CHECK(inBox == expectBox);
+        }
+
+        THEN("Every entity is in the bucket of its chunk") {
+            for (size_t i = 0; i < registry.size(); i++) {
+                const std::vector<EntityID> *bucket = index.getEntities(EntityIndex::getChunk(registry.getPositions()[i]));
+                REQUIRE(bucket != nullptr);
+                CHECK(std::count(bucket->begin(), bucket->end(), registry.getIDs()[i]) == 1);
+            }
+        }
+    }
+}
+
+TEST_CASE("entity registry benchmark","[.][benchmark][entity]") {
+    static const size_t Count = 100000;
+    static const int Ticks = 200;
+
+    Random random(4242);
+    std::vector<Entity> entities;
+    EntityRegistry registry;
+
+    for (EntityID id = 0; id < Count; id++) {
+        entities.push_back(makeEntity(id, random));
+        registry.insert(entities.back());
+    }
+
+    sf::Clock clock;
+    for (int tick = 0; tick < Ticks; tick++) {
+        for (Entity &entity : entities) {
+            entity.update();
+        }
+    }
+    float objects = clock.restart().asSeconds() * 1000.0f / Ticks;
+
+    for (int tick = 0; tick < Ticks; tick++) {
+        registry.update();
+    }
+    float arrays = clock.getElapsedTime().asSeconds() * 1000.0f / Ticks;
+
+    WARN(Count << " entities: " << objects << " ms/tick as objects, " <<
+         arrays << " ms/tick in a registry");
+
+    CHECK(registry.getPositions()[Count / 2] == entities[Count / 2].getPosition());
+}
+
+TEST_CASE("entity index benchmark","[.][benchmark][entity]") {
+    static const size_t Count = 50000;
+    static const int Ticks = 100;
+    static const int Queries = 1000;
+    static const Coord Radius = 32 << FixedPointBits;
+
+    Random random(2718);
+    EntityRegistry registry;
+    EntityIDAllocator ids;
+
+    for (size_t i = 0; i < Count; i++) {
+        registry.insert(makeEntity(ids.allocate(), random));
+    }
+
+    EntityIndex index;
+    index.insert(registry);
+
+    sf::Clock clock;
+    for (int tick = 0; tick < Ticks; tick++) {
+        registry.update();
+    }
+    float plain = clock.restart().asSeconds() * 1000.0f / Ticks;
+
+    // undo the moves so the index is still right
+    for (size_t i = 0; i < Count; i++) {
+        const Velocity &v = registry.getVelocities()[i];
+        Position &p = registry.getPositions()[i];
+        p -= Position(Coord(v.x) * Ticks, Coord(v.y) * Ticks, Coord(v.z) * Ticks);
+    }
+
+    clock.restart();
+    for (int tick = 0; tick < Ticks; tick++) {
+        registry.update(index);
+    }
+    float indexed = clock.restart().asSeconds() * 1000.0f / Ticks;
+
+    std::vector<Position> centers;
+    for (int i = 0; i < Queries; i++) {
+        centers.push_back(registry.getPositions()[random.next() % Count]);
+    }
+
+    std::vector<EntityID> found;
+    size_t total = 0;
+
+    clock.restart();
+    for (const Position &center : centers) {
+        index.queryRadius(center, Radius, registry, found);
+        total += found.size();
+    }
+    float query = clock.restart().asSeconds() * 1000000.0f / Queries;
+
+    size_t brute = 0;
+    for (const Position &center : centers) {
+        for (const Position &p : registry.getPositions()) {
+            Position d = p - center;
+            brute += d.x * d.x + d.y * d.y + d.z * d.z <= Radius * Radius;
+        }
+    }
+    float scan = clock.getElapsedTime().asSeconds() * 1000000.0f / Queries;
+
+    WARN(Count << " entities: update " << plain << " ms/tick, " << indexed <<
+         " ms/tick keeping the index; 32 m radius query " << query << " us (" <<
+         total / Queries << " found), full scan " << scan << " us");
+
+    CHECK(total == brute);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,99 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch.hpp"
+
+#include "engine/engine.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+////////////////////////////////////////////////////////////////////////////////
+
+SCENARIO("frustum culling","[frustum]") {
+
+    GIVEN("A 90 degree view down -z from the origin, from 1 to 100") {
+        glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, 1.0f, 100.0f);
+        Frustum frustum(projection);
+
+        THEN("Its planes face inward") {
+            CHECK(frustum.getPlane(Frustum::Near).z == Approx(-1));
+            CHECK(frustum.getPlane(Frustum::Near).w == Approx(-1));
+            CHECK(frustum.getPlane(Frustum::Far).z == Approx(1));
+            CHECK(frustum.getPlane(Frustum::Far).w == Approx(100));
+        }
+
+        THEN("Points in front are inside, others are not") {
+            CHECK(frustum.contains(glm::vec3(0, 0, -10)));
+            CHECK(frustum.contains(glm::vec3(9, -9, -10)));
+            CHECK_FALSE(frustum.contains(glm::vec3(11, 0, -10)));
+            CHECK_FALSE(frustum.contains(glm::vec3(0, 0, 10)));
+            CHECK_FALSE(frustum.contains(glm::vec3(0, 0, -0.5f)));
+            CHECK_FALSE(frustum.contains(glm::vec3(0, 0, -101)));
+        }
+
+        THEN("Spheres are culled only when wholly outside") {
+            CHECK(frustum.intersects(glm::vec3(0, 0, -50), 1));
+            CHECK(frustum.intersects(glm::vec3(12, 0, -10), 2));
+            CHECK_FALSE(frustum.intersects(glm::vec3(12, 0, -10), 1));
+            CHECK_FALSE(frustum.intersects(glm::vec3(0, 0, 5), 3));
+            CHECK(frustum.intersects(glm::vec3(0, 0, 5), 7));
+        }
+
+        THEN("Boxes are classified") {
+            CHECK(frustum.classify(glm::vec3(-1, -1, -11), glm::vec3(1, 1, -9)) == Frustum::Inside);
+            CHECK(frustum.classify(glm::vec3(8, -1, -11), glm::vec3(16, 1, -9)) == Frustum::Intersects);
+            CHECK(frustum.classify(glm::vec3(12, -1, -11), glm::vec3(16, 1, -9)) == Frustum::Outside);
+            CHECK(frustum.classify(glm::vec3(-16, -16, 0), glm::vec3(16, 16, 16)) == Frustum::Outside);
+
+            CHECK(frustum.intersects(glm::vec3(8, -1, -11), glm::vec3(16, 1, -9)));
+            CHECK_FALSE(frustum.intersects(glm::vec3(-16, -16, 0), glm::vec3(16, 16, 16)));
+        }
+
+        WHEN("The view turns around and moves") {
+            glm::mat4 view = glm::lookAt(glm::vec3(100, 0, 0), glm::vec3(200, 0, 0), glm::vec3(0, 1, 0));
+            frustum.set(projection * view);
+
+            THEN("The culling moves with it") {
+                CHECK(frustum.contains(glm::vec3(150, 0, 0)));
+                CHECK_FALSE(frustum.contains(glm::vec3(0, 0, -10)));
+                CHECK(frustum.classify(glm::vec3(140, -1, -1), glm::vec3(142, 1, 1)) == Frustum::Inside);
+                CHECK(frustum.classify(glm::vec3(50, -1, -1), glm::vec3(52, 1, 1)) == Frustum::Outside);
+            }
+        }
+    }
+
+    GIVEN("A default frustum") {
+        Frustum frustum;
+
+        THEN("Everything is inside") {
+            CHECK(frustum.contains(glm::vec3(1e6f, -1e6f, 0)));
+            CHECK(frustum.classify(glm::vec3(-1, -1, -1), glm::vec3(1, 1, 1)) == Frustum::Inside);
+        }
+    }
+}
+
+SCENARIO("model bounding sphere","[frustum]") {
+
+    GIVEN("A box model") {
+        Model model;
+        model.makeBox(glm::vec3(2, 4, 6));
+        BoundingSphere sphere = model.getBoundingSphere();
+
+        THEN("The sphere is centred and reaches the corners") {
+            glm::vec3 low = model.getVertices()[0].position;
+            glm::vec3 high = low;
+            for (const Vertex &vertex : model.getVertices()) {
+                low = glm::min(low, vertex.position);
+                high = glm::max(high, vertex.position);
+                CHECK(glm::distance(sphere.center, vertex.position) <= sphere.radius + 1e-5f);
+            }
+
+            CHECK(sphere.radius == Approx(glm::distance(low, high) / 2));
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,134 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch.hpp"
+
+#include "engine/engine.hpp"
+#include "helpers.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+const Coord M = 1 << FixedPointBits;
+
+/**
+ *  One side of a lockstep simulation: a crowd of bodies plus a player
+ *  walking over generated terrain.
+ */
+class Simulation {
+    Physics mPhysics;
+    JobPool mJobs;
+    ChunkGenerator mGenerator;
+    ChunkCache mTerrain;
+    PhysicsWorld mWorld;
+    Physics::Body mPlayer;
+
+public:
+    explicit Simulation(unsigned int threads):
+        mPhysics(), mJobs(threads), mGenerator(99), mTerrain(mGenerator, 256),
+        mWorld(mPhysics), mPlayer() {
+        Random random(13579);
+
+        for (int i = 0; i < 500; i++) {
+            Physics::Body body;
+            body.setPosition(Position(random.range(-16 * M, 16 * M), random.range(-16 * M, 16 * M), random.range(-16 * M, 16 * M)));
+            body.setVelocity(Velocity(random.range(-32, 32), random.range(-32, 32), random.range(-32, 32)));
+            body.setMass(random.range(1, 50));
+            body.setBounds(i % 2 ? BoundingVolume::sphere(random.range(M/4, M)) :
+                                   BoundingVolume::box(Dimension(M/2, M/2, M/2)));
+            mWorld.add(body);
+        }
+
+        mPlayer.setPosition(Position(M/2, 40 * M, M/2));
+        mPlayer.setVelocity(Velocity(0, 0, 0));
+        mPlayer.setMass(1);
+        mPlayer.setBounds(BoundingVolume::capsule(M/4, 7*M/8));
+    }
+
+    void tick(const Velocity &walk, PhysicsWorld::Index push, const Velocity &impulse) {
+        mWorld.setVelocity(push, mWorld.getVelocity(push) + impulse);
+        mWorld.step(1, mJobs);
+
+        mPhysics.gravitate(mPlayer);
+        mPhysics.impulse(mPlayer, walk, 1);
+        mPhysics.tick(mPlayer, mTerrain);
+    }
+
+    uint64_t getStateHash() const {
+        return hashBody(mPlayer, mWorld.getStateHash());
+    }
+};
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+SCENARIO("lockstep physics","[physics][lockstep]") {
+
+    Physics physics;
+
+    GIVEN("A body stepped by ticks and by seconds") {
+        Physics::Body a;
+        a.setPosition(Position(-5, 7, 1 << 20));
+        a.setVelocity(Velocity(-300, 17, 1000));
+        a.setMass(1);
+
+        Physics::Body b(a);
+
+        for (int i = 0; i < 50; i++) {
+            physics.gravitate(a);
+            physics.tick(a);
+            physics.gravitate(b);
+            physics.update(b, sf::seconds(1));
+        }
+
+        THEN("Both agree for whole seconds") {
+            CHECK(hashBody(a) == hashBody(b));
+        }
+
+        THEN("Several ticks at once equal single ticks") {
+            Physics::Body c(a), d(a);
+            physics.impulse(c, Velocity(1, 2, 3), 4);
+            physics.tick(c, 4);
+
+            for (int i = 0; i < 4; i++) {
+                physics.impulse(d, Velocity(1, 2, 3), 1);
+            }
+            for (int i = 0; i < 4; i++) {
+                physics.tick(d);
+            }
+
+            CHECK(c.getVelocity() == d.getVelocity());
+            CHECK(c.getPosition() == d.getPosition());
+        }
+    }
+
+    GIVEN("A server and a client fed the same inputs") {
+        Simulation server(4), client(1);
+        Random inputs(24680);
+
+        REQUIRE(server.getStateHash() == client.getStateHash());
+
+        for (int tick = 0; tick < 200; tick++) {
+            Velocity walk(inputs.range(-8, 8), tick % 40 == 0 ? 40 : 0, inputs.range(-8, 8));
+            PhysicsWorld::Index push = inputs.range(0, 499);
+            Velocity impulse(inputs.range(-64, 64), inputs.range(-64, 64), inputs.range(-64, 64));
+
+            server.tick(walk, push, impulse);
+            client.tick(walk, push, impulse);
+
+            CAPTURE(tick);
+            REQUIRE(server.getStateHash() == client.getStateHash());
+        }
+
+        THEN("The final state is the same on every machine") {
+            CHECK(server.getStateHash() == 0x573172038255cb33ULL);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
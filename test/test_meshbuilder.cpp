@@ -0,0 +1,296 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch.hpp"
+
+#include "engine/engine.hpp"
+
+#include <SFML/System/Clock.hpp>
+
+#include <algorithm>
+#include <map>
+#include <thread>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+bool sameVertex(const Vertex &a, const Vertex &b) {
+    return a.position == b.position && a.normal == b.normal && a.texCoord == b.texCoord;
+}
+
+bool sameModel(const Model &a, const Model &b) {
+    const std::vector<Vertex> &va = a.getVertices();
+    const std::vector<Vertex> &vb = b.getVertices();
+
+    return a.getPrimitive() == b.getPrimitive() &&
+           a.getIndices() == b.getIndices() &&
+           va.size() == vb.size() &&
+           std::equal(va.begin(), va.end(), vb.begin(), sameVertex);
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+SCENARIO("multiple producer queue","[meshbuilder][queue]") {
+
+    GIVEN("Several threads pushing at once") {
+        static const int Threads = 4;
+        static const int Count = 20000;
+
+        MPSCQueue<int> queue;
+        std::vector<std::thread> producers;
+
+        for (int t = 0; t < Threads; t++) {
+            producers.push_back(std::thread([&queue, t] {
+                for (int i = 0; i < Count; i++) {
+                    queue.push(t * Count + i);
+                }
+            }));
+        }
+
+        // consume while the producers are still running
+        std::vector<int> last(Threads, -1);
+        size_t received = 0, misordered = 0;
+        int value;
+
+        while (received < size_t(Threads * Count)) {
+            if (queue.pop(value)) {
+                int t = value / Count;
+                misordered += value % Count <= last[t];
+                last[t] = value % Count;
+                received += 1;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+
+        for (std::thread &thread : producers) {
+            thread.join();
+        }
+
+        THEN("Every item arrives once, in order per producer") {
+            CHECK(received == size_t(Threads * Count));
+            CHECK(misordered == 0);
+            CHECK(queue.empty());
+            CHECK_FALSE(queue.pop(value));
+        }
+    }
+}
+
+SCENARIO("background mesh builder","[meshbuilder]") {
+
+    ChunkGenerator generator(9);
+    ChunkCache cache(generator, 256);
+
+    GIVEN("A builder with two workers") {
+        ChunkMesher prototype;
+        prototype.setTexRect(1, glm::vec4(0.5f, 0, 0.5f, 0.5f));
+
+        MeshBuilder builder(2, prototype, ChunkMesher::Greedy);
+        CHECK(builder.getThreadCount() == 2);
+
+        std::vector<Position> chunks;
+        for (Coord y = -1; y <= 1; y++) {
+            for (Coord x = -2; x <= 2; x++) {
+                chunks.push_back(Position(x, y, 0));
+                builder.submit(ChunkSnapshot::take(cache, chunks.back()), chunks.size());
+            }
+        }
+
+        WHEN("Every mesh is finished") {
+            builder.wait();
+
+            THEN("They match meshes built on this thread") {
+                CHECK(builder.getPendingCount() == chunks.size());
+                CHECK(builder.getFinishedCount() == chunks.size());
+
+                std::map<uint64_t, ChunkMesh> meshes;
+                ChunkMesh mesh;
+                while (builder.poll(mesh)) {
+                    meshes[mesh.version] = std::move(mesh);
+                }
+
+                CHECK(builder.getPendingCount() == 0);
+                REQUIRE(meshes.size() == chunks.size());
+
+                ChunkMesher mesher(prototype);
+                Model model;
+
+                for (size_t i = 0; i < chunks.size(); i++) {
+                    const ChunkMesh &built = meshes[i + 1];
+                    CHECK(built.position == chunks[i]);
+
+                    mesher.load(cache, chunks[i]);
+                    mesher.build(model, ChunkMesher::Greedy);
+                    CHECK(built.faces == mesher.getFaceCount());
+                    CHECK(sameModel(built.model, model));
+                }
+            }
+        }
+
+        WHEN("The same chunks are submitted by position") {
+            MeshBuilder loader(2, prototype, ChunkMesher::Greedy);
+            loader.setSource(generator, 256);
+
+            for (size_t i = 0; i < chunks.size(); i++) {
+                loader.submit(chunks[i], i + 1);
+            }
+
+            builder.wait();
+            loader.wait();
+
+            THEN("The workers load them into the same meshes") {
+                std::map<uint64_t, ChunkMesh> meshes;
+                ChunkMesh mesh;
+                while (builder.poll(mesh)) {
+                    meshes[mesh.version] = std::move(mesh);
+                }
+
+                size_t matching = 0;
+                while (loader.poll(mesh)) {
+                    const ChunkMesh &built = meshes[mesh.version];
+                    matching += mesh.position == built.position && mesh.faces == built.faces &&
+                                sameModel(mesh.model, built.model);
+                }
+
+                CHECK(matching == chunks.size());
+                CHECK(loader.getPendingCount() == 0);
+            }
+        }
+
+        WHEN("The remaining requests are cancelled") {
+            builder.cancel();
+            builder.wait();
+
+            THEN("Only the meshes already started are delivered") {
+                size_t delivered = 0;
+                ChunkMesh mesh;
+                while (builder.poll(mesh)) {
+                    delivered += 1;
+                }
+
+                CHECK(delivered <= chunks.size());
+                CHECK(builder.getPendingCount() == 0);
+            }
+        }
+    }
+
+    GIVEN("A snapshot taken before the chunk changes") {
+        Position chunk(0, 0, 0);
+        ChunkSnapshot snapshot = ChunkSnapshot::take(cache, chunk);
+
+        ChunkData &data = *cache.getChunk(chunk)->getData();
+        BlockType before = data.getType(Position(3, 3, 3));
+        data.getBlock(Position(3, 3, 3)).setType(before == 0 ? 1 : 0);
+
+        THEN("The snapshot keeps the old blocks") {
+            CHECK(snapshot.chunk->getType(Position(3, 3, 3)) == before);
+            CHECK(snapshot.position == chunk);
+            for (const std::shared_ptr<const ChunkBorder> &border : snapshot.borders) {
+                CHECK(border);
+            }
+        }
+
+        THEN("Each border is the layer of the neighbour touching the chunk") {
+            const ChunkData &east = *cache.getChunk(Position(1, 0, 0))->getData();
+            const ChunkData &top = *cache.getChunk(Position(0, 1, 0))->getData();
+            const ChunkBorder &eastBorder = *snapshot.borders[int(BlockFace::East) - 1];
+            const ChunkBorder &topBorder = *snapshot.borders[int(BlockFace::Top) - 1];
+
+            size_t mismatches = 0;
+            for (unsigned int v = 0; v < ChunkData::Count; v++) {
+                for (unsigned int u = 0; u < ChunkData::Count; u++) {
+                    size_t i = u + v * ChunkData::Count;
+                    mismatches += eastBorder.types[i] != east.getType(Position(0, u, v));
+                    mismatches += topBorder.types[i] != top.getType(Position(u, 0, v));
+                }
+            }
+
+            CHECK(mismatches == 0);
+        }
+    }
+
+    GIVEN("An upload budget of 1000 bytes") {
+        UploadBudget budget(1000, sf::seconds(10));
+        budget.reset();
+
+        THEN("The first upload is allowed whatever its size") {
+            CHECK(budget.allows(5000));
+            budget.spend(5000);
+            CHECK_FALSE(budget.allows(1));
+        }
+
+        THEN("Uploads are allowed until the bytes run out") {
+            CHECK(budget.allows(400));
+            budget.spend(400);
+            CHECK(budget.allows(600));
+            budget.spend(600);
+            CHECK_FALSE(budget.allows(1));
+            CHECK(budget.getUploads() == 2);
+
+            budget.reset();
+            CHECK(budget.allows(1000));
+            CHECK(budget.getBytes() == 0);
+        }
+    }
+
+    GIVEN("An upload budget with no time") {
+        UploadBudget budget(1000, sf::Time::Zero);
+        budget.reset();
+        budget.spend(1);
+
+        THEN("Only the first upload is allowed") {
+            CHECK_FALSE(budget.allows(1));
+        }
+    }
+}
+
+TEST_CASE("mesh builder benchmark","[.][benchmark][meshbuilder]") {
+    static const int Radius = 4;
+
+    ChunkGenerator generator(3);
+    ChunkCache cache(generator, 4096);
+
+    std::vector<ChunkSnapshot> snapshots;
+    for (Coord z = -Radius; z < Radius; z++) {
+        for (Coord y = -1; y <= 1; y++) {
+            for (Coord x = -Radius; x < Radius; x++) {
+                snapshots.push_back(ChunkSnapshot::take(cache, Position(x, y, z)));
+            }
+        }
+    }
+
+    MeshBuilder builder;
+    sf::Clock clock;
+    sf::Time longestPoll;
+    size_t vertices = 0;
+
+    for (const ChunkSnapshot &snapshot : snapshots) {
+        builder.submit(snapshot);
+    }
+
+    // stands in for the render loop, which only ever polls
+    ChunkMesh mesh;
+    while (builder.getPendingCount() > 0) {
+        sf::Clock poll;
+        if (builder.poll(mesh)) {
+            vertices += mesh.model.getVertices().size();
+            longestPoll = std::max(longestPoll, poll.getElapsedTime());
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    float seconds = clock.getElapsedTime().asSeconds();
+
+    WARN(builder.getThreadCount() << " workers: " << snapshots.size() / seconds << " chunks/s, " <<
+         vertices / snapshots.size() << " vertices/chunk, longest poll " <<
+         longestPoll.asMicroseconds() << " us");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,427 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch.hpp"
+
+#include "engine/engine.hpp"
+
+#include <SFML/System/Clock.hpp>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+const BlockType Stone = 1;
+const BlockType Glass = 201;
+const BlockType Water = 202;
+
+void setBlock(ChunkData &data, Coord x, Coord y, Coord z, BlockType type) {
+    data.getBlock(Position(x, y, z)).setType(type);
+}
+
+/**
+ *  Checks that every triangle faces along its vertex normals, and counts
+ *  the triangles.
+ */
+size_t checkWinding(const Model &model) {
+    const std::vector<Vertex> &vertices = model.getVertices();
+    const std::vector<uint32_t> &indices = model.getIndices();
+    size_t count = indices.empty() ? vertices.size() : indices.size();
+    size_t wrong = 0;
+
+    for (size_t i = 0; i < count; i += 3) {
+        const Vertex *v[3];
+        for (size_t j = 0; j < 3; j++) {
+            v[j] = &vertices[indices.empty() ? i + j : indices[i + j]];
+        }
+
+        glm::vec3 normal = glm::cross(v[1]->position - v[0]->position, v[2]->position - v[0]->position);
+        if (glm::dot(normal, v[0]->normal) <= 0) {
+            wrong += 1;
+        }
+    }
+
+    CHECK(wrong == 0);
+    return count / 3;
+}
+
+/**
+ *  Sums the area of the quads facing along each axis direction, in BlockFace
+ *  order; quads are the four vertices of each face, as the mesher adds them.
+ */
+std::vector<float> getAreas(const Model &model) {
+    std::vector<float> areas(6);
+    const std::vector<Vertex> &vertices = model.getVertices();
+
+    for (size_t q = 0; q + 3 < vertices.size(); q += 4) {
+        const Vertex *v = &vertices[q];
+        glm::vec3 n = v->normal;
+        int face = n.x < 0 ? 0 : n.x > 0 ? 1 : n.y < 0 ? 2 : n.y > 0 ? 3 : n.z < 0 ? 4 : 5;
+        areas[face] += glm::length(glm::cross(v[1].position - v[0].position, v[3].position - v[0].position));
+    }
+
+    return areas;
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+SCENARIO("chunk mesher","[mesher]") {
+
+    Block::enlist(Glass, "test glass", Block::Attributes::Transparent);
+    Block::enlist(Water, "test water", Block::Attributes(
+        uint8_t(Block::Attributes::Transparent) | uint8_t(Block::Attributes::Passable)
+    ));
+
+    ChunkMesher mesher;
+    ChunkData data;
+    ChunkData air;
+    Model model;
+
+    const ChunkData *airAround[6] = { &air, &air, &air, &air, &air, &air };
+
+    GIVEN("A single block") {
+        setBlock(data, 5, 6, 7, Stone);
+        mesher.setTexRect(Stone, glm::vec4(0.5f, 0.25f, 0.125f, 0.25f));
+        mesher.load(data, airAround);
+        mesher.build(model);
+
+        THEN("All six faces are emitted, facing outward") {
+            CHECK(mesher.getFaceCount() == 6);
+            CHECK(model.getPrimitive() == GLTriangles);
+            CHECK(model.getVertices().size() == 24);
+            CHECK(model.getIndices().size() == 36);
+            CHECK(checkWinding(model) == 12);
+
+            for (const Vertex &vertex : model.getVertices()) {
+                CHECK(vertex.position.x >= 5);
+                CHECK(vertex.position.x <= 6);
+                CHECK(vertex.position.y >= 6);
+                CHECK(vertex.position.y <= 7);
+                CHECK(vertex.position.z >= 7);
+                CHECK(vertex.position.z <= 8);
+                CHECK(vertex.texCoord.x >= 0.5f);
+                CHECK(vertex.texCoord.x <= 0.625f);
+                CHECK(vertex.texCoord.y >= 0.25f);
+                CHECK(vertex.texCoord.y <= 0.5f);
+            }
+        }
+
+        WHEN("A neighbouring block is added") {
+            setBlock(data, 6, 6, 7, Stone);
+            mesher.load(data, airAround);
+            mesher.build(model);
+
+            THEN("The shared faces are culled") {
+                CHECK(mesher.getFaceCount() == 10);
+            }
+        }
+    }
+
+    GIVEN("A full chunk") {
+        for (Coord z = 0; z < 16; z++) {
+            for (Coord y = 0; y < 16; y++) {
+                for (Coord x = 0; x < 16; x++) {
+                    setBlock(data, x, y, z, Stone);
+                }
+            }
+        }
+
+        THEN("Only faces toward transparent neighbours are emitted") {
+            mesher.load(data, airAround);
+            mesher.build(model);
+            CHECK(mesher.getFaceCount() == 6 * 16 * 16);
+
+            const ChunkData *someAir[6] = { &data, &air, &data, nullptr, &data, &data };
+            mesher.load(data, someAir);
+            mesher.build(model);
+            CHECK(mesher.getFaceCount() == 16 * 16);
+
+            for (const Vertex &vertex : model.getVertices()) {
+                CHECK(vertex.position.x == 16);
+                CHECK(vertex.normal == glm::vec3(1, 0, 0));
+            }
+        }
+
+        THEN("Missing neighbours count as opaque") {
+            mesher.load(data, nullptr);
+            mesher.build(model);
+            CHECK(mesher.getFaceCount() == 0);
+            CHECK(model.getVertices().empty());
+        }
+    }
+
+    GIVEN("Glass and water beside stone") {
+        setBlock(data, 4, 4, 4, Stone);
+        setBlock(data, 5, 4, 4, Glass);
+        setBlock(data, 6, 4, 4, Glass);
+        setBlock(data, 4, 5, 4, Water);
+        setBlock(data, 4, 6, 4, Water);
+
+        mesher.load(data, airAround);
+        mesher.build(model);
+
+        THEN("Stone shows through them, but they hide nothing between their own kind") {
+            // stone: all 6; glass and water: 6 each, less the face toward
+            // stone and the two faces between blocks of a kind
+            CHECK(mesher.getFaceCount() == 6 + (6 + 6 - 3) + (6 + 6 - 3));
+            checkWinding(model);
+        }
+    }
+
+    GIVEN("A checkerboard of glass and water") {
+        for (Coord z = 0; z < 16; z++) {
+            for (Coord y = 0; y < 16; y++) {
+                for (Coord x = 0; x < 16; x++) {
+                    setBlock(data, x, y, z, (x + y + z) % 2 ? Glass : Water);
+                }
+            }
+        }
+
+        mesher.load(data, airAround);
+        mesher.build(model);
+
+        THEN("Too many vertices for 16-bit indices are drawn with 32-bit ones") {
+            CHECK(mesher.getFaceCount() == 6 * 16 * 16 * 16);
+            CHECK(model.getVertices().size() == mesher.getFaceCount() * 4);
+            CHECK(model.getIndexType() == GLUnsignedInt);
+            CHECK(checkWinding(model) == mesher.getFaceCount() * 2);
+
+            PackedModel packed;
+            mesher.build(packed);
+            CHECK(packed.getIndexType() == GLUnsignedInt);
+            CHECK(packed.getIndices().size() == model.getIndices().size());
+        }
+    }
+
+    GIVEN("Generated terrain in a cache") {
+        ChunkGenerator generator(11);
+        ChunkCache cache(generator, 64);
+
+        size_t faces = 0;
+        for (Coord y = -2; y <= 2; y++) {
+            mesher.load(cache, Position(0, y, 0));
+            mesher.build(model);
+            checkWinding(model);
+            faces += mesher.getFaceCount();
+        }
+
+        THEN("The surface is meshed once across chunk borders") {
+            // each column shows at least its top face
+            CHECK(faces >= 16 * 16);
+            CHECK(faces < 16 * 16 * 6);
+        }
+    }
+
+    GIVEN("A full chunk meshed greedily") {
+        for (Coord z = 0; z < 16; z++) {
+            for (Coord y = 0; y < 16; y++) {
+                for (Coord x = 0; x < 16; x++) {
+                    setBlock(data, x, y, z, Stone);
+                }
+            }
+        }
+
+        mesher.load(data, airAround);
+        mesher.build(model, ChunkMesher::Greedy);
+
+        THEN("Each side is one quad, with the texture repeated per block") {
+            CHECK(mesher.getFaceCount() == 6 * 16 * 16);
+            CHECK(mesher.getQuadCount() == 6);
+            CHECK(model.getVertices().size() == 24);
+            CHECK(checkWinding(model) == 12);
+
+            for (const Vertex &vertex : model.getVertices()) {
+                CHECK((vertex.texCoord.x == 0 || vertex.texCoord.x == 16));
+                CHECK((vertex.texCoord.y == 0 || vertex.texCoord.y == 16));
+            }
+        }
+    }
+
+    GIVEN("Generated terrain meshed both ways") {
+        ChunkGenerator generator(5);
+        ChunkCache cache(generator, 64);
+
+        for (Coord y = -1; y <= 1; y++) {
+            CAPTURE(y);
+
+            mesher.load(cache, Position(1, y, -1));
+            mesher.build(model, ChunkMesher::Culled);
+            size_t faces = mesher.getFaceCount();
+            std::vector<float> culledAreas = getAreas(model);
+
+            Model greedy;
+            mesher.build(greedy, ChunkMesher::Greedy);
+
+            THEN("Greedy quads cover exactly the culled faces, in fewer vertices") {
+                CHECK(mesher.getFaceCount() == faces);
+                CHECK(mesher.getQuadCount() <= faces);
+                CHECK(greedy.getVertices().size() == mesher.getQuadCount() * 4);
+                CHECK(getAreas(greedy) == culledAreas);
+                checkWinding(greedy);
+            }
+        }
+    }
+
+    GIVEN("A single block in packed vertices") {
+        setBlock(data, 5, 5, 5, Stone);
+        mesher.setTile(Stone, 7);
+        mesher.load(data, airAround);
+
+        PackedModel packed;
+        mesher.build(packed);
+
+        THEN("Each face has four vertices, open and fully lit") {
+            CHECK(sizeof(PackedVertex) == 8);
+            CHECK(packed.getVertices().size() == 24);
+            CHECK(packed.getIndices().size() == 36);
+
+            for (size_t i = 0; i < packed.getVertices().size(); i++) {
+                const PackedVertex &vertex = packed.getVertices()[i];
+                CHECK(vertex.getFace() == int(i / 4));
+                CHECK(vertex.getOcclusion() == 3);
+                CHECK(vertex.tile == 7);
+                CHECK(vertex.light == 255);
+            }
+        }
+
+        WHEN("A block stands above and east of it") {
+            setBlock(data, 6, 6, 5, Stone);
+            mesher.load(data, airAround);
+            mesher.build(packed);
+
+            THEN("The east corners of its top face are occluded") {
+                size_t top = 0;
+                for (const PackedVertex &vertex : packed.getVertices()) {
+                    if (vertex.getFace() == 3 && vertex.y == 6 && vertex.x <= 6) {
+                        CHECK(vertex.getOcclusion() == (vertex.x == 6 ? 2 : 3));
+                        top += 1;
+                    }
+                }
+                CHECK(top == 4);
+            }
+        }
+    }
+
+    GIVEN("Generated terrain in full and packed vertices") {
+        ChunkGenerator generator(13);
+        ChunkCache cache(generator, 64);
+
+        for (Coord y = -1; y <= 1; y++) {
+            CAPTURE(y);
+
+            mesher.load(cache, Position(0, y, 2));
+
+            mesher.build(model);
+            size_t faces = mesher.getFaceCount();
+
+            PackedModel packed;
+            mesher.build(packed);
+
+            THEN("Culled meshes have the same faces and positions") {
+                REQUIRE(packed.getVertices().size() == model.getVertices().size());
+                CHECK(packed.getIndices().size() == model.getIndices().size());
+
+                size_t mismatched = 0;
+                for (size_t i = 0; i < model.getVertices().size(); i++) {
+                    const Vertex &full = model.getVertices()[i];
+                    const PackedVertex &small = packed.getVertices()[i];
+                    mismatched += full.position != glm::vec3(small.x, small.y, small.z);
+                }
+                CHECK(mismatched == 0);
+            }
+
+            PackedModel greedy;
+            mesher.build(greedy, ChunkMesher::Greedy);
+            size_t packedQuads = mesher.getQuadCount();
+
+            mesher.build(model, ChunkMesher::Greedy);
+
+            THEN("Greedy packed meshes merge only alike faces") {
+                CHECK(mesher.getFaceCount() == faces);
+                CHECK(packedQuads >= mesher.getQuadCount());
+                CHECK(packedQuads <= faces);
+                CHECK(greedy.getVertices().size() == packedQuads * 4);
+            }
+        }
+    }
+
+    Block::delist(Glass);
+    Block::delist(Water);
+}
+
+TEST_CASE("chunk mesher benchmark","[.][benchmark][mesher]") {
+    static const int Radius = 4;
+
+    ChunkGenerator generator(3);
+    ChunkCache cache(generator, 4096);
+    ChunkMesher mesher;
+    Model model;
+
+    // load the chunks before timing
+    for (Coord z = -Radius; z <= Radius; z++) {
+        for (Coord y = -2; y <= 2; y++) {
+            for (Coord x = -Radius; x <= Radius; x++) {
+                cache.getChunk(Position(x, y, z));
+            }
+        }
+    }
+
+    ChunkMesher::Mode modes[] = { ChunkMesher::Culled, ChunkMesher::Greedy };
+
+    for (ChunkMesher::Mode mode : modes) {
+        size_t chunks = 0, vertices = 0, triangles = 0;
+        sf::Clock clock;
+
+        for (int pass = 0; pass < 4; pass++) {
+            for (Coord z = -Radius + 1; z < Radius; z++) {
+                for (Coord y = -1; y <= 1; y++) {
+                    for (Coord x = -Radius + 1; x < Radius; x++) {
+                        mesher.load(cache, Position(x, y, z));
+                        mesher.build(model, mode);
+                        chunks += 1;
+                        vertices += model.getVertices().size();
+                        triangles += model.getIndices().size() / 3;
+                    }
+                }
+            }
+        }
+
+        float seconds = clock.getElapsedTime().asSeconds();
+
+        WARN((mode == ChunkMesher::Greedy ? "greedy: " : "culled: ") <<
+             chunks / seconds << " chunks/s (" << seconds * 1000000.0f / chunks << " us/chunk), " <<
+             vertices / chunks << " vertices/chunk, " << triangles / chunks << " triangles/chunk");
+    }
+
+    // the bytes each chunk takes on the GPU, and so to upload
+    for (ChunkMesher::Mode mode : modes) {
+        size_t chunks = 0, fullBytes = 0, packedBytes = 0;
+        PackedModel packed;
+        sf::Clock clock;
+
+        for (Coord z = -Radius + 1; z < Radius; z++) {
+            for (Coord y = -1; y <= 1; y++) {
+                for (Coord x = -Radius + 1; x < Radius; x++) {
+                    mesher.load(cache, Position(x, y, z));
+                    mesher.build(packed, mode);
+                    chunks += 1;
+                    packedBytes += packed.getVertices().size() * sizeof(PackedVertex) + packed.getIndexBytes();
+
+                    mesher.build(model, mode);
+                    fullBytes += model.getVertices().size() * sizeof(Vertex) + model.getIndexBytes();
+                }
+            }
+        }
+
+        WARN((mode == ChunkMesher::Greedy ? "greedy: " : "culled: ") <<
+             fullBytes / chunks << " bytes/chunk full, " << packedBytes / chunks << " bytes/chunk packed (" <<
+             100.0f * packedBytes / fullBytes << "%)");
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
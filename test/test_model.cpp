@@ -0,0 +1,237 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch.hpp"
+
+#include "engine/engine.hpp"
+
+#include <SFML/System/Clock.hpp>
+
+#include <algorithm>
+#include <array>
+#include <tuple>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+typedef std::tuple<float, float, float> Point;
+typedef std::array<Point, 3> Triangle;
+
+/**
+ *  Gets a model's triangles by position, each rotated to start at its
+ *  least corner (keeping its winding), sorted.
+ */
+std::vector<Triangle> getTriangles(const Model &model) {
+    const std::vector<Vertex> &vertices = model.getVertices();
+    const std::vector<uint32_t> &indices = model.getIndices();
+    size_t count = indices.empty() ? vertices.size() : indices.size();
+
+    std::vector<Triangle> triangles;
+    for (size_t i = 0; i + 2 < count; i += 3) {
+        Triangle triangle;
+        for (size_t j = 0; j < 3; j++) {
+            const glm::vec3 &p = vertices[indices.empty() ? i + j : indices[i + j]].position;
+            triangle[j] = Point(p.x, p.y, p.z);
+        }
+        std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+        triangles.push_back(triangle);
+    }
+
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+/**
+ *  Builds a flat grid of unindexed quads, n by n.
+ */
+void makeGrid(Model &model, int n) {
+    model = Model(GLTriangles);
+    glm::vec3 up(0, 1, 0);
+
+    for (int z = 0; z < n; z++) {
+        for (int x = 0; x < n; x++) {
+            model.addQuad(
+                Vertex(up, glm::vec3(x, 0, z)),
+                Vertex(up, glm::vec3(x, 0, z + 1)),
+                Vertex(up, glm::vec3(x + 1, 0, z + 1)),
+                Vertex(up, glm::vec3(x + 1, 0, z))
+            );
+        }
+    }
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+SCENARIO("model index width","[model]") {
+
+    Model model;
+
+    GIVEN("A box") {
+        model.makeBox(glm::vec3(1, 1, 1));
+
+        THEN("Its indices are drawn 16 bits wide") {
+            CHECK(model.getVertices().size() == 24);
+            CHECK(model.getIndexType() == GLUnsignedShort);
+            CHECK(model.getIndexBytes() == 36 * sizeof(uint16_t));
+
+            std::vector<uint16_t> narrow(36);
+            model.writeIndices(narrow.data());
+            CHECK(std::equal(narrow.begin(), narrow.end(), model.getIndices().begin()));
+        }
+
+        WHEN("32-bit indices are asked for") {
+            model.setIndexType(GLUnsignedInt);
+
+            THEN("They are kept wide") {
+                CHECK(model.getIndexType() == GLUnsignedInt);
+                CHECK(model.getIndexBytes() == 36 * sizeof(uint32_t));
+
+                std::vector<uint32_t> wide(36);
+                model.writeIndices(wide.data());
+                CHECK(wide == model.getIndices());
+            }
+        }
+    }
+
+    GIVEN("A ball with more vertices than 16-bit indices reach") {
+        model.makeBall(1, 256);
+
+        THEN("Its indices are drawn 32 bits wide, without wrapping") {
+            CHECK(model.getVertices().size() > 65536);
+            CHECK(model.getIndexType() == GLUnsignedInt);
+
+            uint32_t last = *std::max_element(model.getIndices().begin(), model.getIndices().end());
+            CHECK(last == model.getVertices().size() - 1);
+
+            std::vector<uint32_t> wide(model.getIndices().size());
+            model.writeIndices(wide.data());
+            CHECK(wide == model.getIndices());
+        }
+
+        WHEN("16-bit indices are asked for") {
+            model.setIndexType(GLUnsignedShort);
+
+            THEN("They are still widened") {
+                CHECK(model.getIndexType() == GLUnsignedInt);
+            }
+        }
+    }
+}
+
+SCENARIO("model optimization","[model]") {
+
+    Model model;
+
+    GIVEN("A grid of unindexed quads") {
+        makeGrid(model, 10);
+        std::vector<Triangle> before = getTriangles(model);
+
+        WHEN("Its vertices are welded") {
+            size_t removed = model.weldVertices();
+
+            THEN("Each corner is shared") {
+                CHECK(removed == 600 - 121);
+                CHECK(model.getVertices().size() == 121);
+                CHECK(model.getIndices().size() == 600);
+                CHECK(getTriangles(model) == before);
+            }
+        }
+
+        WHEN("It is optimized") {
+            MeshStats original = model.getStats();
+            model.optimize();
+            MeshStats optimized = model.getStats();
+
+            THEN("It draws the same triangles with fewer cache misses") {
+                CHECK(getTriangles(model) == before);
+                CHECK(original.acmr == 3);
+                CHECK(optimized.triangles == 200);
+                CHECK(optimized.acmr < 1);
+                CHECK(optimized.atvr < 1.5f);
+            }
+
+            THEN("Vertices are in the order the indices first use them") {
+                uint32_t next = 0;
+                for (uint32_t index : model.getIndices()) {
+                    CHECK(index <= next);
+                    next = std::max(next, index + 1);
+                }
+                CHECK(next == model.getVertices().size());
+            }
+        }
+    }
+
+    GIVEN("A ball, with duplicate vertices at its seam and poles") {
+        model.makeBall(1, 24);
+        size_t vertices = model.getVertices().size();
+
+        WHEN("Near vertices are welded") {
+            model.weldVertices(1.0f / 1024);
+
+            THEN("The duplicates and degenerate triangles are gone") {
+                CHECK(model.getVertices().size() < vertices);
+                CHECK(model.getVertices().size() == 23 * 48 + 2);
+
+                const std::vector<uint32_t> &indices = model.getIndices();
+                size_t degenerate = 0;
+                for (size_t i = 0; i < indices.size(); i += 3) {
+                    degenerate += indices[i] == indices[i + 1] || indices[i + 1] == indices[i + 2] || indices[i] == indices[i + 2];
+                }
+                CHECK(degenerate == 0);
+            }
+
+            AND_WHEN("It is reordered") {
+                std::vector<Triangle> before = getTriangles(model);
+                MeshStats original = model.getStats();
+                model.optimizeVertexCache();
+                model.optimizeVertexFetch();
+
+                THEN("The triangles are kept, with fewer cache misses") {
+                    CHECK(getTriangles(model) == before);
+                    CHECK(model.getStats().acmr < original.acmr);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("model optimization benchmark","[.][benchmark][model]") {
+    Model grid;
+    makeGrid(grid, 100);
+
+    Model ball;
+    ball.makeBall(1, 128);
+
+    Model box;
+    box.makeBox(glm::vec3(1, 1, 1));
+
+    std::pair<const char *, Model *> models[] = {
+        { "grid", &grid }, { "ball", &ball }, { "box", &box }
+    };
+
+    for (auto &named : models) {
+        Model &model = *named.second;
+        MeshStats before = model.getStats();
+
+        sf::Clock clock;
+        model.weldVertices(1.0f / 4096);
+        model.optimizeVertexCache();
+        model.optimizeVertexFetch();
+        float seconds = clock.getElapsedTime().asSeconds();
+
+        MeshStats after = model.getStats();
+
+        WARN(named.first << ": " << before.vertices << " -> " << after.vertices << " vertices, " <<
+             before.triangles << " -> " << after.triangles << " triangles, ACMR " <<
+             before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr <<
+             " in " << seconds * 1000 << " ms");
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,274 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch.hpp"
+
+#include "engine/engine.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ *  Wraps a link, dropping and delaying outgoing datagrams.
+ */
+class SimulatedLink : public DatagramLink {
+    DatagramLink &mLink;
+    unsigned int mLossPercent;
+    unsigned int mMaxLatency;
+    uint32_t mRandom;
+    uint32_t mTick;
+    std::multimap<uint32_t, std::vector<uint8_t>> mInFlight;
+
+    uint32_t random() {
+        mRandom = mRandom * 1103515245 + 12345;
+        return mRandom >> 16;
+    }
+
+public:
+    SimulatedLink(
+        DatagramLink &link,
+        unsigned int lossPercent,
+        unsigned int maxLatency
+    ): mLink(link), mLossPercent(lossPercent), mMaxLatency(maxLatency),
+       mRandom(1), mTick() {
+    }
+
+    bool send(const uint8_t *data, size_t size) {
+        if (random() % 100 < mLossPercent) {
+            return true;
+        }
+        uint32_t due = mTick + random() % (mMaxLatency + 1);
+        mInFlight.insert({due, std::vector<uint8_t>(data, data + size)});
+        return true;
+    }
+
+    bool receive(uint8_t *data, size_t capacity, size_t &size) {
+        return mLink.receive(data, capacity, size);
+    }
+
+    void advance() {
+        mTick += 1;
+        while (!mInFlight.empty() && mInFlight.begin()->first <= mTick) {
+            const std::vector<uint8_t> &datagram = mInFlight.begin()->second;
+            mLink.send(datagram.data(), datagram.size());
+            mInFlight.erase(mInFlight.begin());
+        }
+    }
+};
+
+/**
+ *  Delivers datagrams to itself, in order and without loss.
+ */
+class LoopbackLink : public DatagramLink {
+    std::deque<std::vector<uint8_t>> mQueue;
+
+public:
+    bool send(const uint8_t *data, size_t size) {
+        mQueue.push_back(std::vector<uint8_t>(data, data + size));
+        return true;
+    }
+
+    bool receive(uint8_t *data, size_t capacity, size_t &size) {
+        if (mQueue.empty() || mQueue.front().size() > capacity) {
+            return false;
+        }
+        size = mQueue.front().size();
+        std::copy(mQueue.front().begin(), mQueue.front().end(), data);
+        mQueue.pop_front();
+        return true;
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+SCENARIO("network","[network]") {
+
+    GIVEN("Sequence numbers near wraparound") {
+        CHECK(isSequenceNewer(1, 0));
+        CHECK_FALSE(isSequenceNewer(0, 1));
+        CHECK_FALSE(isSequenceNewer(7, 7));
+        CHECK(isSequenceNewer(0, 65535));
+        CHECK(isSequenceNewer(10, 65530));
+        CHECK_FALSE(isSequenceNewer(65530, 10));
+    }
+
+    GIVEN("Packet types") {
+        CHECK(getPacketChannel(PacketType::PlayerMove) == PacketChannel::Unreliable);
+        CHECK(getPacketChannel(PacketType::PlayerLook) == PacketChannel::Unreliable);
+        CHECK(getPacketChannel(PacketType::EntityMove) == PacketChannel::Unreliable);
+        CHECK(getPacketChannel(PacketType::EntityLook) == PacketChannel::Unreliable);
+        CHECK(getPacketChannel(PacketType::ChunkSingle) == PacketChannel::Reliable);
+        CHECK(getPacketChannel(PacketType::PlayerChat) == PacketChannel::Reliable);
+        CHECK(getPacketChannel(PacketType::EntityMoveTo) == PacketChannel::Reliable);
+    }
+
+    GIVEN("Movement updates of each type") {
+        PacketType types[] = {
+            PacketType::PlayerMove, PacketType::PlayerLook,
+            PacketType::EntityMove, PacketType::EntityLook
+        };
+
+        for (PacketType type : types) {
+            MovementUpdate in, out;
+            in.type = type;
+            in.sequence = 0xbeef;
+            in.id = 0x0123456789abcdefULL;
+            in.delta = Velocity(-300, 2, 32767);
+            in.look = Orientation(Angle::fromByte(-128), Angle::fromByte(33));
+
+            uint8_t buffer[MaxMovementDatagramSize];
+            size_t size = encodeMovementUpdate(in, buffer);
+            CAPTURE(size);
+
+            REQUIRE(size > 0);
+            REQUIRE(size <= MaxMovementDatagramSize);
+            REQUIRE(decodeMovementUpdate(buffer, size, out));
+            CHECK_FALSE(decodeMovementUpdate(buffer, size - 1, out));
+
+            CHECK(out.type == in.type);
+            CHECK(out.sequence == in.sequence);
+
+            if (type == PacketType::EntityMove || type == PacketType::EntityLook) {
+                CHECK(out.id == in.id);
+            } else {
+                CHECK(out.id == 0);
+            }
+
+            if (type == PacketType::PlayerMove || type == PacketType::EntityMove) {
+                CHECK(out.delta == in.delta);
+            } else {
+                CHECK(out.look.x == in.look.x);
+                CHECK(out.look.y == in.look.y);
+            }
+        }
+
+        MovementUpdate chat;
+        chat.type = PacketType::PlayerChat;
+        uint8_t buffer[MaxMovementDatagramSize];
+        CHECK(encodeMovementUpdate(chat, buffer) == 0);
+    }
+
+    GIVEN("A loopback UDP link with 20% loss and up to 4 ticks of latency") {
+        static const unsigned int Loss = 20;
+        static const unsigned int MaxLatency = 4;
+        static const uint32_t Ticks = 1000;
+
+        UdpLink server, client;
+        REQUIRE(server.bind());
+        REQUIRE(client.bind());
+        server.setRemote(sf::IpAddress::LocalHost, client.getLocalPort());
+        client.setRemote(sf::IpAddress::LocalHost, server.getLocalPort());
+
+        SimulatedLink lossy(server, Loss, MaxLatency);
+        MovementChannel sender(lossy);
+        MovementChannel receiver(client);
+
+        size_t sent = 0;
+        std::map<PacketType, SequenceNumber> lastSequence;
+        std::map<PacketType, uint32_t> lastTick;
+        uint64_t totalAge = 0;
+        uint32_t maxAge = 0;
+        size_t received = 0;
+        bool ordered = true;
+
+        for (uint32_t tick = 0; tick < Ticks; tick++) {
+            MovementUpdate move;
+            move.type = PacketType::EntityMove;
+            move.id = 42;
+            move.delta = Velocity(1, 0, 0);
+            REQUIRE(sender.send(move));
+            sent += 1;
+
+            MovementUpdate look;
+            look.type = PacketType::EntityLook;
+            look.id = 42;
+            look.look = Orientation(Angle::fromByte(tick), Angle::Zero);
+            REQUIRE(sender.send(look));
+            sent += 1;
+
+            lossy.advance();
+
+            MovementUpdate update;
+            while (receiver.receive(update)) {
+                auto last = lastSequence.find(update.type);
+                if (last != lastSequence.end() && !isSequenceNewer(update.sequence, last->second)) {
+                    ordered = false;
+                }
+                lastSequence[update.type] = update.sequence;
+                // each stream sends once a tick, from sequence 0
+                lastTick[update.type] = update.sequence;
+                received += 1;
+            }
+
+            // staleness: age of the freshest position known to the receiver
+            if (lastTick.count(PacketType::EntityMove)) {
+                uint32_t age = tick - lastTick[PacketType::EntityMove];
+                totalAge += age;
+                if (age > maxAge) {
+                    maxAge = age;
+                }
+            }
+        }
+
+        float meanAge = float(totalAge) / Ticks;
+
+        WARN("received " << received << " of " << sent <<
+             " updates, dropped " << receiver.getStaleCount() << " stale; " <<
+             "staleness mean " << meanAge << " ticks, max " << maxAge << " ticks");
+
+        CHECK(ordered);
+        CHECK(receiver.getInvalidCount() == 0);
+        CHECK(received + receiver.getStaleCount() <= sent);
+        CHECK(received > sent / 2);
+        CHECK(receiver.getStaleCount() > 0);
+        CHECK(meanAge < MaxLatency);
+    }
+
+    GIVEN("Many entities moving while one stays idle") {
+        LoopbackLink link;
+        MovementChannel sender(link);
+        MovementChannel receiver(link);
+
+        MovementUpdate idle;
+        idle.type = PacketType::EntityMove;
+        idle.id = 1;
+        REQUIRE(sender.send(idle));
+
+        MovementUpdate update;
+        REQUIRE(receiver.receive(update));
+        CHECK(update.id == 1);
+
+        // more updates than half the sequence space, spread over other entities
+        size_t received = 0;
+        for (int i = 0; i < 40000; i++) {
+            MovementUpdate move;
+            move.type = PacketType::EntityMove;
+            move.id = 2 + i % 8;
+            REQUIRE(sender.send(move));
+            received += receiver.receive(update);
+        }
+
+        THEN("Each stream keeps its own sequence") {
+            CHECK(received == 40000);
+            CHECK(update.sequence == 40000 / 8 - 1);
+        }
+
+        THEN("The idle entity's next update is still newer") {
+            idle.delta = Velocity(1, 0, 0);
+            REQUIRE(sender.send(idle));
+            CHECK(idle.sequence == 1);
+            REQUIRE(receiver.receive(update));
+            CHECK(update.id == 1);
+            CHECK(update.delta.x == 1);
+            CHECK(receiver.getStaleCount() == 0);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -6,6 +6,53 @@
 
 #include "engine/engine.hpp"
 
+#include <SFML/System/Clock.hpp>
+
+#include <cmath>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+typedef Physics::CollisionType CollisionType;
+
+BoundingVolume makeShape(int type) {
+    switch (type) {
+        case 0:  return BoundingVolume::box(Dimension(128, 160, 112));
+        case 1:  return BoundingVolume::sphere(128);
+        default: return BoundingVolume::capsule(96, 256);
+    }
+}
+
+Coord component(const Dimension &d, int axis) {
+    return axis == 0 ? d.x : axis == 1 ? d.y : d.z;
+}
+
+/**
+ *  Expected result for shapes whose touching distance along an axis is t.
+ */
+CollisionType expected(Coord i, Coord t) {
+    if (i > t + Physics::Epsilon) {
+        return CollisionType::None;
+    } else if (i >= t - Physics::Epsilon) {
+        return CollisionType::Contact;
+    } else {
+        return CollisionType::Intrusion;
+    }
+}
+
+CollisionType expected(double distance, double radius) {
+    if (distance > radius + Physics::Epsilon) {
+        return CollisionType::None;
+    } else if (distance >= radius - Physics::Epsilon) {
+        return CollisionType::Contact;
+    } else {
+        return CollisionType::Intrusion;
+    }
+}
+
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 SCENARIO("physics","[physics]") {
@@ -96,6 +143,129 @@ SCENARIO("physics","[physics]") {
         }
 
     }
+
+    GIVEN("Every pairing of box, sphere and capsule") {
+        static const char *Names[] = {"box", "sphere", "capsule"};
+
+        for (int ta = 0; ta < 3; ta++) {
+            for (int tb = 0; tb < 3; tb++) {
+                Physics::Body a, b;
+                a.setBounds(makeShape(ta));
+                b.setBounds(makeShape(tb));
+                a.setPosition(Position(0, 0, 0));
+
+                CAPTURE(Names[ta]);
+                CAPTURE(Names[tb]);
+
+                for (int axis = 0; axis < 3; axis++) {
+                    Coord t = component(a.getBounds().getExtents(), axis) +
+                              component(b.getBounds().getExtents(), axis);
+
+                    CAPTURE(axis);
+
+                    for (Coord i = t + 2 * Physics::Epsilon; i >= -t - 2 * Physics::Epsilon; i--) {
+                        Position p(axis == 0 ? i : 0, axis == 1 ? i : 0, axis == 2 ? i : 0);
+                        b.setPosition(p);
+
+                        CAPTURE(i);
+                        CHECK(physics.checkCollision(a, b) == expected(std::abs(i), t));
+                        CHECK(physics.checkCollision(b, a) == expected(std::abs(i), t));
+                    }
+                }
+            }
+        }
+    }
+
+    GIVEN("Round shapes approaching diagonally") {
+        Physics::Body a, b;
+        a.setPosition(Position(0, 0, 0));
+
+        WHEN("Two spheres approach in the XZ plane") {
+            a.setBounds(BoundingVolume::sphere(128));
+            b.setBounds(BoundingVolume::sphere(128));
+
+            for (Coord i = 0; i <= 200; i++) {
+                CAPTURE(i);
+                b.setPosition(Position(i, 0, i));
+                CHECK(physics.checkCollision(a, b) == expected(std::sqrt(2.0 * i * i), 256.0));
+            }
+        }
+
+        WHEN("A sphere approaches the end of a capsule") {
+            a.setBounds(BoundingVolume::capsule(96, 256));
+            b.setBounds(BoundingVolume::sphere(128));
+
+            // the end cap is centred 160 above the capsule's centre
+            for (Coord i = 0; i <= 200; i++) {
+                CAPTURE(i);
+                b.setPosition(Position(i, 160 + i, 0));
+                CHECK(physics.checkCollision(a, b) == expected(std::sqrt(2.0 * i * i), 224.0));
+            }
+        }
+
+        WHEN("A sphere approaches the corner of a box") {
+            a.setBounds(BoundingVolume::box(Dimension(128, 160, 112)));
+            b.setBounds(BoundingVolume::sphere(128));
+
+            for (Coord i = 0; i <= 200; i++) {
+                CAPTURE(i);
+                b.setPosition(Position(128 + i, 160 + i, 112 + i));
+                CHECK(physics.checkCollision(a, b) == expected(std::sqrt(3.0 * i * i), 128.0));
+            }
+        }
+
+        WHEN("Two capsules pass at different heights") {
+            a.setBounds(BoundingVolume::capsule(96, 256));
+            b.setBounds(BoundingVolume::capsule(64, 128));
+
+            // segments are [-160,160] and [y-64,y+64]; side by side they
+            // touch at 160 whatever the height, above they touch diagonally
+            for (Coord y = -400; y <= 400; y += 8) {
+                for (Coord x = 100; x <= 200; x++) {
+                    CAPTURE(x);
+                    CAPTURE(y);
+                    b.setPosition(Position(x, y, 0));
+                    double dy = std::max(0.0, std::abs(double(y)) - 224.0);
+                    CHECK(physics.checkCollision(a, b) == expected(std::sqrt(x * x + dy * dy), 160.0));
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("narrowphase benchmark","[.][benchmark][physics]") {
+    static const size_t Count = 2000;
+
+    Physics physics;
+    std::vector<Physics::Body> bodies(Count);
+    uint32_t random = 1;
+
+    for (Physics::Body &body : bodies) {
+        random = random * 1103515245 + 12345;
+        Coord x = (random >> 8) % 2048;
+        random = random * 1103515245 + 12345;
+        Coord y = (random >> 8) % 2048;
+        random = random * 1103515245 + 12345;
+        Coord z = (random >> 8) % 2048;
+
+        body.setPosition(Position(x, y, z));
+        body.setBounds(makeShape(random % 3));
+    }
+
+    size_t counts[3] = {0, 0, 0};
+    sf::Clock clock;
+
+    for (size_t i = 0; i < Count; i++) {
+        for (size_t j = i + 1; j < Count; j++) {
+            counts[int(physics.checkCollision(bodies[i], bodies[j]))] += 1;
+        }
+    }
+
+    float seconds = clock.getElapsedTime().asSeconds();
+    size_t tests = Count * (Count - 1) / 2;
+
+    WARN(tests << " pair tests: " << tests / seconds / 1e6 << " M tests/s, " <<
+         counts[1] << " contacts, " << counts[2] << " intrusions");
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,435 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch.hpp"
+
+#include "engine/engine.hpp"
+#include "helpers.hpp"
+
+#include <SFML/System/Clock.hpp>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+bool same(const Physics::Body &a, const Physics::Body &b) {
+    return a.getPosition() == b.getPosition() &&
+           a.getVelocity() == b.getVelocity() &&
+           a.getMass() == b.getMass() &&
+           a.getBounds().getType() == b.getBounds().getType() &&
+           a.getBounds().getDimensions() == b.getBounds().getDimensions();
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+SCENARIO("physics world","[physics][physicsworld]") {
+
+    Physics physics;
+    Random random(4321);
+
+    GIVEN("1000 bodies in a world and as separate bodies") {
+        std::vector<Physics::Body> bodies;
+        makeBodies(bodies, 1000, random, 1 << 20, 32767, 100, false);
+
+        PhysicsWorld world(physics);
+        for (const Physics::Body &body : bodies) {
+            world.add(body);
+        }
+
+        REQUIRE(world.getBodyCount() == bodies.size());
+
+        THEN("Stepping gives bit-identical results") {
+            // includes fractional, negative and very long steps, and
+            // velocities wrapping under gravity
+            static const float Steps[] = {1.0f, 0.05f, 1.0f / 3, 0.77f, -0.5f, 2.0f, 100000.0f, 1.0f};
+
+            for (float step : Steps) {
+                CAPTURE(step);
+
+                for (Physics::Body &body : bodies) {
+                    physics.gravitate(body);
+                    physics.update(body, sf::seconds(step));
+                }
+
+                world.gravitate();
+                world.update(sf::seconds(step));
+
+                for (size_t i = 0; i < bodies.size(); i++) {
+                    CAPTURE(i);
+                    REQUIRE(same(world.getBody(i), bodies[i]));
+                }
+            }
+        }
+
+        WHEN("Bodies are removed") {
+            PhysicsWorld::Index moved = world.remove(10);
+            CHECK(moved == 999);
+            CHECK(world.getBodyCount() == 999);
+            CHECK(same(world.getBody(10), bodies[999]));
+
+            moved = world.remove(998);
+            CHECK(moved == 998);
+            CHECK(world.getBodyCount() == 998);
+            CHECK(same(world.getBody(997), bodies[997]));
+        }
+
+        WHEN("A body is changed") {
+            world.setPosition(5, Position(1, 2, 3));
+            world.setVelocity(5, Velocity(256, 0, -256));
+            world.update(sf::seconds(0.5f));
+
+            CHECK(world.getPosition(5) == Position(129, 2, -125));
+            CHECK(world.getVelocity(5) == Velocity(256, 0, -256));
+            CHECK(world.getMass(5) == bodies[5].getMass());
+        }
+    }
+}
+
+SCENARIO("physics islands","[physics][physicsworld]") {
+
+    Physics physics;
+    JobPool jobs(4);
+
+    GIVEN("Two spheres colliding head on") {
+        PhysicsWorld world(physics);
+
+        Physics::Body body;
+        body.setBounds(BoundingVolume::sphere(128));
+        body.setMass(1);
+
+        body.setPosition(Position(0, 0, 0));
+        body.setVelocity(Velocity(200, 0, 0));
+        world.add(body);
+
+        body.setPosition(Position(250, 0, 0));
+        body.setVelocity(Velocity(-100, 0, 0));
+        body.setMass(2);
+        world.add(body);
+
+        world.step(sf::seconds(0), jobs);
+
+        THEN("They move together, keeping their momentum") {
+            CHECK(world.getIslandCount() == 1);
+            CHECK(world.getVelocity(0).x == 0);
+            CHECK(world.getVelocity(1).x == 0);
+            CHECK(world.getVelocity(0).y == physics.getGravity().y);
+        }
+
+        WHEN("They move apart") {
+            world.setVelocity(0, Velocity(-50, 0, 0));
+            world.setVelocity(1, Velocity(50, 0, 0));
+            world.step(sf::seconds(0), jobs);
+
+            THEN("They are not slowed") {
+                CHECK(world.getVelocity(0).x == -50);
+                CHECK(world.getVelocity(1).x == 50);
+            }
+        }
+    }
+
+    GIVEN("Separate stacks of boxes") {
+        PhysicsWorld world(physics);
+
+        Physics::Body body;
+        body.setBounds(BoundingVolume::box(Dimension(128, 128, 128)));
+        body.setMass(1);
+        body.setVelocity(Velocity(0, 0, 0));
+
+        for (Coord stack = 0; stack < 5; stack++) {
+            for (Coord y = 0; y < 4; y++) {
+                body.setPosition(Position(stack * 1024, y * 256, 0));
+                world.add(body);
+            }
+        }
+
+        std::vector<PhysicsWorld::Contact> contacts;
+        world.findContacts(contacts);
+        CHECK(contacts.size() == 15);
+
+        world.step(sf::seconds(1), jobs);
+        CHECK(world.getIslandCount() == 5);
+
+        WHEN("A stack is removed") {
+            for (int i = 0; i < 4; i++) {
+                world.remove(4);
+            }
+
+            world.step(sf::seconds(1), jobs);
+            CHECK(world.getIslandCount() == 4);
+        }
+    }
+
+    GIVEN("A crowd of bodies") {
+        Random random(2468);
+        std::vector<Physics::Body> bodies;
+        makeBodies(bodies, 2000, random, 1 << 20, 32767, 100, false);
+
+        for (Physics::Body &body : bodies) {
+            Position p = body.getPosition();
+            Velocity v = body.getVelocity();
+            body.setPosition(Position(p.x >> 8, p.y >> 8, p.z >> 8));
+            body.setVelocity(Velocity(v.x >> 10, v.y >> 10, v.z >> 10));
+        }
+
+        THEN("Stepping does not depend on the number of threads") {
+            JobPool single(1);
+            PhysicsWorld a(physics), b(physics);
+
+            for (const Physics::Body &body : bodies) {
+                a.add(body);
+                b.add(body);
+            }
+
+            for (int tick = 0; tick < 20; tick++) {
+                CAPTURE(tick);
+
+                a.step(sf::seconds(0.05f), single);
+                b.step(sf::seconds(0.05f), jobs);
+
+                REQUIRE(a.getIslandCount() == b.getIslandCount());
+                for (size_t i = 0; i < bodies.size(); i++) {
+                    REQUIRE(same(a.getBody(i), b.getBody(i)));
+                }
+            }
+
+            CHECK(a.getIslandCount() > 10);
+        }
+    }
+}
+
+SCENARIO("sleeping bodies","[physics][physicsworld][sleep]") {
+
+    static const Coord M = 1 << FixedPointBits;
+
+    Physics physics;
+    JobPool jobs(2);
+    ChunkGenerator generator(5);
+    ChunkCache terrain(generator, 256);
+
+    GIVEN("A body dropped on the ground") {
+        Physics::Body body;
+        body.setBounds(BoundingVolume::box(Dimension(M/4, M/4, M/4)));
+        body.setPosition(Position(M/2, 40 * M, M/2));
+        body.setMass(1);
+
+        int ticks = 0;
+        while (!body.isAsleep() && ticks < 1000) {
+            physics.gravitate(body);
+            physics.tick(body, terrain);
+            physics.settle(body);
+            ticks += 1;
+        }
+
+        THEN("It falls asleep and stays put") {
+            CHECK(body.isAsleep());
+            CHECK(body.getPosition().y == (generator.getHeight(0, 0) + 1) * M + M/4);
+
+            Physics::Body copy(body);
+            physics.gravitate(body);
+            physics.tick(body, terrain);
+            CHECK(hashBody(body) == hashBody(copy));
+        }
+
+        THEN("It wakes when pushed") {
+            physics.impulse(body, Velocity(M/8, 0, 0), 1);
+            CHECK_FALSE(body.isAsleep());
+            CHECK(body.getVelocity() == Velocity(M/8, 0, 0));
+        }
+    }
+
+    GIVEN("A field of bodies dropped on the ground") {
+        PhysicsWorld world(physics);
+
+        Physics::Body body;
+        body.setBounds(BoundingVolume::box(Dimension(M/4, M/4, M/4)));
+        body.setMass(1);
+
+        for (Coord z = 0; z < 20; z++) {
+            for (Coord x = 0; x < 20; x++) {
+                body.setPosition(Position(x * M + M/2, (40 + x % 3) * M, z * M + M/2));
+                world.add(body);
+            }
+        }
+
+        for (int tick = 0; tick < 200; tick++) {
+            world.step(1, jobs, terrain);
+        }
+
+        THEN("They are all asleep") {
+            CHECK(world.getAwakeCount() == 0);
+            CHECK(world.getSleepingCount() == 400);
+        }
+
+        WHEN("The block under one of them is removed") {
+            PhysicsWorld::Index index = 7 * 20 + 3;
+            Position block(3, generator.getHeight(3, 7), 7);
+            Coord rest = world.getPosition(index).y;
+
+            terrain.getChunk(toChunkPosition(block))->getBlock(block).setType(0);
+            world.blockChanged(block);
+
+            CHECK_FALSE(world.isAsleep(index));
+            CHECK(world.isAsleep(index + 1));
+
+            for (int tick = 0; tick < 200; tick++) {
+                world.step(1, jobs, terrain);
+            }
+
+            THEN("It falls into the hole and sleeps again") {
+                CHECK(world.getPosition(index).y < rest);
+                CHECK(world.isAsleep(index));
+                CHECK(world.getAwakeCount() == 0);
+            }
+        }
+
+        WHEN("A body is dropped onto a sleeping one") {
+            Position below = world.getPosition(0);
+            body.setPosition(Position(below.x, below.y + M/2 + M/8, below.z));
+            body.setVelocity(Velocity(0, -M/4, 0));
+            PhysicsWorld::Index index = world.add(body);
+
+            // the first step brings them into contact
+            world.step(1, jobs, terrain);
+            CHECK(world.isAsleep(0));
+            world.step(1, jobs, terrain);
+
+            THEN("The sleeping body wakes") {
+                CHECK_FALSE(world.isAsleep(0));
+                CHECK_FALSE(world.isAsleep(index));
+                CHECK(world.getAwakeCount() == 2);
+            }
+        }
+    }
+}
+
+TEST_CASE("physics world benchmark","[.][benchmark][physicsworld]") {
+    static const size_t Count = 100000;
+    static const int Ticks = 200;
+
+    Physics physics;
+    Random random(8765);
+
+    std::vector<Physics::Body> bodies;
+    makeBodies(bodies, Count, random, 1 << 20, 32767, 100, false);
+
+    PhysicsWorld world(physics);
+    for (const Physics::Body &body : bodies) {
+        world.add(body);
+    }
+
+    sf::Clock clock;
+
+    for (int tick = 0; tick < Ticks; tick++) {
+        for (Physics::Body &body : bodies) {
+            physics.gravitate(body);
+            physics.update(body, sf::seconds(0.05f));
+        }
+    }
+
+    float scalar = clock.restart().asSeconds() * 1000.0f;
+
+    for (int tick = 0; tick < Ticks; tick++) {
+        world.gravitate();
+        world.update(sf::seconds(0.05f));
+    }
+
+    float packed = clock.getElapsedTime().asSeconds() * 1000.0f;
+
+    WARN(Count << " bodies: " << Count * Ticks / scalar << " bodies/ms stepped one at a time, " <<
+         Count * Ticks / packed << " bodies/ms in a physics world");
+
+    for (size_t i = 0; i < Count; i += Count / 100) {
+        CHECK(world.getPosition(i) == bodies[i].getPosition());
+    }
+}
+
+TEST_CASE("sleeping bodies benchmark","[.][benchmark][physicsworld][sleep]") {
+    static const Coord M = 1 << FixedPointBits;
+    static const int Ticks = 50;
+
+    Physics physics;
+    JobPool jobs;
+    ChunkGenerator generator(5);
+    ChunkCache terrain(generator, 4096);
+    PhysicsWorld world(physics);
+
+    Physics::Body body;
+    body.setBounds(BoundingVolume::box(Dimension(M/4, M/4, M/4)));
+    body.setMass(1);
+
+    for (Coord z = 0; z < 100; z++) {
+        for (Coord x = 0; x < 100; x++) {
+            body.setPosition(Position(x * M + M/2, 40 * M, z * M + M/2));
+            world.add(body);
+        }
+    }
+
+    sf::Clock clock;
+    for (int tick = 0; tick < Ticks; tick++) {
+        world.step(1, jobs, terrain);
+    }
+    float falling = clock.restart().asSeconds() * 1000.0f / Ticks;
+    size_t awake = world.getAwakeCount();
+
+    while (world.getAwakeCount() > 0) {
+        world.step(1, jobs, terrain);
+    }
+
+    clock.restart();
+    for (int tick = 0; tick < Ticks; tick++) {
+        world.step(1, jobs, terrain);
+    }
+    float resting = clock.getElapsedTime().asSeconds() * 1000.0f / Ticks;
+
+    WARN(world.getBodyCount() << " bodies: " << falling << " ms/tick with " << awake <<
+         " awake, " << resting << " ms/tick with " << world.getSleepingCount() << " asleep");
+}
+
+TEST_CASE("physics island benchmark","[.][benchmark][physicsworld]") {
+    static const size_t Count = 20000;
+    static const int Ticks = 50;
+
+    Physics physics;
+    Random random(1357);
+
+    std::vector<Physics::Body> bodies;
+    makeBodies(bodies, Count, random, 1 << 20, 32767, 100, false);
+
+    for (Physics::Body &body : bodies) {
+        Position p = body.getPosition();
+        Velocity v = body.getVelocity();
+        body.setPosition(Position(p.x >> 6, p.y >> 8, p.z >> 6));
+        body.setVelocity(Velocity(v.x >> 10, v.y >> 10, v.z >> 10));
+    }
+
+    unsigned int cores = std::max(4u, std::thread::hardware_concurrency());
+
+    for (unsigned int threads = 1; threads <= cores; threads *= 2) {
+        JobPool jobs(threads);
+        PhysicsWorld world(physics);
+
+        for (const Physics::Body &body : bodies) {
+            world.add(body);
+        }
+
+        sf::Clock clock;
+        size_t islands = 0;
+
+        for (int tick = 0; tick < Ticks; tick++) {
+            world.step(sf::seconds(0.05f), jobs);
+            islands += world.getIslandCount();
+        }
+
+        float ms = clock.getElapsedTime().asSeconds() * 1000.0f / Ticks;
+
+        WARN(Count << " bodies, " << threads << " threads: " << ms << " ms/tick, " <<
+             islands / Ticks << " islands/tick");
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
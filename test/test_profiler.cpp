@@ -0,0 +1,146 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch.hpp"
+
+#include "engine/engine.hpp"
+
+#include <SFML/System/Clock.hpp>
+
+#include <cstdio>
+#include <string>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+void busy(sf::Time length) {
+    sf::Clock clock;
+    while (clock.getElapsedTime() < length) {
+    }
+}
+
+std::vector<std::string> getNames(const TickTrace &trace) {
+    std::vector<std::string> names;
+    for (const TickSpan &span : trace.spans) {
+        names.push_back(std::string(span.depth, ' ') + span.name);
+    }
+    return names;
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+SCENARIO("tick profiler","[tick][profiler]") {
+
+    GIVEN("A profiler with a 2 ms budget") {
+        TickProfiler profiler(sf::milliseconds(2), 64);
+
+        std::vector<TickTrace> dumped;
+        profiler.setSlowTickHandler([&](const TickTrace &trace) { dumped.push_back(trace); });
+
+        WHEN("A tick stays within budget") {
+            profiler.beginTick(1);
+            {
+                TickProfiler::Scope scope(profiler, TickProfiler::NetworkIn);
+                busy(sf::microseconds(200));
+            }
+            profiler.endTick();
+
+            THEN("Nothing is dumped") {
+                CHECK(dumped.empty());
+                CHECK(profiler.getSlowTickCount() == 0);
+                CHECK(profiler.getPhaseTime(TickProfiler::NetworkIn) >= sf::microseconds(200));
+                CHECK(profiler.getPhaseTime(TickProfiler::Lighting) == sf::Time::Zero);
+                CHECK(profiler.getSampleCount() == 1);
+            }
+        }
+
+        WHEN("A tick overruns") {
+            profiler.beginTick(7);
+            {
+                TickProfiler::Scope scope(profiler, TickProfiler::Lighting);
+                {
+                    TickProfiler::Scope part(profiler, "flood fill");
+                    busy(sf::milliseconds(3));
+                }
+            }
+            {
+                TickProfiler::Scope scope(profiler, TickProfiler::Saving);
+            }
+            profiler.endTick();
+
+            THEN("Its trace is dumped") {
+                REQUIRE(dumped.size() == 1);
+                CHECK(profiler.getSlowTickCount() == 1);
+
+                const TickTrace &trace = dumped[0];
+                CHECK(trace.tick == 7);
+                CHECK(trace.length > sf::milliseconds(3));
+                CHECK(trace.budget == sf::milliseconds(2));
+
+                std::vector<std::string> expected = { "lighting", " flood fill", "saving" };
+                CHECK(getNames(trace) == expected);
+                CHECK(trace.spans[1].length >= sf::milliseconds(3));
+                CHECK(trace.spans[2].start >= trace.spans[0].start + trace.spans[0].length);
+
+                FILE *file = tmpfile();
+                trace.write(file);
+                CHECK(ftell(file) > 0);
+                fclose(file);
+            }
+        }
+
+        WHEN("Ticks vary in length") {
+            for (int tick = 0; tick < 100; tick++) {
+                profiler.beginTick(tick);
+                {
+                    TickProfiler::Scope scope(profiler, TickProfiler::Entities);
+                    busy(sf::microseconds(tick % 10 == 9 ? 1000 : 50));
+                }
+                profiler.endTick();
+            }
+
+            THEN("Percentiles are taken over the window") {
+                CHECK(profiler.getSampleCount() == 64);
+
+                sf::Time median = profiler.getPercentile(TickProfiler::Entities, 50);
+                sf::Time p95 = profiler.getPercentile(TickProfiler::Entities, 95);
+
+                CHECK(median >= sf::microseconds(50));
+                CHECK(median < sf::microseconds(1000));
+                CHECK(p95 >= sf::microseconds(1000));
+                CHECK(profiler.getTickPercentile(100) >= p95);
+            }
+        }
+    }
+
+    GIVEN("A world with a network handler") {
+        World world(nullptr, 50, 1);
+        world.getPipeline().spawn(Position(), Velocity(1, 0, 0), Orientation(Angle::Zero, Angle::Zero));
+
+        int received = 0;
+        world.setPhaseHandler(TickProfiler::NetworkIn, [&](World &) { received += 1; });
+        world.getProfiler().setSlowTickHandler(TickProfiler::SlowTickHandler());
+
+        world.tick();
+        world.tick();
+
+        THEN("Each tick traces the phases that ran") {
+            CHECK(received == 2);
+            CHECK(world.getProfiler().getSampleCount() == 2);
+
+            std::vector<std::string> expected = {
+                "network in", "entities", " systems", " motion", " apply"
+            };
+            CHECK(getNames(world.getProfiler().getTrace()) == expected);
+            CHECK(world.getProfiler().getBudget() == world.getTickLength());
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
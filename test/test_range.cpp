@@ -0,0 +1,147 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch.hpp"
+
+#include "engine/engine.hpp"
+
+#include <map>
+
+////////////////////////////////////////////////////////////////////////////////
+
+SCENARIO("range allocator","[range]") {
+
+    GIVEN("A span of 100 units") {
+        RangeAllocator ranges(100);
+
+        THEN("Ranges are handed out from the start") {
+            CHECK(ranges.allocate(10) == 0);
+            CHECK(ranges.allocate(20) == 10);
+            CHECK(ranges.getUsed() == 30);
+            CHECK(ranges.getLargestFree() == 70);
+            CHECK(ranges.allocate(71) == RangeAllocator::None);
+            CHECK(ranges.allocate(0) == RangeAllocator::None);
+        }
+
+        WHEN("Ranges are freed between others") {
+            size_t a = ranges.allocate(10);
+            size_t b = ranges.allocate(30);
+            size_t c = ranges.allocate(10);
+            size_t d = ranges.allocate(20);
+            ranges.allocate(30);
+
+            CHECK(ranges.free(b));
+            CHECK(ranges.free(d));
+            CHECK_FALSE(ranges.free(d));
+            CHECK_FALSE(ranges.free(5));
+
+            THEN("The smallest range that fits is taken") {
+                CHECK(ranges.getFreeCount() == 2);
+                CHECK(ranges.allocate(15) == d);
+                CHECK(ranges.allocate(25) == b);
+            }
+
+            THEN("Free neighbours merge") {
+                CHECK(ranges.free(c));
+                CHECK(ranges.getFreeCount() == 1);
+                CHECK(ranges.getLargestFree() == 60);
+                CHECK(ranges.allocate(60) == b);
+
+                CHECK(ranges.free(a));
+                CHECK(ranges.getFreeCount() == 1);
+            }
+
+            THEN("Compaction slides the rest down") {
+                std::vector<RangeAllocator::Move> moves = ranges.compact();
+
+                REQUIRE(moves.size() == 2);
+                CHECK(moves[0].from == c);
+                CHECK(moves[0].to == 10);
+                CHECK(moves[0].size == 10);
+                CHECK(moves[1].from == 70);
+                CHECK(moves[1].to == 20);
+                CHECK(moves[1].size == 30);
+
+                CHECK(ranges.getFreeCount() == 1);
+                CHECK(ranges.getLargestFree() == 50);
+                CHECK(ranges.getSize(20) == 30);
+                CHECK(ranges.allocate(50) == 50);
+            }
+        }
+
+        WHEN("It is full and grows") {
+            ranges.allocate(60);
+            size_t last = ranges.allocate(40);
+            ranges.grow(150);
+
+            THEN("The new space is one free range") {
+                CHECK(ranges.getCapacity() == 150);
+                CHECK(ranges.allocate(50) == 100);
+
+                CHECK(ranges.free(last));
+                CHECK(ranges.getFreeCount() == 1);
+                CHECK(ranges.getLargestFree() == 40);
+            }
+        }
+    }
+
+    GIVEN("Random allocations and frees") {
+        RangeAllocator ranges(10000);
+        std::map<size_t, size_t> live;
+        uint32_t seed = 5;
+        size_t overlapping = 0, failed = 0;
+
+        for (int step = 0; step < 20000; step++) {
+            seed = seed * 1103515245 + 12345;
+            uint32_t r = seed >> 8;
+
+            if (r % 3 == 0 && !live.empty()) {
+                auto victim = live.lower_bound(r % 10000);
+                if (victim == live.end()) {
+                    victim = live.begin();
+                }
+                CHECK(ranges.free(victim->first));
+                live.erase(victim);
+            } else {
+                size_t size = 1 + r % 200;
+                size_t offset = ranges.allocate(size);
+                if (offset == RangeAllocator::None) {
+                    failed += 1;
+                    continue;
+                }
+
+                auto next = live.lower_bound(offset);
+                overlapping += next != live.end() && next->first < offset + size;
+                if (next != live.begin()) {
+                    --next;
+                    overlapping += next->first + next->second > offset;
+                }
+
+                live[offset] = size;
+            }
+        }
+
+        THEN("Ranges never overlap, and compaction keeps them") {
+            CHECK(overlapping == 0);
+
+            size_t used = 0;
+            for (const auto &range : live) {
+                used += range.second;
+            }
+            CHECK(ranges.getUsed() == used);
+
+            for (const RangeAllocator::Move &move : ranges.compact()) {
+                CHECK(live.count(move.from) == 1);
+                CHECK(move.to < move.from);
+            }
+
+            CHECK(ranges.getAllocatedCount() == live.size());
+            CHECK(ranges.getLargestFree() == ranges.getCapacity() - used);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,184 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch.hpp"
+
+#include "engine/engine.hpp"
+#include "helpers.hpp"
+
+#include <SFML/System/Clock.hpp>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+const Coord M = 1 << FixedPointBits;
+
+Ray makeRay(const Position &origin, const Position &direction, Coord length) {
+    Ray ray;
+    ray.origin = origin;
+    ray.direction = direction;
+    ray.length = length;
+    return ray;
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+SCENARIO("raycast","[raycast]") {
+
+    GIVEN("Flat ground with walls") {
+        TestSource source;
+        ChunkCache world(source, 256);
+        Raycaster raycaster(world);
+        RayHit hit;
+
+        WHEN("A ray points down") {
+            REQUIRE(raycaster.cast(makeRay(Position(M/2, 10 * M + M/2, M/2), Position(0, -1, 0), 20 * M), hit));
+            CHECK(hit.block == Position(0, -1, 0));
+            CHECK(hit.face == BlockFace::Top);
+            CHECK(hit.distance == 10 * M + M/2);
+            CHECK(hit.type == 1);
+        }
+
+        WHEN("A ray is too short") {
+            CHECK_FALSE(raycaster.cast(makeRay(Position(M/2, 10 * M + M/2, M/2), Position(0, -1, 0), 10 * M), hit));
+        }
+
+        WHEN("Rays point along the ground at the walls") {
+            REQUIRE(raycaster.cast(makeRay(Position(M/4, M + M/2, 100 * M), Position(M, 0, 0), 100 * M), hit));
+            CHECK(hit.block == Position(4, 1, 100));
+            CHECK(hit.face == BlockFace::West);
+            CHECK(hit.distance == 4 * M - M/4);
+
+            REQUIRE(raycaster.cast(makeRay(Position(M/4, M + M/2, -100 * M), Position(-3 * M, 0, 0), 100 * M), hit));
+            CHECK(hit.block == Position(-8, 1, -100));
+            CHECK(hit.face == BlockFace::East);
+            CHECK(hit.distance == 7 * M + M/4);
+        }
+
+        WHEN("A ray passes over the walls") {
+            CHECK_FALSE(raycaster.cast(makeRay(Position(M/2, 5 * M, M/2), Position(1, 0, 1), 1000 * M), hit));
+        }
+
+        WHEN("A ray starts inside a block") {
+            REQUIRE(raycaster.cast(makeRay(Position(M/2, -M/2, M/2), Position(0, 1, 0), 10 * M), hit));
+            CHECK(hit.block == Position(0, -1, 0));
+            CHECK(hit.face == BlockFace::None);
+            CHECK(hit.distance == 0);
+        }
+
+        WHEN("Lines of sight cross a wall") {
+            CHECK(raycaster.isVisible(Position(0, M, 0), Position(3 * M, 2 * M, 5 * M)));
+            CHECK_FALSE(raycaster.isVisible(Position(0, M, 0), Position(6 * M, 2 * M, 5 * M)));
+            CHECK(raycaster.isVisible(Position(0, 6 * M, 0), Position(6 * M, 5 * M, 5 * M)));
+        }
+    }
+
+    GIVEN("Generated terrain and random rays") {
+        ChunkGenerator generator(17);
+        ChunkCache world(generator, 4096);
+        Raycaster skipping(world);
+        Raycaster stepping(world, Block::Attributes::Passable, false);
+        Random random(97531);
+
+        size_t hits = 0, missed = 0;
+
+        for (int i = 0; i < 2000; i++) {
+            Position origin(random.range(-64 * M, 64 * M), random.range(0, 48 * M), random.range(-64 * M, 64 * M));
+            Position direction(random.range(-M, M), random.range(-M, M/2), random.range(-M, M));
+            Ray ray = makeRay(origin, direction, 64 * M);
+
+            CAPTURE(i);
+
+            RayHit a, b;
+            bool foundA = skipping.cast(ray, a);
+            bool foundB = stepping.cast(ray, b);
+
+            // skipping chunks must not change the result
+            REQUIRE(foundA == foundB);
+            if (!foundA) {
+                continue;
+            }
+
+            hits += 1;
+            CHECK(a.block == b.block);
+            CHECK(a.face == b.face);
+            CHECK(a.distance == b.distance);
+            CHECK(Block::isSolid(a.type));
+
+            // nothing solid lies on the ray before the hit
+            double length = std::sqrt(double(direction.x) * direction.x +
+                                      double(direction.y) * direction.y +
+                                      double(direction.z) * direction.z);
+            for (Coord t = 0; t + 2 < a.distance; t += M/8) {
+                Position p(origin.x + Coord(std::floor(direction.x * t / length)),
+                           origin.y + Coord(std::floor(direction.y * t / length)),
+                           origin.z + Coord(std::floor(direction.z * t / length)));
+                Position block = toBlockPosition(p);
+                if (block != a.block && Block::isSolid(world.getChunk(toChunkPosition(block))->getData()->getType(block))) {
+                    missed += 1;
+                }
+            }
+        }
+
+        CHECK(hits > 500);
+        CHECK(missed == 0);
+    }
+}
+
+TEST_CASE("raycast benchmark","[.][benchmark][raycast]") {
+    static const size_t Count = 20000;
+
+    ChunkGenerator generator(3);
+    ChunkCache world(generator, 4096);
+    Random random(1111);
+
+    // mobs checking line of sight to players across the terrain, and
+    // flying mobs checking it high above
+    std::vector<Ray> ground(Count), air(Count);
+
+    for (size_t i = 0; i < Count; i++) {
+        Position from(random.range(-64 * M, 64 * M), 0, random.range(-64 * M, 64 * M));
+        Position to(random.range(-64 * M, 64 * M), 0, random.range(-64 * M, 64 * M));
+        from.y = (generator.getHeight(from.x >> FixedPointBits, from.z >> FixedPointBits) + 2) * M + random.range(0, 8 * M);
+        to.y = (generator.getHeight(to.x >> FixedPointBits, to.z >> FixedPointBits) + 2) * M + random.range(0, 8 * M);
+
+        Position d = to - from;
+        Coord length = std::sqrt(double(d.x) * d.x + double(d.y) * d.y + double(d.z) * d.z);
+        ground[i] = makeRay(from, d, length);
+        air[i] = makeRay(Position(from.x, from.y + 64 * M, from.z), d, length);
+    }
+
+    std::vector<RayHit> hits;
+    std::vector<uint8_t> found;
+
+    for (int skip = 1; skip >= 0; skip--) {
+        for (int set = 0; set < 2; set++) {
+            const std::vector<Ray> &rays = set ? air : ground;
+            Raycaster raycaster(world, Block::Attributes::Transparent, skip);
+
+            // load the terrain and chunk cache before timing
+            raycaster.cast(rays, hits, found);
+
+            sf::Clock clock;
+            raycaster.cast(rays, hits, found);
+            float seconds = clock.getElapsedTime().asSeconds();
+
+            size_t blocked = 0;
+            for (uint8_t f : found) {
+                blocked += f;
+            }
+
+            WARN(Count << (set ? " rays in the air, " : " rays near the ground, ") <<
+                 (skip ? "skipping" : "stepping through") << " empty chunks: " <<
+                 Count / seconds / 1e6 << " M rays/s, " << blocked << " blocked");
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
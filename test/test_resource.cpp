@@ -0,0 +1,188 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch.hpp"
+
+#include "engine/engine.hpp"
+
+#include <cstdio>
+
+////////////////////////////////////////////////////////////////////////////////
+
+static std::vector<uint8_t> makeData(size_t size, uint8_t seed) {
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++) {
+        data[i] = seed + i * 7 + (i >> 8);
+    }
+    return data;
+}
+
+SCENARIO("resources","[resource]") {
+
+    GIVEN("Known data") {
+        std::vector<uint8_t> empty;
+        std::vector<uint8_t> a(1, 'a');
+
+        CHECK(hashResource(empty) == 0xcbf29ce484222325ULL);
+        CHECK(hashResource(a) == 0xaf63dc4c8601ec8cULL);
+    }
+
+    GIVEN("A server with one large and two small resources") {
+        static const char *Path = "test-resource-";
+
+        std::vector<uint8_t> texture = makeData(100000, 1);
+        std::vector<uint8_t> sound = makeData(3000, 2);
+        std::vector<uint8_t> script = makeData(5000, 3);
+
+        ResourceIndex index;
+        index.add(1, 0, texture);
+        index.add(2, 1, sound);
+        index.add(3, 2, script);
+
+        ResourceHash hashes[] = {
+            index.find(1)->hash,
+            index.find(2)->hash,
+            index.find(3)->hash
+        };
+
+        {
+            ResourceStore store(Path);
+            ResourceReceiver receiver(store);
+            ResourceSender sender(index);
+
+            for (ResourceID id = 1; id <= 3; id++) {
+                CHECK(store.getHash(id) == 0);
+                CHECK(sender.check(id, store.getHash(id)));
+            }
+
+            // unknown resources are never sent
+            CHECK_FALSE(sender.check(99, 0));
+
+            std::map<ResourceID, size_t> completedAt;
+            ResourceFragment fragment;
+            size_t fragments = 0;
+
+            while (sender.nextFragment(fragment)) {
+                REQUIRE(fragment.length <= ResourceSender::DefaultFragmentSize);
+                fragments += 1;
+                if (receiver.receive(fragment)) {
+                    completedAt[fragment.id] = fragments;
+                }
+            }
+
+            CHECK(receiver.isIdle());
+            CHECK(receiver.getBytesReceived() == texture.size() + sound.size() + script.size());
+            REQUIRE(completedAt.size() == 3);
+
+            // the large texture must not hold up the small resources
+            CHECK(completedAt[2] < 8);
+            CHECK(completedAt[3] < 8);
+            CHECK(completedAt[1] == fragments);
+
+            std::vector<uint8_t> data;
+            CHECK(store.load(hashes[0], data));
+            CHECK(data == texture);
+            CHECK(store.load(hashes[1], data));
+            CHECK(data == sound);
+            CHECK(store.load(hashes[2], data));
+            CHECK(data == script);
+        }
+
+        WHEN("The client reconnects") {
+            ResourceStore store(Path);
+            ResourceReceiver receiver(store);
+            ResourceSender sender(index);
+
+            for (ResourceID id = 1; id <= 3; id++) {
+                CHECK(store.getHash(id) == hashes[id - 1]);
+                CHECK_FALSE(sender.check(id, store.getHash(id)));
+            }
+
+            CHECK(sender.isIdle());
+
+            THEN("Only an updated resource is downloaded") {
+                std::vector<uint8_t> sound2 = makeData(3000, 4);
+                index.add(2, 1, sound2);
+
+                CHECK_FALSE(sender.check(1, store.getHash(1)));
+                CHECK(sender.check(2, store.getHash(2)));
+                CHECK_FALSE(sender.check(3, store.getHash(3)));
+
+                ResourceFragment fragment;
+                while (sender.nextFragment(fragment)) {
+                    receiver.receive(fragment);
+                }
+
+                CHECK(receiver.getBytesReceived() == sound2.size());
+                CHECK(store.getHash(2) == hashResource(sound2));
+
+                std::remove(store.getPath(hashResource(sound2)).c_str());
+            }
+        }
+
+        WHEN("Resources change while being sent") {
+            ResourceSender sender(index);
+            for (ResourceID id = 1; id <= 3; id++) {
+                CHECK(sender.check(id, 0));
+            }
+
+            uint32_t fragmentSize = ResourceSender::DefaultFragmentSize;
+
+            // the small resources finish; the texture is 3 fragments in
+            ResourceFragment fragment;
+            for (int i = 0; i < 6; i++) {
+                REQUIRE(sender.nextFragment(fragment));
+            }
+            REQUIRE(fragment.id == 1);
+            REQUIRE(fragment.offset == 2 * fragmentSize);
+
+            THEN("A replaced resource starts over with its new data") {
+                std::vector<uint8_t> texture2 = makeData(5000, 5);
+                index.add(1, 0, texture2);
+
+                REQUIRE(sender.nextFragment(fragment));
+                CHECK(fragment.id == 1);
+                CHECK(fragment.hash == hashResource(texture2));
+                CHECK(fragment.size == texture2.size());
+                CHECK(fragment.offset == 0);
+                CHECK(fragment.length == fragmentSize);
+
+                REQUIRE(sender.nextFragment(fragment));
+                CHECK(fragment.offset == fragmentSize);
+                CHECK(fragment.length == texture2.size() - fragmentSize);
+                CHECK(fragment.data == index.find(1)->data.data() + fragment.offset);
+
+                CHECK_FALSE(sender.nextFragment(fragment));
+            }
+
+            THEN("A removed resource is dropped") {
+                index.remove(1);
+                CHECK_FALSE(sender.nextFragment(fragment));
+                CHECK(sender.isIdle());
+            }
+        }
+
+        WHEN("Data is corrupted in transit") {
+            ResourceStore store(Path);
+            ResourceReceiver receiver(store);
+
+            std::vector<uint8_t> bad(sound);
+            bad[10] ^= 1;
+
+            receiver.begin(7, hashes[1], 1, bad.size());
+            CHECK_FALSE(receiver.receive(7, 0, bad.data(), bad.size()));
+            CHECK(store.getHash(7) == 0);
+        }
+
+        ResourceStore store(Path);
+        for (ResourceHash hash : hashes) {
+            std::remove(store.getPath(hash).c_str());
+        }
+        std::remove((std::string(Path) + "index").c_str());
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
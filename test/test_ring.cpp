@@ -0,0 +1,115 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch.hpp"
+
+#include "engine/engine.hpp"
+
+#include <deque>
+#include <utility>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+
+SCENARIO("ring allocator","[ring]") {
+
+    GIVEN("A ring of 1000 bytes") {
+        RingAllocator ring(1000);
+
+        THEN("Ranges follow each other, aligned") {
+            CHECK(ring.allocate(10) == 0);
+            CHECK(ring.allocate(100, 16) == 16);
+            CHECK(ring.allocate(8, 4) == 116);
+            CHECK(ring.getUsed() == 124);
+            CHECK(ring.getOpenBytes() == 124);
+        }
+
+        THEN("Nothing larger than the ring fits") {
+            CHECK(ring.allocate(1001) == RingAllocator::None);
+            CHECK(ring.allocate(0) == RingAllocator::None);
+        }
+
+        WHEN("It fills in two batches") {
+            CHECK(ring.allocate(400) == 0);
+            ring.close();
+            CHECK(ring.allocate(400) == 400);
+            ring.close();
+
+            THEN("A range that does not fit before the end waits for the first batch") {
+                CHECK(ring.allocate(300) == RingAllocator::None);
+                CHECK(ring.allocate(200) == 800);
+                CHECK(ring.allocate(1) == RingAllocator::None);
+
+                CHECK(ring.reclaim());
+                CHECK(ring.getClosedCount() == 1);
+                CHECK(ring.allocate(300) == 0);
+                CHECK(ring.allocate(100) == 300);
+                CHECK(ring.allocate(1) == RingAllocator::None);
+            }
+
+            THEN("Skipped bytes at the end are given back with their batch") {
+                CHECK(ring.reclaim());
+                CHECK(ring.allocate(300) == 0);
+                CHECK(ring.getUsed() == 400 + 200 + 300);
+                ring.close();
+
+                CHECK(ring.reclaim());
+                CHECK(ring.reclaim());
+                CHECK_FALSE(ring.reclaim());
+                CHECK(ring.getUsed() == 0);
+            }
+        }
+    }
+
+    GIVEN("Random allocations over many batches") {
+        RingAllocator ring(4096);
+        std::deque<std::vector<std::pair<size_t, size_t>>> batches(1);
+        uint32_t seed = 17;
+        size_t failed = 0, overlapping = 0, allocated = 0;
+
+        for (int step = 0; step < 20000; step++) {
+            seed = seed * 1103515245 + 12345;
+            uint32_t r = seed >> 8;
+
+            if (r % 8 == 0) {
+                ring.close();
+                batches.push_back(std::vector<std::pair<size_t, size_t>>());
+            } else if (r % 8 == 1 && batches.size() > 1) {
+                ring.reclaim();
+                batches.pop_front();
+            } else {
+                size_t size = 1 + r % 300;
+                size_t alignment = size_t(1) << (r % 5);
+                size_t offset = ring.allocate(size, alignment);
+
+                if (offset == RingAllocator::None) {
+                    failed += 1;
+                    continue;
+                }
+
+                allocated += 1;
+                CHECK(offset % alignment == 0);
+                CHECK(offset + size <= ring.getCapacity());
+
+                for (const auto &batch : batches) {
+                    for (const auto &range : batch) {
+                        overlapping += offset < range.first + range.second && range.first < offset + size;
+                    }
+                }
+
+                batches.back().push_back(std::make_pair(offset, size));
+            }
+        }
+
+        THEN("Ranges in use never overlap") {
+            CHECK(overlapping == 0);
+            CHECK(allocated > 1000);
+            CHECK(failed > 0);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
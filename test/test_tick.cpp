@@ -0,0 +1,187 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch.hpp"
+
+#include "engine/engine.hpp"
+#include "helpers.hpp"
+
+#include <SFML/System/Clock.hpp>
+
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+void populate(TickPipeline &pipeline, size_t count, uint32_t seed) {
+    Random random(seed);
+    for (size_t i = 0; i < count; i++) {
+        pipeline.spawn(
+            Position(random.range(-1 << 16, 1 << 16), random.range(-1 << 10, 1 << 10), random.range(-1 << 16, 1 << 16)),
+            Velocity(random.range(-64, 64), random.range(-64, 64), random.range(-64, 64)),
+            Orientation(Angle::Zero, Angle::Zero)
+        );
+    }
+}
+
+/**
+ *  Mobs that wander for a while, then either despawn or split in two.
+ */
+void lifecycle(EntityRegistry &registry, size_t begin, size_t end, CommandBuffer &buffer) {
+    std::vector<EntityAI> &ai = registry.getAI();
+
+    for (size_t i = begin; i < end; i++) {
+        EntityAI &mob = ai[i];
+        mob.timer += 1;
+
+        if (mob.timer < 8) {
+            continue;
+        }
+
+        mob.timer = 0;
+        EntityID id = registry.getIDs()[i];
+        uint32_t index = EntityIDAllocator::getIndex(id);
+
+        if (index % 7 == 0) {
+            buffer.despawn(id);
+        } else if (index % 11 == 0) {
+            const Velocity &v = registry.getVelocities()[i];
+            buffer.spawn(registry.getPositions()[i], Velocity(v.z, v.y, v.x), registry.getOrientations()[i]);
+        }
+    }
+}
+
+void checkIndex(const TickPipeline &pipeline) {
+    const EntityRegistry &registry = pipeline.getRegistry();
+    const EntityIndex &index = pipeline.getIndex();
+
+    REQUIRE(index.size() == registry.size());
+
+    for (size_t i = 0; i < registry.size(); i++) {
+        const std::vector<EntityID> *bucket = index.getEntities(EntityIndex::getChunk(registry.getPositions()[i]));
+        REQUIRE(bucket != nullptr);
+        CHECK(std::count(bucket->begin(), bucket->end(), registry.getIDs()[i]) == 1);
+    }
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+SCENARIO("world tick","[tick]") {
+
+    GIVEN("A world at 50 ticks per second") {
+        World world(nullptr, 50, 1);
+        CHECK(world.getTickLength() == sf::milliseconds(20));
+
+        WHEN("Time passes") {
+            CHECK(world.update(sf::milliseconds(50)) == 2);
+            CHECK(world.update(sf::milliseconds(10)) == 1);
+            CHECK(world.update(sf::milliseconds(19)) == 0);
+            CHECK(world.getTick() == 3);
+
+            THEN("No more than maxTicks run at once, and the rest is dropped") {
+                CHECK(world.update(sf::seconds(1), 5) == 5);
+                CHECK(world.update(sf::milliseconds(1)) == 1);
+                CHECK(world.getTick() == 9);
+            }
+        }
+    }
+
+    GIVEN("Worlds at rates out of range") {
+        World stopped(nullptr, 0, 1);
+        World fast(nullptr, 1000000, 1);
+
+        THEN("They fall back to the default or the fastest rate") {
+            CHECK(stopped.getTicksPerSecond() == 50);
+            CHECK(stopped.getTickLength() == sf::milliseconds(20));
+            CHECK(fast.getTicksPerSecond() == 1000);
+            CHECK(fast.getTickLength() == sf::milliseconds(1));
+        }
+    }
+
+    GIVEN("Worlds with 1 and 4 threads running 5000 entities") {
+        World serial(nullptr, 50, 1);
+        World parallel(nullptr, 50, 4);
+
+        TickPipeline *pipelines[] = { &serial.getPipeline(), &parallel.getPipeline() };
+        for (TickPipeline *pipeline : pipelines) {
+            populate(*pipeline, 5000, 99);
+            pipeline->addSystem(lifecycle);
+        }
+
+        for (int tick = 0; tick < 40; tick++) {
+            serial.tick();
+            parallel.tick();
+        }
+
+        THEN("They end up the same") {
+            const EntityRegistry &a = serial.getPipeline().getRegistry();
+            const EntityRegistry &b = parallel.getPipeline().getRegistry();
+
+            CHECK(a.size() != 5000);
+            REQUIRE(a.size() == b.size());
+            CHECK(a.getIDs() == b.getIDs());
+            CHECK(a.getPositions() == b.getPositions());
+            CHECK(a.getVelocities() == b.getVelocities());
+        }
+
+        THEN("The index follows entities across chunks") {
+            checkIndex(serial.getPipeline());
+            checkIndex(parallel.getPipeline());
+        }
+
+        THEN("Despawned ids are stale") {
+            const EntityRegistry &registry = serial.getPipeline().getRegistry();
+            CHECK_FALSE(registry.contains(EntityIDAllocator::makeID(7, 1)));
+            CHECK_FALSE(serial.getPipeline().despawn(EntityIDAllocator::makeID(7, 1)));
+        }
+
+        THEN("Each phase is timed") {
+            const TickPipeline &pipeline = parallel.getPipeline();
+            sf::Time total;
+            for (int phase = 0; phase < TickPipeline::PhaseCount; phase++) {
+                total += pipeline.getPhaseTime(TickPipeline::Phase(phase));
+            }
+            CHECK(total <= pipeline.getTickTime());
+            CHECK(std::string(TickPipeline::getPhaseName(TickPipeline::Apply)) == "apply");
+        }
+    }
+}
+
+TEST_CASE("world tick benchmark","[.][benchmark][tick]") {
+    static const size_t Count = 100000;
+    static const int Ticks = 100;
+
+    unsigned int threads[] = { 1, 0 };
+
+    for (unsigned int count : threads) {
+        World world(nullptr, 50, count);
+        TickPipeline &pipeline = world.getPipeline();
+        populate(pipeline, Count, 4321);
+        pipeline.addSystem(lifecycle);
+
+        sf::Time phases[TickPipeline::PhaseCount];
+        sf::Time total;
+
+        for (int tick = 0; tick < Ticks; tick++) {
+            world.tick();
+            for (int phase = 0; phase < TickPipeline::PhaseCount; phase++) {
+                phases[phase] += pipeline.getPhaseTime(TickPipeline::Phase(phase));
+            }
+            total += pipeline.getTickTime();
+        }
+
+        WARN(pipeline.getRegistry().size() << " entities on " << world.getThreadCount() << " threads: " <<
+             total.asSeconds() * 1000.0f / Ticks << " ms/tick (systems " <<
+             phases[TickPipeline::Systems].asSeconds() * 1000.0f / Ticks << ", motion " <<
+             phases[TickPipeline::Motion].asSeconds() * 1000.0f / Ticks << ", apply " <<
+             phases[TickPipeline::Apply].asSeconds() * 1000.0f / Ticks << ")");
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,321 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch.hpp"
+
+#include "engine/engine.hpp"
+
+#include <SFML/System/Clock.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <memory>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+const BlockType Stone = 1;
+
+void fill(ChunkData &data, BlockType type) {
+    for (Coord z = 0; z < ChunkData::Count; z++) {
+        for (Coord y = 0; y < ChunkData::Count; y++) {
+            for (Coord x = 0; x < ChunkData::Count; x++) {
+                data.getBlock(Position(x, y, z)).setType(type);
+            }
+        }
+    }
+}
+
+ChunkConnectivity getConnectivity(const ChunkData &data) {
+    const ChunkData *neighbours[6] = {};
+    std::unique_ptr<ChunkMesher> mesher(new ChunkMesher());
+    mesher->load(data, neighbours);
+    return mesher->getConnectivity();
+}
+
+bool isVisible(const std::vector<Position> &visible, const Position &chunk) {
+    return std::find(visible.begin(), visible.end(), chunk) != visible.end();
+}
+
+/**
+ *  A block of stone chunks with worm-like caves through it, under open
+ *  sky, made the same for a given seed.
+ */
+class CaveWorld {
+    int mWidth, mHeight, mDepth;
+    std::vector<ChunkData> mChunks;
+
+public:
+    std::vector<glm::vec3> starts;
+
+    CaveWorld(int width, int height, int depth, int worms, uint32_t seed):
+        mWidth(width), mHeight(height), mDepth(depth),
+        mChunks(size_t(width) * height * depth), starts() {
+        int ground = (height - 1) * ChunkData::Count;
+
+        for (Coord z = 0; z < depth * ChunkData::Count; z++) {
+            for (Coord y = 0; y < ground; y++) {
+                for (Coord x = 0; x < width * ChunkData::Count; x++) {
+                    setBlock(x, y, z, Stone);
+                }
+            }
+        }
+
+        auto random = [&seed]() {
+            seed = seed * 1103515245 + 12345;
+            return float((seed >> 8) & 0xffff) / 0xffff;
+        };
+
+        for (int worm = 0; worm < worms; worm++) {
+            glm::vec3 p(
+                random() * width * ChunkData::Count,
+                (0.2f + 0.5f * random()) * ground,
+                random() * depth * ChunkData::Count
+            );
+            starts.push_back(p);
+
+            float yaw = random() * 6.2832f;
+            float pitch = 0;
+
+            for (int step = 0; step < 400; step++) {
+                carve(p, 2.5f);
+                yaw += (random() - 0.5f) * 0.6f;
+                pitch = std::max(-0.5f, std::min(0.5f, pitch + (random() - 0.5f) * 0.3f));
+                p += glm::vec3(std::cos(yaw) * std::cos(pitch), std::sin(pitch), std::sin(yaw) * std::cos(pitch));
+            }
+        }
+    }
+
+    bool contains(const Position &chunk) const {
+        return chunk.x >= 0 && chunk.x < mWidth && chunk.y >= 0 && chunk.y < mHeight &&
+               chunk.z >= 0 && chunk.z < mDepth;
+    }
+
+    const ChunkData &getChunk(const Position &chunk) const {
+        return mChunks[(size_t(chunk.z) * mHeight + chunk.y) * mWidth + chunk.x];
+    }
+
+    void setBlock(Coord x, Coord y, Coord z, BlockType type) {
+        Position chunk(x / ChunkData::Count, y / ChunkData::Count, z / ChunkData::Count);
+        if (contains(chunk)) {
+            ChunkData &data = mChunks[(size_t(chunk.z) * mHeight + chunk.y) * mWidth + chunk.x];
+            data.getBlock(Position(x, y, z)).setType(type);
+        }
+    }
+
+    void carve(const glm::vec3 &center, float radius) {
+        int r = int(std::ceil(radius));
+        for (int dz = -r; dz <= r; dz++) {
+            for (int dy = -r; dy <= r; dy++) {
+                for (int dx = -r; dx <= r; dx++) {
+                    if (dx * dx + dy * dy + dz * dz <= radius * radius) {
+                        Coord x = Coord(center.x) + dx, y = Coord(center.y) + dy, z = Coord(center.z) + dz;
+                        if (x >= 0 && y >= 0 && z >= 0) {
+                            setBlock(x, y, z, 0);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     *  Sets the connectivity of every chunk, returning the seconds taken.
+     */
+    float connect(ChunkVisibility &visibility) const {
+        const ChunkData *neighbours[6] = {};
+        std::unique_ptr<ChunkMesher> mesher(new ChunkMesher());
+        sf::Clock clock;
+
+        for (Coord z = 0; z < mDepth; z++) {
+            for (Coord y = 0; y < mHeight; y++) {
+                for (Coord x = 0; x < mWidth; x++) {
+                    mesher->load(getChunk(Position(x, y, z)), neighbours);
+                    visibility.set(Position(x, y, z), mesher->getConnectivity());
+                }
+            }
+        }
+
+        return clock.getElapsedTime().asSeconds();
+    }
+};
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+SCENARIO("chunk connectivity","[visibility]") {
+
+    ChunkData data;
+
+    GIVEN("A chunk of air") {
+        THEN("Every face sees every other") {
+            CHECK(getConnectivity(data).isOpen());
+        }
+    }
+
+    GIVEN("A chunk of stone") {
+        fill(data, Stone);
+
+        THEN("No face sees another") {
+            CHECK(getConnectivity(data).isClosed());
+        }
+
+        WHEN("A tunnel runs through it from west to east") {
+            for (Coord x = 0; x < ChunkData::Count; x++) {
+                data.getBlock(Position(x, 8, 8)).setType(0);
+            }
+
+            THEN("Only west and east see each other") {
+                ChunkConnectivity connectivity = getConnectivity(data);
+                int west = int(BlockFace::West) - 1, east = int(BlockFace::East) - 1;
+                int top = int(BlockFace::Top) - 1;
+
+                CHECK(connectivity.connects(west, east));
+                CHECK(connectivity.connects(east, west));
+                CHECK_FALSE(connectivity.connects(west, top));
+                CHECK_FALSE(connectivity.connects(east, top));
+            }
+
+            AND_WHEN("A shaft joins it from the top") {
+                for (Coord y = 9; y < ChunkData::Count; y++) {
+                    data.getBlock(Position(3, y, 8)).setType(0);
+                }
+
+                THEN("The top sees both ends") {
+                    ChunkConnectivity connectivity = getConnectivity(data);
+                    CHECK(connectivity.connects(int(BlockFace::Top) - 1, int(BlockFace::West) - 1));
+                    CHECK(connectivity.connects(int(BlockFace::Top) - 1, int(BlockFace::East) - 1));
+                    CHECK_FALSE(connectivity.connects(int(BlockFace::Top) - 1, int(BlockFace::North) - 1));
+                }
+            }
+        }
+
+        WHEN("A cave inside it touches no face") {
+            for (Coord x = 4; x < 12; x++) {
+                data.getBlock(Position(x, 8, 8)).setType(0);
+            }
+
+            THEN("It is still closed") {
+                CHECK(getConnectivity(data).isClosed());
+            }
+        }
+    }
+}
+
+SCENARIO("chunk visibility","[visibility]") {
+
+    ChunkVisibility visibility;
+    std::vector<Position> visible;
+    Frustum everything;
+
+    GIVEN("No known chunks") {
+        visibility.findVisible(Position(0, 0, 0), 2, everything, visible);
+
+        THEN("Every chunk in range is visible, nearest first") {
+            CHECK(visible.size() == 5 * 5 * 5);
+            CHECK(visible.front() == Position(0, 0, 0));
+        }
+    }
+
+    GIVEN("Closed chunks, with a tunnel running east") {
+        ChunkConnectivity tunnel;
+        tunnel.connect(int(BlockFace::West) - 1, int(BlockFace::East) - 1);
+
+        for (Coord z = -3; z <= 3; z++) {
+            for (Coord y = -3; y <= 3; y++) {
+                for (Coord x = -3; x <= 3; x++) {
+                    visibility.set(Position(x, y, z), y == 0 && z == 0 ? tunnel : ChunkConnectivity());
+                }
+            }
+        }
+
+        visibility.findVisible(Position(0, 0, 0), 3, everything, visible);
+
+        THEN("Only the tunnel and the walls around the camera are visible") {
+            CHECK(visibility.size() == 7 * 7 * 7);
+            CHECK(isVisible(visible, Position(3, 0, 0)));
+            CHECK(isVisible(visible, Position(-3, 0, 0)));
+            CHECK(isVisible(visible, Position(0, 1, 0)));
+            CHECK_FALSE(isVisible(visible, Position(0, 2, 0)));
+            CHECK_FALSE(isVisible(visible, Position(2, 1, 0)));
+            CHECK(visible.size() == 7 + 4);
+        }
+
+        WHEN("Looking east") {
+            glm::mat4 projection = glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 200.0f);
+            glm::mat4 view = glm::lookAt(glm::vec3(8, 8, 8), glm::vec3(100, 8, 8), glm::vec3(0, 1, 0));
+            CullStats stats;
+            visibility.findVisible(Position(0, 0, 0), 3, Frustum(projection * view), visible, &stats);
+
+            THEN("Only the tunnel ahead is left") {
+                CHECK(visible.size() == 4);
+                CHECK(isVisible(visible, Position(3, 0, 0)));
+                CHECK_FALSE(isVisible(visible, Position(-1, 0, 0)));
+                CHECK(stats.tested == 6 + 2);
+                CHECK(stats.culled == 5);
+            }
+        }
+    }
+}
+
+TEST_CASE("cave culling benchmark","[.][benchmark][visibility]") {
+    const int Distance = 8;
+    const int Frames = 200;
+
+    CaveWorld world(24, 8, 24, 60, 1234);
+    ChunkVisibility visibility;
+    float connectSeconds = world.connect(visibility);
+
+    glm::mat4 projection = glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, float(Distance * ChunkData::Count));
+    std::vector<Position> visible;
+    size_t frustumTotal = 0, visibleTotal = 0;
+    float seconds = 0;
+
+    for (int frame = 0; frame < Frames; frame++) {
+        // look around from inside a cave
+        const glm::vec3 &eye = world.starts[frame % world.starts.size()];
+        float yaw = frame * 0.7f;
+        glm::mat4 view = glm::lookAt(eye, eye + glm::vec3(std::cos(yaw), -0.2f, std::sin(yaw)), glm::vec3(0, 1, 0));
+        Frustum frustum(projection * view);
+
+        Position start(
+            Coord(eye.x) / ChunkData::Count,
+            Coord(eye.y) / ChunkData::Count,
+            Coord(eye.z) / ChunkData::Count
+        );
+
+        // what frustum culling alone would draw
+        for (Coord z = start.z - Distance; z <= start.z + Distance; z++) {
+            for (Coord y = start.y - Distance; y <= start.y + Distance; y++) {
+                for (Coord x = start.x - Distance; x <= start.x + Distance; x++) {
+                    glm::vec3 low(x * ChunkData::Count, y * ChunkData::Count, z * ChunkData::Count);
+                    if (world.contains(Position(x, y, z)) && frustum.intersects(low, low + glm::vec3(ChunkData::Count))) {
+                        frustumTotal += 1;
+                    }
+                }
+            }
+        }
+
+        sf::Clock clock;
+        visibility.findVisible(start, Distance, frustum, visible);
+        seconds += clock.getElapsedTime().asSeconds();
+
+        for (const Position &chunk : visible) {
+            visibleTotal += world.contains(chunk);
+        }
+    }
+
+    CHECK(visibleTotal <= frustumTotal);
+
+    WARN(visibility.size() << " chunks connected in " << connectSeconds * 1000 << " ms; " <<
+         "per frame, " << float(frustumTotal) / Frames << " chunks in the frustum, " <<
+         float(visibleTotal) / Frames << " visible through caves, found in " <<
+         seconds * 1e6f / Frames << " us");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////
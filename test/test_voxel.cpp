@@ -0,0 +1,170 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch.hpp"
+
+#include "engine/engine.hpp"
+#include "helpers.hpp"
+
+#include <SFML/System/Clock.hpp>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+const Coord M = 1 << FixedPointBits;
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+SCENARIO("voxel collision","[physics][voxel]") {
+
+    Physics physics;
+    TestSource source;
+    ChunkCache world(source, 64);
+
+    GIVEN("A box of dimension 0.5 above the ground") {
+        Physics::Body body;
+        body.setBounds(BoundingVolume::box(Dimension(M/2, M/2, M/2)));
+        body.setPosition(Position(0, 5 * M, 0));
+        body.setVelocity(Velocity(0, -M, 0));
+
+        WHEN("It falls") {
+            CHECK(physics.move(body, world, Position(0, -10 * M, 0)));
+
+            THEN("It rests on the ground") {
+                CHECK(body.getPosition() == Position(0, M/2, 0));
+                CHECK(body.getVelocity() == Velocity(0, 0, 0));
+            }
+
+            THEN("It slides along the ground and stops at the wall") {
+                body.setVelocity(Velocity(M, 0, M));
+                CHECK(physics.move(body, world, Position(10 * M, 0, M)));
+                CHECK(body.getPosition() == Position(4 * M - M/2, M/2, M));
+                CHECK(body.getVelocity() == Velocity(0, 0, M));
+            }
+
+            THEN("It can move away from the ground") {
+                CHECK_FALSE(physics.move(body, world, Position(0, M, 0)));
+                CHECK(body.getPosition() == Position(0, M + M/2, 0));
+            }
+        }
+
+        WHEN("It falls very fast") {
+            physics.move(body, world, Position(0, -1000 * M, 0));
+
+            THEN("It does not tunnel through the ground") {
+                CHECK(body.getPosition().y == M/2);
+            }
+        }
+
+        WHEN("It moves above the wall") {
+            body.setPosition(Position(0, 4 * M + M/2, 0));
+            CHECK_FALSE(physics.move(body, world, Position(10 * M, 0, 0)));
+            CHECK(body.getPosition() == Position(10 * M, 4 * M + M/2, 0));
+        }
+
+        WHEN("It moves toward negative coordinates") {
+            body.setPosition(Position(-M/2, M/2, -20 * M));
+            CHECK(physics.move(body, world, Position(-20 * M, -M, 0)));
+            CHECK(body.getPosition() == Position(-7 * M + M/2, M/2, -20 * M));
+        }
+    }
+
+    GIVEN("A capsule above the ground") {
+        Physics::Body body;
+        body.setBounds(BoundingVolume::capsule(M/4, M));
+        body.setPosition(Position(M/2, 3 * M, M/2));
+
+        physics.move(body, world, Position(0, -5 * M, 0));
+        CHECK(body.getPosition() == Position(M/2, M, M/2));
+    }
+
+    GIVEN("A point body") {
+        Physics::Body body;
+        body.setPosition(Position(M/2, 3 * M, M/2));
+
+        physics.move(body, world, Position(0, -5 * M, 0));
+        CHECK(body.getPosition() == Position(M/2, 0, M/2));
+    }
+
+    GIVEN("Generated terrain") {
+        ChunkGenerator generator(42);
+        ChunkCache terrain(generator, 256);
+
+        for (Coord x = -40; x <= 40; x += 7) {
+            for (Coord z = -40; z <= 40; z += 11) {
+                CAPTURE(x);
+                CAPTURE(z);
+
+                Physics::Body body;
+                body.setBounds(BoundingVolume::box(Dimension(M/4, M/4, M/4)));
+                body.setPosition(Position(x * M + M/2, 40 * M, z * M + M/2));
+
+                for (int tick = 0; tick < 100; tick++) {
+                    physics.gravitate(body);
+                    physics.update(body, terrain, sf::seconds(1));
+                }
+
+                Coord ground = generator.getHeight(x, z) + 1;
+                CHECK(body.getPosition().y == ground * M + M/4);
+            }
+        }
+    }
+}
+
+TEST_CASE("voxel collision benchmark","[.][benchmark][voxel]") {
+    static const size_t Count = 4000;
+    static const int Ticks = 200;
+
+    Physics physics;
+    ChunkGenerator generator(7);
+    ChunkCache terrain(generator, 1024);
+
+    std::vector<Physics::Body> bodies(Count);
+    uint32_t random = 1;
+
+    for (Physics::Body &body : bodies) {
+        random = random * 1103515245 + 12345;
+        Coord x = (random >> 8) % (64 * M) - 32 * M;
+        random = random * 1103515245 + 12345;
+        Coord z = (random >> 8) % (64 * M) - 32 * M;
+        random = random * 1103515245 + 12345;
+        Coord y = (random >> 8) % (32 * M) + 16 * M;
+
+        body.setPosition(Position(x, y, z));
+        body.setVelocity(Velocity(random % 32 - 16, 0, (random >> 5) % 32 - 16));
+        body.setBounds(random % 2 ? BoundingVolume::box(Dimension(M/4, M/4, M/4)) :
+                                    BoundingVolume::capsule(M/4, 7*M/8));
+    }
+
+    // load the terrain before timing
+    for (Physics::Body &body : bodies) {
+        Physics::Body probe(body);
+        physics.move(probe, terrain, Position(0, -64 * M, 0));
+    }
+
+    sf::Clock clock;
+    size_t blocked = 0;
+
+    for (int tick = 0; tick < Ticks; tick++) {
+        blocked = 0;
+        for (Physics::Body &body : bodies) {
+            physics.gravitate(body);
+            if (physics.update(body, terrain, sf::seconds(1))) {
+                blocked += 1;
+            }
+        }
+    }
+
+    float ms = clock.getElapsedTime().asSeconds() * 1000.0f / Ticks;
+
+    WARN(Count << " falling bodies: " << ms << " ms/tick, " <<
+         blocked << " touching terrain after " << Ticks << " ticks");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//  EOF
+////////////////////////////////////////////////////////////////////////////////